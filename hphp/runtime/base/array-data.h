@@ -494,6 +494,10 @@ public:
     return offsetof(ArrayData, m_kind);
   }
 
+  static constexpr size_t offsetofSize() {
+    return offsetof(ArrayData, m_size);
+  }
+
   static const char* kindToString(ArrayKind kind);
 
  private:
@@ -15,11 +15,21 @@
 */
 
 #include "hphp/runtime/base/concurrent-shared-store.h"
+
+#include "folly/ScopeGuard.h"
+
+#include "hphp/runtime/base/program-functions.h"
 #include "hphp/runtime/base/variable-serializer.h"
 #include "hphp/runtime/ext/ext_apc.h"
+#include "hphp/runtime/vm/treadmill.h"
+#include "hphp/util/hash.h"
 #include "hphp/util/logger.h"
+#include "hphp/util/repo-schema.h"
 #include "hphp/util/timer.h"
+#include <fcntl.h>
 #include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using std::set;
 
@@ -99,6 +109,405 @@ static void stats_on_add(const StringData* key, const StoreValue* sval,
   }
 }
 
+/*
+ * Fetches set the CLOCK reference bit only if it's clear, so keys that
+ * stay hot between passes of the hand don't keep dirtying a shared line.
+ */
+static void mark_referenced(std::atomic<bool>& referenced) {
+  if (apcExtension::MemoryBudget > 0 &&
+      !referenced.load(std::memory_order_relaxed)) {
+    referenced.store(true, std::memory_order_relaxed);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StoreReadIndex
+
+struct StoreReadIndex::Table {
+  uint32_t mask;
+  std::atomic<Entry*> buckets[1];
+};
+
+/*
+ * Entries (and possibly a bucket array) that readers may still be
+ * looking at.  When an Entry is only being moved to a bigger table its
+ * reference to var moves with it, so releaseVars is false.
+ */
+struct StoreReadIndex::Retired : Treadmill::WorkItem {
+  Retired(std::vector<Entry*>&& entries, bool releaseVars, Table* table)
+    : m_entries(std::move(entries))
+    , m_releaseVars(releaseVars)
+    , m_table(table)
+  {}
+
+  virtual void operator()() {
+    for (auto e : m_entries) {
+      if (m_releaseVars) e->var->decRef();
+      free(e);
+    }
+    free(m_table);
+  }
+
+private:
+  std::vector<Entry*> m_entries;
+  bool m_releaseVars;
+  Table* m_table;
+};
+
+bool StoreReadIndex::Entry::expired() const {
+  return expiry && time(nullptr) >= expiry;
+}
+
+StoreReadIndex::Table* StoreReadIndex::makeTable(uint32_t nbuckets) {
+  assert(nbuckets && !(nbuckets & (nbuckets - 1)));
+  auto t = static_cast<Table*>(
+    malloc(sizeof(Table) + (nbuckets - 1) * sizeof(std::atomic<Entry*>)));
+  t->mask = nbuckets - 1;
+  for (uint32_t i = 0; i < nbuckets; ++i) {
+    new (&t->buckets[i]) std::atomic<Entry*>(nullptr);
+  }
+  return t;
+}
+
+StoreReadIndex::StoreReadIndex()
+  : m_table(makeTable(64))
+  , m_count(0)
+{}
+
+StoreReadIndex::~StoreReadIndex() {
+  Table* t = m_table.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i <= t->mask; ++i) {
+    Entry* e = t->buckets[i].load(std::memory_order_relaxed);
+    while (e) {
+      Entry* next = e->next.load(std::memory_order_relaxed);
+      e->var->decRef();
+      free(e);
+      e = next;
+    }
+  }
+  free(t);
+}
+
+std::atomic<StoreReadIndex::Entry*>*
+StoreReadIndex::findLink(Table* t, const char* key, int32_t len,
+                         strhash_t hash) const {
+  std::atomic<Entry*>* link = &t->buckets[hash & t->mask];
+  for (Entry* e; (e = link->load(std::memory_order_acquire)) != nullptr;
+       link = &e->next) {
+    if (e->hash == hash && e->len == len && !memcmp(e->key, key, len)) {
+      return link;
+    }
+  }
+  return nullptr;
+}
+
+const StoreReadIndex::Entry*
+StoreReadIndex::find(const char* key, int32_t len, strhash_t hash) const {
+  auto link = findLink(m_table.load(std::memory_order_acquire),
+                       key, len, hash);
+  return link ? link->load(std::memory_order_acquire) : nullptr;
+}
+
+void StoreReadIndex::publish(const char* key, int32_t len, strhash_t hash,
+                             SharedVariant* var, int64_t expiry) {
+  auto e = static_cast<Entry*>(malloc(sizeof(Entry) + len));
+  e->var = var;
+  e->expiry = expiry;
+  new (&e->referenced) std::atomic<bool>(false);
+  e->hash = hash;
+  e->len = len;
+  memcpy(e->key, key, len);
+  e->key[len] = '\0';
+  var->incRef();
+
+  Lock l(m_writeLock);
+  Table* t = m_table.load(std::memory_order_relaxed);
+  if (auto link = findLink(t, key, len, hash)) {
+    Entry* old = link->load(std::memory_order_relaxed);
+    new (&e->next) std::atomic<Entry*>(
+      old->next.load(std::memory_order_relaxed));
+    link->store(e, std::memory_order_release);
+    Treadmill::WorkItem::enqueue(
+      new Retired(std::vector<Entry*>{old}, true, nullptr));
+    return;
+  }
+  auto& head = t->buckets[hash & t->mask];
+  new (&e->next) std::atomic<Entry*>(head.load(std::memory_order_relaxed));
+  head.store(e, std::memory_order_release);
+  if (++m_count > t->mask) grow();
+}
+
+void StoreReadIndex::unpublish(const char* key, int32_t len,
+                               strhash_t hash) {
+  Lock l(m_writeLock);
+  auto link = findLink(m_table.load(std::memory_order_relaxed),
+                       key, len, hash);
+  if (!link) return;
+  Entry* old = link->load(std::memory_order_relaxed);
+  link->store(old->next.load(std::memory_order_relaxed),
+              std::memory_order_release);
+  --m_count;
+  Treadmill::WorkItem::enqueue(
+    new Retired(std::vector<Entry*>{old}, true, nullptr));
+}
+
+/*
+ * Readers may be walking any chain of the old table, so its Entries
+ * can't be relinked; copy them into the new table instead and retire
+ * the originals along with the old bucket array.  Called with
+ * m_writeLock held.
+ */
+void StoreReadIndex::grow() {
+  Table* old = m_table.load(std::memory_order_relaxed);
+  Table* t = makeTable((old->mask + 1) * 2);
+  std::vector<Entry*> retired;
+  retired.reserve(m_count);
+  for (uint32_t i = 0; i <= old->mask; ++i) {
+    for (Entry* e = old->buckets[i].load(std::memory_order_relaxed); e;
+         e = e->next.load(std::memory_order_relaxed)) {
+      auto copy = static_cast<Entry*>(malloc(sizeof(Entry) + e->len));
+      memcpy(copy, e, sizeof(Entry) + e->len);
+      auto& head = t->buckets[e->hash & t->mask];
+      new (&copy->next) std::atomic<Entry*>(
+        head.load(std::memory_order_relaxed));
+      head.store(copy, std::memory_order_relaxed);
+      retired.push_back(e);
+    }
+  }
+  m_table.store(t, std::memory_order_release);
+  Treadmill::WorkItem::enqueue(
+    new Retired(std::move(retired), false, old));
+}
+
+bool StoreReadIndex::takeReferenced(const char* key, int32_t len,
+                                    strhash_t hash) {
+  // Entries reachable under m_writeLock haven't been retired, so this is
+  // safe outside of a request too.
+  Lock l(m_writeLock);
+  auto link = findLink(m_table.load(std::memory_order_relaxed),
+                       key, len, hash);
+  if (!link) return false;
+  return link->load(std::memory_order_relaxed)->referenced.exchange(
+    false, std::memory_order_relaxed);
+}
+
+void StoreReadIndex::clear() {
+  Lock l(m_writeLock);
+  Table* old = m_table.load(std::memory_order_relaxed);
+  std::vector<Entry*> retired;
+  retired.reserve(m_count);
+  for (uint32_t i = 0; i <= old->mask; ++i) {
+    for (Entry* e = old->buckets[i].load(std::memory_order_relaxed); e;
+         e = e->next.load(std::memory_order_relaxed)) {
+      retired.push_back(e);
+    }
+  }
+  m_table.store(makeTable(64), std::memory_order_release);
+  m_count = 0;
+  Treadmill::WorkItem::enqueue(
+    new Retired(std::move(retired), true, old));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ConcurrentTableSharedStore::ConcurrentTableSharedStore(int id)
+  : m_id(id)
+  , m_memUsed(0)
+  , m_evictions(0)
+  , m_evictedSize(0)
+  , m_lockingFlag(false)
+{
+  uint32_t n = 1;
+  while ((int)n < apcExtension::ShardCount && n < 1024) n *= 2;
+  for (uint32_t i = 0; i < n; ++i) {
+    m_shards.emplace_back(new Shard);
+  }
+  m_shardMask = n - 1;
+}
+
+int ConcurrentTableSharedStore::size() const {
+  int size = 0;
+  for (auto const& shard : m_shards) size += shard->vars.size();
+  return size;
+}
+
+/*
+ * The StoreReadIndex relies on the Treadmill to keep Entries alive, so
+ * threads outside of a request (priming, upload progress callbacks)
+ * have to go through the Map.
+ */
+bool ConcurrentTableSharedStore::lockFreeReads() const {
+  return apcExtension::LockFreeReads && Treadmill::inRequest();
+}
+
+bool ConcurrentTableSharedStore::lockedOps() const {
+  return !apcExtension::ConcurrentTableLockFree || m_lockingFlag;
+}
+
+void ConcurrentTableSharedStore::publish(Shard& shard, CStrRef key,
+                                         const StoreValue& sval) {
+  if (!apcExtension::LockFreeReads) return;
+  if (sval.inMem()) {
+    shard.index.publish(key.data(), key.size(), key->hash(),
+                        sval.var, sval.expiry);
+  } else {
+    shard.index.unpublish(key.data(), key.size(), key->hash());
+  }
+}
+
+void ConcurrentTableSharedStore::publish(Shard& shard, const char* key,
+                                         const StoreValue& sval) {
+  if (!apcExtension::LockFreeReads) return;
+  int32_t len = strlen(key);
+  if (sval.inMem()) {
+    shard.index.publish(key, len, hash_string(key, len),
+                        sval.var, sval.expiry);
+  } else {
+    shard.index.unpublish(key, len, hash_string(key, len));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// memory budget
+
+/*
+ * When SharedStoreStats are on they've already measured the value;
+ * otherwise it's only measured when there is a budget to count it
+ * against.
+ */
+void ConcurrentTableSharedStore::charge(Shard& shard,
+                                        const StoreValue& sval,
+                                        int32_t keyLen) {
+  if (apcExtension::MemoryBudget <= 0) return;
+  int32_t size = 0;
+  if (sval.inMem()) {
+    size = keyLen + (RuntimeOption::EnableAPCSizeStats && sval.size > 0 ?
+                     sval.size : sval.var->getSpaceUsage());
+  }
+  shard.memUsed.fetch_add(size - sval.charged, std::memory_order_relaxed);
+  m_memUsed.fetch_add(size - sval.charged, std::memory_order_relaxed);
+  sval.charged = size;
+}
+
+void ConcurrentTableSharedStore::uncharge(Shard& shard,
+                                          const StoreValue& sval) {
+  if (sval.charged) {
+    shard.memUsed.fetch_sub(sval.charged, std::memory_order_relaxed);
+    m_memUsed.fetch_sub(sval.charged, std::memory_order_relaxed);
+    sval.charged = 0;
+  }
+}
+
+/*
+ * A shard only evicts its own keys, so it's held to its own share of
+ * the budget: the trigger and the sweep cover the same keys, and with
+ * well-spread keys the store as a whole stays under the budget.
+ */
+bool ConcurrentTableSharedStore::overBudget(const Shard& shard) const {
+  return apcExtension::MemoryBudget > 0 &&
+    shard.memUsed.load(std::memory_order_relaxed) >
+    apcExtension::MemoryBudget / (int64_t)m_shards.size();
+}
+
+// New keys go just behind the hand, so they get a full trip around the
+// ring before it first looks at them.
+void ConcurrentTableSharedStore::addToClock(Shard& shard, StoreValue& sval,
+                                            const char* key) {
+  if (apcExtension::MemoryBudget <= 0) return;
+  Lock l(shard.clockLock);
+  if (sval.clockNext) return;
+  sval.clockKey = key;
+  if (!shard.hand) {
+    sval.clockPrev = sval.clockNext = &sval;
+    shard.hand = &sval;
+  } else {
+    sval.clockNext = shard.hand;
+    sval.clockPrev = shard.hand->clockPrev;
+    sval.clockPrev->clockNext = &sval;
+    shard.hand->clockPrev = &sval;
+  }
+  ++shard.clockSize;
+}
+
+void ConcurrentTableSharedStore::removeFromClock(Shard& shard,
+                                                 StoreValue& sval) {
+  Lock l(shard.clockLock);
+  if (!sval.clockNext) return;
+  if (sval.clockNext == &sval) {
+    shard.hand = nullptr;
+  } else {
+    if (shard.hand == &sval) shard.hand = sval.clockNext;
+    sval.clockPrev->clockNext = sval.clockNext;
+    sval.clockNext->clockPrev = sval.clockPrev;
+  }
+  sval.clockPrev = sval.clockNext = nullptr;
+  sval.clockKey = nullptr;
+  --shard.clockSize;
+}
+
+/*
+ * Second-chance CLOCK over the shard's keys, run by writers until the
+ * shard is back under its share of apcExtension::MemoryBudget.  Keys
+ * fetched since the hand last passed them lose their reference bit and
+ * are skipped; unreferenced in-memory values are evicted.  Primed keys
+ * backed by file storage only drop their in-memory copy.  The key just
+ * stored is left alone even if it's bigger than the whole share.
+ */
+void ConcurrentTableSharedStore::evict(Shard& shard, const char* keep) {
+  size_t steps;
+  {
+    Lock l(shard.clockLock);
+    // Two trips around the ring clear every reference bit on the way.
+    steps = shard.clockSize * 2;
+  }
+  while (steps-- && overBudget(shard)) {
+    // Advance the hand under clockLock, but look the key up without it:
+    // erasers take clockLock while holding their accessor.
+    std::string key;
+    {
+      Lock l(shard.clockLock);
+      if (!shard.hand) break;
+      key = shard.hand->clockKey;
+      shard.hand = shard.hand->clockNext;
+    }
+    if (key == keep) continue;
+
+    Map::accessor acc;
+    if (!shard.vars.find(acc, key.c_str())) continue;
+    StoreValue& sval = acc->second;
+    bool referenced = sval.referenced.exchange(false,
+                                               std::memory_order_relaxed);
+    if (apcExtension::LockFreeReads && sval.inMem()) {
+      referenced |= shard.index.takeReferenced(
+        key.data(), key.size(), hash_string(key.data(), key.size()));
+    }
+    if (!sval.inMem() || referenced) continue;
+
+    int32_t bytes = sval.charged;
+    if (RuntimeOption::EnableAPCSizeStats) {
+      String skey(key);
+      stats_on_delete(skey.get(), &sval, false);
+    }
+    uncharge(shard, sval);
+    sval.var->decRef();
+    if (sval.inFile()) {
+      sval.var = nullptr;
+      sval.size = 0;
+      publish(shard, key.c_str(), sval);
+    } else {
+      if (apcExtension::LockFreeReads) {
+        shard.index.unpublish(key.data(), key.size(),
+                              hash_string(key.data(), key.size()));
+      }
+      eraseAcc(shard, acc);
+    }
+    m_evictions.fetch_add(1, std::memory_order_relaxed);
+    m_evictedSize.fetch_add(bytes, std::memory_order_relaxed);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 std::string ConcurrentTableSharedStore::GetSkeleton(CStrRef key) {
   std::string ret;
   const char *p = key.data();
@@ -123,15 +532,22 @@ bool ConcurrentTableSharedStore::clear() {
   if (apcExtension::ConcurrentTableLockFree) {
     return false;
   }
-  WriteLock l(m_lock);
-  for (Map::iterator iter = m_vars.begin(); iter != m_vars.end();
-       ++iter) {
-    if (iter->second.inMem()) {
-      iter->second.var->decRef();
+  for (auto& shard : m_shards) {
+    WriteLock l(shard->lock);
+    for (Map::iterator iter = shard->vars.begin();
+         iter != shard->vars.end(); ++iter) {
+      if (iter->second.inMem()) {
+        iter->second.var->decRef();
+      }
+      uncharge(*shard, iter->second);
+      free((void *)iter->first);
     }
-    free((void *)iter->first);
+    shard->vars.clear();
+    shard->index.clear();
+    Lock cl(shard->clockLock);
+    shard->hand = nullptr;
+    shard->clockSize = 0;
   }
-  m_vars.clear();
   return true;
 }
 
@@ -154,15 +570,16 @@ bool ConcurrentTableSharedStore::erase(CStrRef key,
  */
 bool ConcurrentTableSharedStore::eraseImpl(CStrRef key, bool expired) {
   if (key.isNull()) return false;
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  Shard& shard = shardFor(key);
+  ConditionalReadLock l(shard.lock, lockedOps());
   Map::accessor acc;
-  if (m_vars.find(acc, tagStringData(key.get()))) {
+  if (shard.vars.find(acc, tagStringData(key.get()))) {
     if (expired && !acc->second.expired()) {
       return false;
     }
     if (acc->second.inMem()) {
       stats_on_delete(key.get(), &acc->second, expired);
+      uncharge(shard, acc->second);
       acc->second.var->decRef();
     } else {
       assert(acc->second.inFile());
@@ -173,17 +590,21 @@ bool ConcurrentTableSharedStore::eraseImpl(CStrRef key, bool expired) {
       acc->second.var = nullptr;
       acc->second.size = 0;
       acc->second.expiry = 0;
+      publish(shard, key, acc->second);
     } else {
-      eraseAcc(acc);
+      if (apcExtension::LockFreeReads) {
+        shard.index.unpublish(key.data(), key.size(), key->hash());
+      }
+      eraseAcc(shard, acc);
     }
     return true;
   }
   return false;
 }
 
-// Should be called outside m_lock
-void ConcurrentTableSharedStore::purgeExpired() {
-  if (m_purgeCounter.fetch_add(1, std::memory_order_relaxed) %
+// Should be called outside shard.lock
+void ConcurrentTableSharedStore::purgeExpired(Shard& shard) {
+  if (shard.purgeCounter.fetch_add(1, std::memory_order_relaxed) %
       apcExtension::PurgeFrequency != 0) {
     return;
   }
@@ -193,22 +614,22 @@ void ConcurrentTableSharedStore::purgeExpired() {
   Timer::GetMonotonicTime(tsBegin);
   int i = 0;
   while (apcExtension::PurgeRate < 0 || i < apcExtension::PurgeRate) {
-    if (!m_expQueue.try_pop(tmp)) {
+    if (!shard.expQueue.try_pop(tmp)) {
       break;
     }
     if (tmp.second > now) {
-      m_expQueue.push(tmp);
+      shard.expQueue.push(tmp);
       break;
     }
     if (apcExtension::UseFileStorage &&
         strcmp(tmp.first, apcExtension::FileStorageFlagKey.c_str()) == 0) {
       s_apc_file_storage.adviseOut();
-      addToExpirationQueue(apcExtension::FileStorageFlagKey.c_str(),
+      addToExpirationQueue(shard, apcExtension::FileStorageFlagKey.c_str(),
                            time(nullptr) +
                            apcExtension::FileStorageAdviseOutPeriod);
       continue;
     }
-    m_expMap.erase(tmp.first);
+    shard.expMap.erase(tmp.first);
     eraseImpl(tmp.first, true);
     free((void *)tmp.first);
     ++i;
@@ -217,24 +638,28 @@ void ConcurrentTableSharedStore::purgeExpired() {
   int64_t elapsed = gettime_diff_us(tsBegin, tsEnd);
   SharedStoreStats::addPurgingTime(elapsed);
   // Size could be inaccurate, but for stats reporting, it is good enough
-  SharedStoreStats::setExpireQueueSize(m_expQueue.size());
+  size_t queueSize = 0;
+  for (auto const& s : m_shards) queueSize += s->expQueue.size();
+  SharedStoreStats::setExpireQueueSize(queueSize);
 }
 
-void ConcurrentTableSharedStore::addToExpirationQueue(const char* key, int64_t etime) {
+void ConcurrentTableSharedStore::addToExpirationQueue(Shard& shard,
+                                                      const char* key,
+                                                      int64_t etime) {
   ExpMap::accessor acc;
-  if (m_expMap.find(acc, key)) {
+  if (shard.expMap.find(acc, key)) {
     acc->second++;
     return;
   }
 
   const char *copy = strdup(key);
-  if (!m_expMap.insert(acc, copy)) {
+  if (!shard.expMap.insert(acc, copy)) {
     free((void *)copy);
     acc->second++;
     return;
   }
   ExpirationPair p(copy, etime);
-  m_expQueue.push(p);
+  shard.expQueue.push(p);
 }
 
 bool ConcurrentTableSharedStore::handlePromoteObj(CStrRef key,
@@ -242,8 +667,9 @@ bool ConcurrentTableSharedStore::handlePromoteObj(CStrRef key,
                                                   CVarRef value) {
   SharedVariant *converted = svar->convertObj(value);
   if (converted) {
+    Shard& shard = shardFor(key);
     Map::accessor acc;
-    if (!m_vars.find(acc, tagStringData(key.get()))) {
+    if (!shard.vars.find(acc, tagStringData(key.get()))) {
       // There is a chance another thread deletes the key when this thread is
       // converting the object. In that case, we just bail
       converted->decRef();
@@ -258,7 +684,9 @@ bool ConcurrentTableSharedStore::handlePromoteObj(CStrRef key,
       int64_t ttl = sval->expiry ? sval->expiry - time(nullptr) : 0;
       stats_on_update(key.get(), sval, converted, ttl);
       sval->var = converted;
+      charge(shard, *sval, key.size());
       sv->decRef();
+      publish(shard, key, *sval);
       return true;
     }
     converted->decRef();
@@ -285,6 +713,9 @@ SharedVariant* ConcurrentTableSharedStore::unserialize(CStrRef key,
     v.unserialize(&vu);
     sval->var = SharedVariant::Create(v, sval->isSerializedObj());
     stats_on_add(key.get(), sval, 0, true, true); // delayed prime
+    Shard& shard = shardFor(key);
+    charge(shard, *sval, key.size());
+    publish(shard, key, *sval);
     return sval->var;
   } catch (Exception &e) {
     raise_notice("APC Primed fetch failed: key %s (%s).",
@@ -294,15 +725,32 @@ SharedVariant* ConcurrentTableSharedStore::unserialize(CStrRef key,
 }
 
 bool ConcurrentTableSharedStore::get(CStrRef key, Variant &value) {
+  Shard& shard = shardFor(key);
+  if (lockFreeReads()) {
+    auto e = shard.index.find(key.data(), key.size(), key->hash());
+    // Objects may need promoting, which needs the Map accessor.
+    if (e && !e->expired() &&
+        !(apcExtension::AllowObj && e->var->is(KindOfObject))) {
+      mark_referenced(e->referenced);
+      // e's reference keeps var alive until this request is over, so
+      // the local copy can point into it without taking one.
+      value = e->var->toLocal(true);
+      stats_on_get(key.get(), e->var);
+      log_apc(std_apc_hit);
+      return true;
+    }
+    // Misses, expired keys and primed keys still in file storage are
+    // sorted out under the Map accessor below.
+  }
+
   const StoreValue *sval;
   SharedVariant *svar = nullptr;
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  ConditionalReadLock l(shard.lock, lockedOps());
   bool expired = false;
   bool promoteObj = false;
   {
     Map::const_accessor acc;
-    if (!m_vars.find(acc, tagStringData(key.get()))) {
+    if (!shard.vars.find(acc, tagStringData(key.get()))) {
       log_apc(std_apc_miss);
       return false;
     } else {
@@ -330,6 +778,7 @@ bool ConcurrentTableSharedStore::get(CStrRef key, Variant &value) {
           svar->incRef();
           promoteObj = true;
         }
+        mark_referenced(sval->referenced);
         value = svar->toLocal();
         stats_on_get(key.get(), svar);
       }
@@ -364,18 +813,27 @@ static int64_t get_int64_value(StoreValue* sval) {
 int64_t ConcurrentTableSharedStore::inc(CStrRef key, int64_t step, bool &found) {
   found = false;
   int64_t ret = 0;
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  Shard& shard = shardFor(key);
+  ConditionalReadLock l(shard.lock, lockedOps());
   StoreValue *sval;
   {
     Map::accessor acc;
-    if (m_vars.find(acc, tagStringData(key.get()))) {
+    if (shard.vars.find(acc, tagStringData(key.get()))) {
       sval = &acc->second;
       if (!sval->expired()) {
         ret = get_int64_value(sval) + step;
         SharedVariant *svar = construct(Variant(ret));
-        sval->var->decRef();
+        if (sval->inMem()) {
+          sval->var->decRef();
+        } else {
+          // primed or snapshot item not fetched yet; the copy in the
+          // file is stale now
+          sval->sAddr = nullptr;
+          sval->sSize = 0;
+        }
         sval->var = svar;
+        charge(shard, *sval, key.size());
+        publish(shard, key, *sval);
         found = true;
         log_apc(std_apc_hit);
       }
@@ -386,17 +844,24 @@ int64_t ConcurrentTableSharedStore::inc(CStrRef key, int64_t step, bool &found)
 
 bool ConcurrentTableSharedStore::cas(CStrRef key, int64_t old, int64_t val) {
   bool success = false;
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  Shard& shard = shardFor(key);
+  ConditionalReadLock l(shard.lock, lockedOps());
   StoreValue *sval;
   {
     Map::accessor acc;
-    if (m_vars.find(acc, tagStringData(key.get()))) {
+    if (shard.vars.find(acc, tagStringData(key.get()))) {
       sval = &acc->second;
       if (!sval->expired() && get_int64_value(sval) == old) {
         SharedVariant *var = construct(Variant(val));
-        sval->var->decRef();
+        if (sval->inMem()) {
+          sval->var->decRef();
+        } else {
+          sval->sAddr = nullptr;
+          sval->sSize = 0;
+        }
         sval->var = var;
+        charge(shard, *sval, key.size());
+        publish(shard, key, *sval);
         success = true;
         log_apc(std_apc_cas);
       }
@@ -406,13 +871,23 @@ bool ConcurrentTableSharedStore::cas(CStrRef key, int64_t old, int64_t val) {
 }
 
 bool ConcurrentTableSharedStore::exists(CStrRef key) {
+  Shard& shard = shardFor(key);
+  if (lockFreeReads()) {
+    auto e = shard.index.find(key.data(), key.size(), key->hash());
+    if (e && !e->expired()) {
+      mark_referenced(e->referenced);
+      stats_on_get(key.get(), e->var);
+      log_apc(std_apc_hit);
+      return true;
+    }
+  }
+
   const StoreValue *sval;
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  ConditionalReadLock l(shard.lock, lockedOps());
   bool expired = false;
   {
     Map::const_accessor acc;
-    if (!m_vars.find(acc, tagStringData(key.get()))) {
+    if (!shard.vars.find(acc, tagStringData(key.get()))) {
       log_apc(std_apc_miss);
       return false;
     } else {
@@ -422,6 +897,7 @@ bool ConcurrentTableSharedStore::exists(CStrRef key) {
         // expiration has to happen after the lock is released
         expired = true;
       } else {
+        mark_referenced(sval->referenced);
         // No need toLocal() here, avoiding the copy
         if (sval->inMem()) {
           stats_on_get(key.get(), sval->var);
@@ -451,15 +927,15 @@ bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef value, int64_t ttl,
                                        bool overwrite /* = true */) {
   StoreValue *sval;
   SharedVariant* svar = construct(value);
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
+  Shard& shard = shardFor(key);
+  ConditionalReadLock l(shard.lock, lockedOps());
   const char *kcp = strdup(key.data());
   bool present;
   time_t expiry = 0;
   bool overwritePrime = false;
   {
     Map::accessor acc;
-    present = !m_vars.insert(acc, kcp);
+    present = !shard.vars.insert(acc, kcp);
     sval = &acc->second;
     bool update = false;
     if (present) {
@@ -491,12 +967,20 @@ bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef value, int64_t ttl,
     if (!update) {
       stats_on_add(key.get(), sval, adjustedTtl, false, false);
     }
+    charge(shard, *sval, key.size());
+    publish(shard, key, *sval);
+    if (!present) {
+      addToClock(shard, *sval, kcp);
+    }
+  }
+  if (overBudget(shard)) {
+    evict(shard, key.data());
   }
   if (expiry) {
-    addToExpirationQueue(key.data(), expiry);
+    addToExpirationQueue(shard, key.data(), expiry);
   }
   if (apcExtension::ExpireOnSets) {
-    purgeExpired();
+    purgeExpired(shard);
   }
   if (present) {
     log_apc(std_apc_update);
@@ -511,24 +995,28 @@ bool ConcurrentTableSharedStore::store(CStrRef key, CVarRef value, int64_t ttl,
 }
 
 void ConcurrentTableSharedStore::prime(const std::vector<KeyValuePair> &vars) {
-  ConditionalReadLock l(m_lock, !apcExtension::ConcurrentTableLockFree ||
-                                m_lockingFlag);
   // we are priming, so we are not checking existence or expiration
   for (unsigned int i = 0; i < vars.size(); i++) {
     const KeyValuePair &item = vars[i];
-    Map::accessor acc;
+    Shard& shard = shardFor(item.key);
+    ConditionalReadLock l(shard.lock, lockedOps());
     const char *copy = strdup(item.key);
-    m_vars.insert(acc, copy);
-    if (item.inMem()) {
-      acc->second.set(item.value, 0);
-    } else {
-      acc->second.sAddr = item.sAddr;
-      acc->second.sSize = item.sSize;
-      continue;
-    }
-    if (RuntimeOption::APCSizeCountPrime) {
-      String str(copy, CopyString);
-      stats_on_add(str.get(), &acc->second, 0, true, false);
+    {
+      Map::accessor acc;
+      shard.vars.insert(acc, copy);
+      if (item.inMem()) {
+        acc->second.set(item.value, 0);
+        if (RuntimeOption::APCSizeCountPrime) {
+          String str(copy, CopyString);
+          stats_on_add(str.get(), &acc->second, 0, true, false);
+        }
+        charge(shard, acc->second, item.len);
+        publish(shard, copy, acc->second);
+      } else {
+        acc->second.sAddr = item.sAddr;
+        acc->second.sSize = item.sSize;
+      }
+      addToClock(shard, acc->second, acc->first);
     }
   }
 }
@@ -583,7 +1071,8 @@ void ConcurrentTableSharedStore::primeDone() {
     // initial accesses to the primed keys are not too bad. Still, for
     // the keys in file, a deserialization from memory is required on first
     // access.
-    addToExpirationQueue(apcExtension::FileStorageFlagKey.c_str(),
+    auto flagKey = apcExtension::FileStorageFlagKey.c_str();
+    addToExpirationQueue(shardFor(flagKey), flagKey,
                          time(nullptr) +
                          apcExtension::FileStorageAdviseOutPeriod);
   }
@@ -591,14 +1080,276 @@ void ConcurrentTableSharedStore::primeDone() {
   for (set<string>::const_iterator iter =
          apcExtension::CompletionKeys.begin();
        iter != apcExtension::CompletionKeys.end(); ++iter) {
-    Map::accessor acc;
+    Shard& shard = shardFor(iter->c_str());
     const char *copy = strdup(iter->c_str());
-    if (m_vars.insert(acc, copy)) {
+    {
+      Map::accessor acc;
+      if (!shard.vars.insert(acc, copy)) continue;
       acc->second.set(this->construct(1), 0);
+      charge(shard, acc->second, iter->size());
+      publish(shard, copy, acc->second);
+      addToClock(shard, acc->second, acc->first);
     }
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// snapshots
+
+namespace {
+
+const char kSnapshotMagic[8] = "HHVMAPC";
+const uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pad;
+  // APCSerialize output is only guaranteed to be readable by the same build
+  uint64_t buildHash;
+  uint64_t count;
+  uint64_t size; // of the whole file
+};
+
+/*
+ * Followed by the key and its '\0', then the value as apc_serialize()
+ * wrote it, then padding to 8 bytes.
+ */
+struct SnapshotEntry {
+  uint32_t keyLen;
+  int32_t sSize; // as in StoreValue
+  int64_t expiry;
+};
+
+size_t snapshot_entry_size(uint32_t keyLen, int32_t sSize) {
+  return (sizeof(SnapshotEntry) + keyLen + 1 + abs(sSize) + 7) & ~size_t(7);
+}
+
+/*
+ * BuildId is empty unless --build-id is given, so the binary's compiler
+ * id and repo schema go in too, the way PGO profiles are checked.
+ */
+uint64_t snapshot_build_hash() {
+  auto const hash = [] (const char* s, size_t len) -> uint64_t {
+    return hash_string_cs(s, len);
+  };
+  uint64_t h = hash(kCompilerId, strlen(kCompilerId));
+  h = hash_int64_pair(h, hash(kRepoSchemaId, strlen(kRepoSchemaId)));
+  return hash_int64_pair(h, hash(RuntimeOption::BuildId.data(),
+                                 RuntimeOption::BuildId.size()));
+}
+
+}
+
+bool ConcurrentTableSharedStore::dumpSnapshot(const std::string& path,
+                                              int waitSeconds) {
+  // Same deal as dump(): without the read locks, writers have to be
+  // given time to notice m_lockingFlag.
+  if (apcExtension::ConcurrentTableLockFree) {
+    m_lockingFlag = true;
+    int begin = time(nullptr);
+    while (time(nullptr) - begin < waitSeconds) {
+      sleep(1);
+    }
+  }
+  SCOPE_EXIT {
+    if (apcExtension::ConcurrentTableLockFree) m_lockingFlag = false;
+  };
+
+  // Write to a temporary and rename, so a crash mid-dump doesn't leave
+  // a broken snapshot for the next startup.
+  auto const tmpPath = path + ".tmp";
+  FILE* f = fopen(tmpPath.c_str(), "w");
+  if (!f) {
+    Logger::Error("Unable to open %s for writing", tmpPath.c_str());
+    return false;
+  }
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof header);
+  bool ok = fwrite(&header, sizeof header, 1, f) == 1;
+  uint64_t size = sizeof header;
+  auto write = [&] (const char* key, uint32_t keyLen, int32_t sSize,
+                    int64_t expiry, const char* data) {
+    SnapshotEntry e;
+    e.keyLen = keyLen;
+    e.sSize = sSize;
+    e.expiry = expiry;
+    static const char zeros[8] = {};
+    size_t n = snapshot_entry_size(keyLen, sSize);
+    size_t pad = n - sizeof e - keyLen - 1 - abs(sSize);
+    ok = ok &&
+      fwrite(&e, sizeof e, 1, f) == 1 &&
+      fwrite(key, 1, keyLen + 1, f) == keyLen + 1 &&
+      fwrite(data, 1, abs(sSize), f) == size_t(abs(sSize)) &&
+      fwrite(zeros, 1, pad, f) == pad;
+    size += n;
+    ++header.count;
+  };
+
+  struct Item {
+    std::string key;
+    int64_t expiry;
+    SharedVariant* var; // holds a reference
+    const char* sAddr;
+    int32_t sSize;
+    std::string data;
+  };
+  for (auto& shard : m_shards) {
+    std::vector<Item> items;
+    {
+      // Only collect under the lock: serializing big values here would
+      // hold up every writer to the shard.
+      WriteLock l(shard->lock);
+      items.reserve(shard->vars.size());
+      for (Map::iterator iter = shard->vars.begin();
+           iter != shard->vars.end(); ++iter) {
+        const StoreValue& sval = iter->second;
+        if (sval.expired()) continue;
+        Item item;
+        item.key = iter->first;
+        item.expiry = sval.expiry;
+        item.var = nullptr;
+        item.sAddr = nullptr;
+        item.sSize = 0;
+        if (sval.inFile()) {
+          // file storage and mapped snapshots stay put until we exit
+          item.sAddr = sval.sAddr;
+          item.sSize = sval.sSize;
+        } else if (IS_REFCOUNTED_TYPE(sval.var->getType())) {
+          item.var = sval.var;
+          item.var->incRef();
+        } else {
+          // Scalars can't be shared; they're cheap to serialize here.
+          String s = apc_serialize(sval.var->toLocal());
+          item.data.assign(s.data(), s.size());
+          item.sSize = s.size();
+        }
+        items.push_back(std::move(item));
+      }
+    }
+
+    for (auto& item : items) {
+      if (item.sAddr) {
+        write(item.key.c_str(), item.key.size(), item.sSize, item.expiry,
+              item.sAddr);
+        continue;
+      }
+      if (item.var) {
+        try {
+          String s = apc_serialize(item.var->toLocal());
+          item.data.assign(s.data(), s.size());
+          item.sSize = s.size();
+        } catch (Exception& e) {
+          Logger::Warning("APC snapshot skipped %s: %s", item.key.c_str(),
+                          e.getMessage().c_str());
+          item.var->decRef();
+          continue;
+        }
+        item.var->decRef();
+      }
+      write(item.key.c_str(), item.key.size(), item.sSize, item.expiry,
+            item.data.data());
+    }
+  }
+
+  memcpy(header.magic, kSnapshotMagic, sizeof kSnapshotMagic);
+  header.version = kSnapshotVersion;
+  header.buildHash = snapshot_build_hash();
+  header.size = size;
+  ok = ok && fseek(f, 0, SEEK_SET) == 0 &&
+    fwrite(&header, sizeof header, 1, f) == 1;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmpPath.c_str(), path.c_str())) {
+    Logger::Error("Unable to write APC snapshot %s", path.c_str());
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  Logger::Info("Wrote %" PRIu64 " APC items (%" PRIu64 " bytes) to %s",
+               header.count, size, path.c_str());
+  return true;
+}
+
+bool ConcurrentTableSharedStore::loadSnapshot(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false; // cold start
+  struct stat st;
+  if (fstat(fd, &st) || st.st_size < (off_t)sizeof(SnapshotHeader)) {
+    close(fd);
+    Logger::Warning("Ignoring truncated APC snapshot %s", path.c_str());
+    return false;
+  }
+  void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    Logger::Error("Unable to map APC snapshot %s", path.c_str());
+    return false;
+  }
+
+  auto const header = static_cast<const SnapshotHeader*>(base);
+  if (memcmp(header->magic, kSnapshotMagic, sizeof kSnapshotMagic) ||
+      header->version != kSnapshotVersion ||
+      header->buildHash != snapshot_build_hash() ||
+      header->size != uint64_t(st.st_size)) {
+    Logger::Warning("Ignoring APC snapshot %s from another build",
+                    path.c_str());
+    munmap(base, st.st_size);
+    return false;
+  }
+
+  // The mapping is never unmapped: StoreValues point into it until the
+  // process exits.
+  const char* p = reinterpret_cast<const char*>(header + 1);
+  const char* end = static_cast<const char*>(base) + st.st_size;
+  int64_t now = time(nullptr);
+  uint64_t mapped = 0, stored = 0;
+  for (uint64_t i = 0; i < header->count; ++i) {
+    auto const e = reinterpret_cast<const SnapshotEntry*>(p);
+    if (size_t(end - p) < sizeof *e ||
+        size_t(end - p) < snapshot_entry_size(e->keyLen, e->sSize)) {
+      Logger::Error("APC snapshot %s is corrupt after %" PRIu64 " items",
+                    path.c_str(), i);
+      break;
+    }
+    p += snapshot_entry_size(e->keyLen, e->sSize);
+    const char* key = reinterpret_cast<const char*>(e + 1);
+    const char* data = key + e->keyLen + 1;
+
+    if (e->expiry) {
+      // Only items without a TTL may stay in file storage (see
+      // eraseImpl), so these go straight into memory.
+      if (e->expiry <= now) continue;
+      try {
+        store(String(key, e->keyLen, CopyString),
+              apc_unserialize(data, abs(e->sSize)), e->expiry - now, false);
+        ++stored;
+      } catch (Exception& ex) {
+        Logger::Warning("APC snapshot skipped %s: %s", key,
+                        ex.getMessage().c_str());
+      }
+      continue;
+    }
+
+    Shard& shard = shardFor(key);
+    ConditionalReadLock l(shard.lock, lockedOps());
+    const char *copy = strdup(key);
+    {
+      Map::accessor acc;
+      if (!shard.vars.insert(acc, copy)) {
+        free((void *)copy);
+        continue;
+      }
+      acc->second.sAddr = const_cast<char*>(data);
+      acc->second.sSize = e->sSize;
+      addToClock(shard, acc->second, acc->first);
+    }
+    ++mapped;
+  }
+  Logger::Info("Loaded APC snapshot %s: %" PRIu64 " items mapped, %"
+               PRIu64 " stored", path.c_str(), mapped, stored);
+  return true;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // debugging support
 
@@ -615,35 +1366,38 @@ void ConcurrentTableSharedStore::dump(std::ostream & out, bool keyOnly,
       sleep(1);
     }
   }
-  WriteLock l(m_lock);
   Logger::Info("dumping apc");
-  out << "Total " << m_vars.size() << std::endl;
-  for (Map::iterator iter = m_vars.begin(); iter != m_vars.end(); ++iter) {
-    const char *key = iter->first;
-    out << key;
-    if (!keyOnly) {
-      out << " #### ";
-      const StoreValue *sval = &iter->second;
-      if (!sval->expired()) {
-        VariableSerializer vs(VariableSerializer::Type::Serialize);
-        Variant value;
-        if (sval->inMem()) {
-          value = sval->var->toLocal();
-        } else {
-          assert(sval->inFile());
-          // we need unserialize and serialize again because the format was
-          // APCSerialize
-          value = apc_unserialize(sval->sAddr, sval->getSerializedSize());
-        }
-        try {
-          String valS(vs.serialize(value, true));
-          out << valS->toCPPString();
-        } catch (const Exception &e) {
-          out << "Exception: " << e.what();
+  out << "Total " << size() << std::endl;
+  for (auto& shard : m_shards) {
+    WriteLock l(shard->lock);
+    for (Map::iterator iter = shard->vars.begin(); iter != shard->vars.end();
+         ++iter) {
+      const char *key = iter->first;
+      out << key;
+      if (!keyOnly) {
+        out << " #### ";
+        const StoreValue *sval = &iter->second;
+        if (!sval->expired()) {
+          VariableSerializer vs(VariableSerializer::Type::Serialize);
+          Variant value;
+          if (sval->inMem()) {
+            value = sval->var->toLocal();
+          } else {
+            assert(sval->inFile());
+            // we need unserialize and serialize again because the format was
+            // APCSerialize
+            value = apc_unserialize(sval->sAddr, sval->getSerializedSize());
+          }
+          try {
+            String valS(vs.serialize(value, true));
+            out << valS->toCPPString();
+          } catch (const Exception &e) {
+            out << "Exception: " << e.what();
+          }
         }
       }
+      out << std::endl;
     }
-    out << std::endl;
   }
   Logger::Info("dumping apc done");
   if (apcExtension::ConcurrentTableLockFree) {
@@ -19,6 +19,12 @@
 
 #define TBB_PREVIEW_CONCURRENT_PRIORITY_QUEUE 1
 
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hphp/util/lock.h"
 #include "hphp/util/smalllocks.h"
 #include "hphp/runtime/base/complex-types.h"
 #include "hphp/runtime/base/shared-variant.h"
@@ -35,10 +41,16 @@ namespace HPHP {
 //////////////////////////////////////////////////////////////////////
 
 struct StoreValue {
-  StoreValue() : var(nullptr), sAddr(nullptr), expiry(0), size(0), sSize(0) {}
+  StoreValue() : var(nullptr), sAddr(nullptr), expiry(0), size(0), sSize(0),
+                 charged(0), referenced(false), clockPrev(nullptr),
+                 clockNext(nullptr), clockKey(nullptr) {}
+  // A copy isn't in any CLOCK ring.
   StoreValue(const StoreValue& v) : var(v.var), sAddr(v.sAddr),
                                     expiry(v.expiry), size(v.size),
-                                    sSize(v.sSize) {}
+                                    sSize(v.sSize), charged(v.charged),
+                                    referenced(v.referenced.load()),
+                                    clockPrev(nullptr), clockNext(nullptr),
+                                    clockKey(nullptr) {}
   void set(SharedVariant *v, int64_t ttl);
   bool expired() const;
 
@@ -50,7 +62,17 @@ struct StoreValue {
   int64_t expiry;
   mutable int32_t size;
   int32_t sSize; // For file storage, negative means serailized object
+  // Bytes counted against apcExtension::MemoryBudget
+  mutable int32_t charged;
+  // CLOCK reference bit, set by fetches when there is a MemoryBudget
+  mutable std::atomic<bool> referenced;
   mutable SmallLock lock;
+  // Links in the shard's CLOCK ring, and the Map's copy of the key; only
+  // touched under the shard's clockLock.  Map nodes don't move, so the
+  // ring can point straight at them.
+  StoreValue* clockPrev;
+  StoreValue* clockNext;
+  const char* clockKey;
 
   bool inMem() const {
     return var != nullptr;
@@ -67,6 +89,70 @@ struct StoreValue {
   }
 };
 
+/*
+ * Lock-free read side of a ConcurrentTableSharedStore shard
+ * (apcExtension::LockFreeReads).
+ *
+ * A chained hash table of immutable Entries, mirroring the in-memory
+ * values in the shard's Map.  Writers update it while they hold the
+ * Map accessor for the key, so it always agrees with the Map, and
+ * serialize among themselves on m_writeLock.  Readers take no lock
+ * and write nothing: unlinked Entries and outgrown bucket arrays are
+ * handed to the Treadmill, and only freed once every request that
+ * could still be looking at them has finished.  That also keeps an
+ * Entry's var alive for the rest of any request that found it, so
+ * values fetched this way are pinned (SharedVariant::toLocal).
+ */
+class StoreReadIndex {
+public:
+  struct Entry {
+    std::atomic<Entry*> next;
+    SharedVariant* var; // holds a reference
+    int64_t expiry;
+    // CLOCK reference bit for lock-free fetches; see StoreValue
+    mutable std::atomic<bool> referenced;
+    strhash_t hash;
+    int32_t len;
+    char key[1];
+
+    bool expired() const;
+  };
+
+  StoreReadIndex();
+  ~StoreReadIndex();
+  StoreReadIndex(const StoreReadIndex&) = delete;
+  StoreReadIndex& operator=(const StoreReadIndex&) = delete;
+
+  /*
+   * Only safe inside a request (Treadmill::inRequest()); the Entry is
+   * valid until the request ends.
+   */
+  const Entry* find(const char* key, int32_t len, strhash_t hash) const;
+
+  void publish(const char* key, int32_t len, strhash_t hash,
+               SharedVariant* var, int64_t expiry);
+  void unpublish(const char* key, int32_t len, strhash_t hash);
+  void clear();
+
+  // Clear the reference bit on key's Entry, returning its old value.
+  bool takeReferenced(const char* key, int32_t len, strhash_t hash);
+
+private:
+  struct Table;
+  struct Retired;
+
+  static Table* makeTable(uint32_t nbuckets);
+  std::atomic<Entry*>* findLink(Table* t, const char* key, int32_t len,
+                                strhash_t hash) const;
+  void grow();
+
+  std::atomic<Table*> m_table;
+  // Keep the writer state off the line readers load m_table from.
+  char m_pad[64 - sizeof(std::atomic<Table*>)];
+  Mutex m_writeLock;
+  uint32_t m_count;
+};
+
 struct ConcurrentTableSharedStore {
   struct KeyValuePair {
     KeyValuePair() : value(nullptr), sAddr(nullptr) {}
@@ -83,17 +169,26 @@ struct ConcurrentTableSharedStore {
 
   static std::string GetSkeleton(CStrRef key);
 
-  explicit ConcurrentTableSharedStore(int id)
-    : m_id(id)
-    , m_lockingFlag(false)
-    , m_purgeCounter(0)
-  {}
+  explicit ConcurrentTableSharedStore(int id);
 
   ConcurrentTableSharedStore(const ConcurrentTableSharedStore&) = delete;
   ConcurrentTableSharedStore&
     operator=(const ConcurrentTableSharedStore&) = delete;
 
-  int size() const { return m_vars.size(); }
+  int size() const;
+
+  // Bytes charged against apcExtension::MemoryBudget, and what the CLOCK
+  // hands have evicted to stay within it.
+  int64_t memoryUsed() const {
+    return m_memUsed.load(std::memory_order_relaxed);
+  }
+  int64_t evictionCount() const {
+    return m_evictions.load(std::memory_order_relaxed);
+  }
+  int64_t evictedSize() const {
+    return m_evictedSize.load(std::memory_order_relaxed);
+  }
+
   bool get(CStrRef key, Variant &value);
   bool store(CStrRef key, CVarRef val, int64_t ttl,
                      bool overwrite = true);
@@ -108,6 +203,17 @@ struct ConcurrentTableSharedStore {
   bool constructPrime(CVarRef v, KeyValuePair& item);
   void primeDone();
 
+  /*
+   * Warm restarts (apcExtension::SnapshotFile).  dumpSnapshot writes
+   * every live item to path; loadSnapshot maps such a file read-only in
+   * the next process.  Items without a TTL are then served out of the
+   * mapping like primed items in file storage: unserialized on first
+   * fetch, and only copied into the table when overwritten.  Items with
+   * a TTL are loaded right away.  Keys already primed are left alone.
+   */
+  bool dumpSnapshot(const std::string& path, int waitSeconds);
+  bool loadSnapshot(const std::string& path);
+
   // debug support
   void dump(std::ostream & out, bool keyOnly, int waitSeconds);
 
@@ -161,23 +267,76 @@ private:
     }
   };
 
+  /*
+   * One of the store's independent partitions; a key always lives in
+   * the same shard (see shardFor()).
+   */
+  struct Shard {
+    Shard() : purgeCounter(0), memUsed(0), hand(nullptr), clockSize(0) {}
+
+    StoreReadIndex index;
+    Map vars;
+    // Read lock is acquired whenever using concurrent ops
+    // Write lock is acquired for whole table operations
+    ReadWriteMutex lock;
+    tbb::concurrent_priority_queue<ExpirationPair,
+                                   ExpirationCompare> expQueue;
+    ExpMap expMap;
+    std::atomic<uint64_t> purgeCounter;
+    // For apcExtension::MemoryBudget, of which each shard gets an equal
+    // share: the bytes charged to it, and a CLOCK ring through every
+    // StoreValue in vars, with the hand at the next one to look at.
+    // clockLock may be taken while holding a Map accessor, so it's
+    // never held while waiting for one.
+    std::atomic<int64_t> memUsed;
+    Mutex clockLock;
+    StoreValue* hand;
+    size_t clockSize;
+  };
+
 private:
   SharedVariant* construct(CVarRef v) {
     return SharedVariant::Create(v, false);
   }
 
+  Shard& shardFor(strhash_t hash) {
+    return *m_shards[((uint32_t)hash * 0x9e3779b1u) >> 16 & m_shardMask];
+  }
+  Shard& shardFor(CStrRef key) { return shardFor(key->hash()); }
+  Shard& shardFor(const char* key) { return shardFor(hash_string(key)); }
+
+  bool lockFreeReads() const;
+  // Whether single-key operations need the shard's read lock.
+  bool lockedOps() const;
+
+  // Bring the shard's StoreReadIndex in line with sval after it changed.
+  void publish(Shard& shard, CStrRef key, const StoreValue& sval);
+  void publish(Shard& shard, const char* key, const StoreValue& sval);
+
   bool eraseImpl(CStrRef key, bool expired);
 
-  void eraseAcc(Map::accessor &acc) {
+  // Bring memory use in line with sval after its var changed.
+  void charge(Shard& shard, const StoreValue& sval, int32_t keyLen);
+  void uncharge(Shard& shard, const StoreValue& sval);
+  bool overBudget(const Shard& shard) const;
+  // Both called holding the Map accessor for sval; key is the Map's copy.
+  void addToClock(Shard& shard, StoreValue& sval, const char* key);
+  void removeFromClock(Shard& shard, StoreValue& sval);
+  // Should be called with shard.lock held if lockedOps(), and no
+  // accessor.  Never evicts keep.
+  void evict(Shard& shard, const char* keep);
+
+  void eraseAcc(Shard& shard, Map::accessor &acc) {
     const char *pkey = acc->first;
-    m_vars.erase(acc);
+    removeFromClock(shard, acc->second);
+    shard.vars.erase(acc);
     free((void *)pkey);
   }
 
-  // Should be called outside m_lock
-  void purgeExpired();
+  // Should be called outside shard.lock
+  void purgeExpired(Shard& shard);
 
-  void addToExpirationQueue(const char* key, int64_t etime);
+  void addToExpirationQueue(Shard& shard, const char* key, int64_t etime);
 
   bool handleUpdate(CStrRef key, SharedVariant* svar);
   bool handlePromoteObj(CStrRef key, SharedVariant* svar, CVarRef valye);
@@ -185,16 +344,12 @@ private:
 
 private:
   int m_id;
-  Map m_vars;
-  // Read lock is acquired whenever using concurrent ops
-  // Write lock is acquired for whole table operations
-  ReadWriteMutex m_lock;
+  std::vector<std::unique_ptr<Shard>> m_shards;
+  uint32_t m_shardMask;
+  std::atomic<int64_t> m_memUsed;
+  std::atomic<int64_t> m_evictions;
+  std::atomic<int64_t> m_evictedSize;
   bool m_lockingFlag; // flag to enable temporary locking
-
-  tbb::concurrent_priority_queue<ExpirationPair,
-                                 ExpirationCompare> m_expQueue;
-  ExpMap m_expMap;
-  std::atomic<uint64_t> m_purgeCounter;
 };
 
 //////////////////////////////////////////////////////////////////////
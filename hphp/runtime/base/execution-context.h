@@ -488,6 +488,12 @@ private:
 OPCODES
 #undef O
 
+  // Superinstructions; see dispatchImpl().
+  bool fuse(Op op, PC& pc);
+  bool fuseCGetL(PC& pc);
+  bool fuseString(PC& pc);
+  bool fuseFPushFuncD(PC& pc);
+
   void classExistsImpl(PC& pc, Attr typeAttr);
   void fPushObjMethodImpl(
       Class* cls, StringData* name, ObjectData* obj, int numArgs);
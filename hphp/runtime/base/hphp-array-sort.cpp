@@ -15,11 +15,17 @@
 */
 
 #include "hphp/runtime/base/hphp-array.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
 #include "hphp/runtime/base/array-init.h"
 #include "hphp/runtime/base/array-iterator.h"
 #include "hphp/runtime/base/sort-helpers.h"
 #include "hphp/runtime/base/complex-types.h"
 #include "hphp/runtime/base/execution-context.h"
+#include "hphp/runtime/base/smart-containers.h"
 #include "hphp/runtime/vm/jit/translator-inline.h"
 
 // inline methods of HphpArray
@@ -58,13 +64,15 @@ struct ValAccessor {
  * types of values are also observed during this first pass. By observing the
  * types during this initial pass, we can often use a specialized comparator
  * and avoid performing type checks during the actual sort.
+ *
+ * A packed array stays packed when the sort renumbers the keys; otherwise it
+ * is converted to mixed first so the keys travel with their values.
  */
 template <typename AccessorT>
 HphpArray::SortFlavor
-HphpArray::preSort(const AccessorT& acc, bool checkTypes) {
+HphpArray::preSort(const AccessorT& acc, bool checkTypes, bool resetKeys) {
   assert(m_size > 0);
-  if (isPacked()) {
-    // todo t2607563: this is pessimistic.
+  if (isPacked() && !resetKeys) {
     packedToMixed();
   }
   if (!checkTypes && m_size == m_used) {
@@ -122,6 +130,11 @@ done:
  */
 void HphpArray::postSort(bool resetKeys) {
   assert(m_size > 0);
+  if (isPacked()) {
+    // no keys or hash to rebuild
+    assert(resetKeys);
+    return;
+  }
   size_t tableSize = computeTableSize(m_tableMask);
   initHash(tableSize);
   if (resetKeys) {
@@ -147,6 +160,134 @@ ArrayData* HphpArray::EscalateForSort(ArrayData* ad) {
   return asHphpArray(ad)->copyImpl();
 }
 
+/**
+ * Below this many elements the comparison sort is as fast as a radix sort
+ * and needs no extra memory.
+ */
+static const uint32_t kRadixSortMin = 1024;
+static const int kRadixBits = 11;
+static const int kRadixPasses = (64 + kRadixBits - 1) / kRadixBits;
+
+/**
+ * Maps an int to a uint64_t whose unsigned order is the requested order:
+ * with the sign bit flipped it's signed order, with every other bit flipped
+ * instead it's the reverse.
+ */
+static uint64_t radixKey(int64_t k, bool ascending) {
+  return uint64_t(k) ^ (ascending ? 1ull << 63 : ~(1ull << 63));
+}
+
+/**
+ * Stable LSD radix sort of recs by getKey(rec), kRadixBits per pass. Keys
+ * are sorted by their distance from the smallest one, so only as many
+ * passes are made as the spread of the keys needs; if that's more than
+ * maxPasses, recs is left alone and false is returned.
+ */
+template <class T, class GetKey>
+static bool radixSort(smart::vector<T>& recs, GetKey getKey, int maxPasses) {
+  auto const n = recs.size();
+  uint64_t lo = getKey(recs[0]);
+  uint64_t hi = lo;
+  for (auto const& r : recs) {
+    uint64_t k = getKey(r);
+    lo = std::min(lo, k);
+    hi = std::max(hi, k);
+  }
+  int numPasses = 0;
+  for (uint64_t spread = hi - lo; spread; spread >>= kRadixBits) {
+    ++numPasses;
+  }
+  if (numPasses > maxPasses) return false;
+  if (!numPasses) return true;
+
+  auto const mask = (1u << kRadixBits) - 1;
+  smart::vector<uint32_t> counts(numPasses << kRadixBits);
+  for (auto const& r : recs) {
+    uint64_t k = getKey(r) - lo;
+    for (int p = 0; p < numPasses; ++p) {
+      ++counts[(p << kRadixBits) + ((k >> (p * kRadixBits)) & mask)];
+    }
+  }
+  smart::vector<T> tmp(n);
+  for (int p = 0; p < numPasses; ++p) {
+    int shift = p * kRadixBits;
+    uint32_t* count = &counts[p << kRadixBits];
+    uint32_t offset = 0;
+    for (uint32_t d = 0; d <= mask; ++d) {
+      uint32_t c = count[d];
+      count[d] = offset;
+      offset += c;
+    }
+    for (auto const& r : recs) {
+      tmp[count[((getKey(r) - lo) >> shift) & mask]++] = r;
+    }
+    recs.swap(tmp);
+  }
+  return true;
+}
+
+/**
+ * sort() of an IntegerSort array compared numerically. Every value is a
+ * KindOfInt64 and postSort() renumbers the keys, so only the ints need to
+ * be sorted: they're radix sorted on their own and written back in order.
+ */
+static bool radixSortInts(HphpArray::Elm* data, uint32_t n,
+                          ValAccessor acc, bool ascending) {
+  smart::vector<uint64_t> keys(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    keys[i] = radixKey(acc.getInt(data[i]), ascending);
+  }
+  radixSort(keys, [] (uint64_t k) { return k; }, kRadixPasses);
+  for (uint32_t i = 0; i < n; ++i) {
+    assert(data[i].data.m_type == KindOfInt64);
+    data[i].data.m_data.num = radixKey(keys[i], ascending);
+  }
+  return true;
+}
+
+/**
+ * ksort() of an array with only int keys, compared numerically. The keys
+ * are sorted together with the position of their element, and the 24-byte
+ * elements are moved once at the end. Moving them costs about as much as
+ * the radix passes save when the keys are spread over most of the 64 bits,
+ * so those are left to the comparison sort.
+ */
+static bool radixSortInts(HphpArray::Elm* data, uint32_t n,
+                          KeyAccessor acc, bool ascending) {
+  struct KeyPos {
+    uint64_t key;
+    uint32_t pos;
+  };
+  smart::vector<KeyPos> recs(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    recs[i].key = radixKey(acc.getInt(data[i]), ascending);
+    recs[i].pos = i;
+  }
+  if (!radixSort(recs, [] (const KeyPos& r) { return r.key; },
+                 kRadixPasses - 2)) {
+    return false;
+  }
+  smart::vector<HphpArray::Elm> sorted(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    memcpy(&sorted[i], &data[recs[i].pos], sizeof(HphpArray::Elm));
+  }
+  memcpy(data, sorted.data(), n * sizeof(HphpArray::Elm));
+  return true;
+}
+
+static bool isNumericOrder(int sort_flags) {
+  switch (sort_flags) {
+    case SORT_STRING:
+    case SORT_LOCALE_STRING:
+    case SORT_NATURAL:
+    case SORT_NATURAL_CASE:
+      return false;
+    default:
+      // SORT_NUMERIC, and everything else sorts as SORT_REGULAR
+      return true;
+  }
+}
+
 #define SORT_CASE(flag, cmp_type, acc_type) \
   case flag: { \
     if (ascending) { \
@@ -168,8 +309,13 @@ ArrayData* HphpArray::EscalateForSort(ArrayData* ad) {
     SORT_CASE(SORT_NATURAL, cmp_type, acc_type) \
     SORT_CASE(SORT_NATURAL_CASE, cmp_type, acc_type) \
   }
-#define CALL_SORT(acc_type) \
-  if (flav == StringSort) { \
+#define CALL_SORT(acc_type, resetKeys) \
+  if (flav == IntegerSort && a->m_size >= kRadixSortMin && \
+      isNumericOrder(sort_flags) && \
+      (resetKeys || std::is_same<acc_type, KeyAccessor>::value) && \
+      radixSortInts(a->m_data, a->m_size, acc_type(), ascending)) { \
+    /* sorted without comparisons */ \
+  } else if (flav == StringSort) { \
     SORT_CASE_BLOCK(StrElm, acc_type) \
   } else if (flav == IntegerSort) { \
     SORT_CASE_BLOCK(IntElm, acc_type) \
@@ -185,10 +331,10 @@ ArrayData* HphpArray::EscalateForSort(ArrayData* ad) {
       } \
       return; \
     } \
-    SortFlavor flav = a->preSort<acc_type>(acc_type(), true); \
+    SortFlavor flav = a->preSort<acc_type>(acc_type(), true, resetKeys); \
     a->m_pos = ssize_t(0); \
     try { \
-      CALL_SORT(acc_type); \
+      CALL_SORT(acc_type, resetKeys); \
     } catch (...) { \
       /* Make sure we leave the array in a consistent state */ \
       a->postSort(resetKeys); \
@@ -225,7 +371,7 @@ void HphpArray::Asort(ArrayData* ad, int sort_flags, bool ascending) {
       }                                                         \
       return;                                                   \
     }                                                           \
-    a->preSort<acc_type>(acc_type(), false);                    \
+    a->preSort<acc_type>(acc_type(), false, resetKeys);         \
     a->m_pos = ssize_t(0);                                      \
     try {                                                       \
       ElmUCompare<acc_type> comp;                               \
@@ -247,6 +247,22 @@ public:
   static TypedValue GetCellIntPacked(const ArrayData* ad, int64_t ki);
   static uint64_t IssetIntPacked(const ArrayData* ad, int64_t ki);
 
+  /*
+   * Element i of a packed array, for code that walks one without an
+   * iterator (numeric folds, min/max).  It may be a Ref.
+   */
+  const TypedValue* packedElm(uint32_t i) const {
+    assert(isPacked() && i < m_size);
+    return &m_data[i].data;
+  }
+
+  /*
+   * Layout of packed element storage, for the JIT: element i's value is
+   * at m_data + i * sizeof(Elm) + elmDataOff().
+   */
+  static constexpr size_t dataOff() { return offsetof(HphpArray, m_data); }
+  static constexpr size_t elmDataOff() { return offsetof(Elm, data); }
+
   /*
    * Sorting routines.
    */
@@ -340,7 +356,7 @@ private:
   }
 
   template <typename AccessorT>
-  SortFlavor preSort(const AccessorT& acc, bool checkTypes);
+  SortFlavor preSort(const AccessorT& acc, bool checkTypes, bool resetKeys);
   void postSort(bool resetKeys);
 
   // convert in-place from kPackedKind to kMixedKind: fill in keys & hashtable
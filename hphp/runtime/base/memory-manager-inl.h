@@ -54,15 +54,43 @@ ALWAYS_INLINE void* MemoryManager::debugPreFree(void* p, size_t, size_t) {
 
 #endif
 
+inline void MemoryManager::arenaFree(size_t bytes) {
+  ++m_arenaFrees;
+  m_arenaDeadBytes += bytes;
+  m_arenaLeft -= bytes;
+  if (m_arenaLeft < 0) m_arenaLeft = 0;
+}
+
 //////////////////////////////////////////////////////////////////////
 
 inline uint32_t MemoryManager::smartSizeClass(uint32_t reqBytes) {
   assert(reqBytes <= kMaxSmartSize);
-  auto const ret = (reqBytes + kSmartSizeMask) & ~kSmartSizeMask;
+  if (LIKELY(reqBytes <= kMaxLinearSize)) {
+    return (reqBytes + kSmartSizeMask) & ~kSmartSizeMask;
+  }
+  // Round up to a multiple of a quarter of the enclosing power of two.
+  auto const lg = 31 - __builtin_clz(reqBytes - 1);
+  auto const mask = (uint32_t(1) << (lg - kLgSizesPerDoubling)) - 1;
+  auto const ret = (reqBytes + mask) & ~mask;
   assert(ret <= kMaxSmartSize);
   return ret;
 }
 
+inline uint32_t MemoryManager::smartSizeIndex(uint32_t bytes) {
+  assert(bytes > 0);
+  assert(bytes <= kMaxSmartSize);
+  if (LIKELY(bytes <= kMaxLinearSize)) {
+    return (bytes - 1) >> kLgSizeQuantum;
+  }
+  auto const lg = 31 - __builtin_clz(bytes - 1);
+  auto const sub = ((bytes - 1) >> (lg - kLgSizesPerDoubling)) &
+    ((1u << kLgSizesPerDoubling) - 1);
+  auto const ret = kNumLinearSizes +
+    ((lg - kLgMaxLinearSize) << kLgSizesPerDoubling) + sub;
+  assert(ret < kNumSizes);
+  return ret;
+}
+
 inline void* MemoryManager::smartMallocSize(uint32_t bytes) {
   assert(bytes > 0);
   assert(bytes <= kMaxSmartSize);
@@ -71,8 +99,7 @@ inline void* MemoryManager::smartMallocSize(uint32_t bytes) {
   // in the usage stats when we're going through smartMallocSize.
   m_stats.usage += bytes;
 
-  unsigned i = (bytes - 1) >> kLgSizeQuantum;
-  assert(i < kNumSizes);
+  unsigned i = smartSizeIndex(bytes);
   void* p = m_sizeUntrackedFree[i].maybePop();
   if (UNLIKELY(p == nullptr)) {
     p = slabAlloc(debugAddExtra(MemoryManager::smartSizeClass(bytes)));
@@ -88,10 +115,14 @@ inline void MemoryManager::smartFreeSize(void* ptr, uint32_t bytes) {
   assert(bytes <= kMaxSmartSize);
   assert(reinterpret_cast<uintptr_t>(ptr) % 16 == 0);
 
-  unsigned i = (bytes - 1) >> kLgSizeQuantum;
-  assert(i < kNumSizes);
-  m_sizeUntrackedFree[i].push(debugPreFree(ptr, bytes, bytes));
+  void* p = debugPreFree(ptr, bytes, bytes);
   m_stats.usage -= bytes;
+  if (UNLIKELY(m_arenaLeft > 0)) {
+    arenaFree(bytes);
+    return;
+  }
+  unsigned i = smartSizeIndex(bytes);
+  m_sizeUntrackedFree[i].push(p);
 
   FTRACE(1, "smartFreeSize: {} ({} bytes)\n", ptr, bytes);
 }
@@ -32,6 +32,7 @@
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/server/http-server.h"
 #include "hphp/util/alloc.h"
+#include "hphp/util/maphuge.h"
 #include "hphp/util/process.h"
 #include "hphp/util/trace.h"
 #include "folly/ScopeGuard.h"
@@ -165,6 +166,11 @@ void MemoryManager::OnThreadExit(MemoryManager* mm) {
 MemoryManager::MemoryManager()
     : m_front(nullptr)
     , m_limit(nullptr)
+    , m_slabsReused(0)
+    , m_slabsAllocated(0)
+    , m_arenaLeft(0)
+    , m_arenaFrees(0)
+    , m_arenaDeadBytes(0)
     , m_sweeping(false) {
 #ifdef USE_JEMALLOC
   threadStats(m_allocated, m_deallocated, m_cactive, m_cactiveLimit);
@@ -176,7 +182,18 @@ MemoryManager::MemoryManager()
   m_strings.next = m_strings.prev = &m_strings;
 }
 
+MemoryManager::~MemoryManager() {
+  for (auto slab : m_slabPool) {
+    free(slab);
+  }
+}
+
 void MemoryManager::resetStats() {
+  m_slabsReused = 0;
+  m_slabsAllocated = 0;
+  m_arenaLeft = 0;
+  m_arenaFrees = 0;
+  m_arenaDeadBytes = 0;
   m_stats.usage = 0;
   m_stats.alloc = 0;
   m_stats.peakUsage = 0;
@@ -191,6 +208,10 @@ void MemoryManager::resetStats() {
 #endif
 }
 
+void MemoryManager::beginArena(int64_t maxDeadBytes) {
+  m_arenaLeft = std::max<int64_t>(maxDeadBytes, 0);
+}
+
 NEVER_INLINE
 void MemoryManager::refreshStatsHelper() {
   refreshStats();
@@ -219,9 +240,15 @@ void MemoryManager::sweepAll() {
 void MemoryManager::rollback() {
   StringData::sweepAll();
 
-  // free smart-malloc slabs
+  // keep a few smart-malloc slabs warm for the next request on this
+  // thread, and give the rest back
+  size_t retain = std::max(RuntimeOption::ServerRetainedSlabs, 0);
   for (auto slab : m_slabs) {
-    free(slab);
+    if (m_slabPool.size() < retain) {
+      m_slabPool.push_back(slab);
+    } else {
+      free(slab);
+    }
   }
   m_slabs.clear();
 
@@ -247,7 +274,8 @@ void MemoryManager::checkMemory() {
   printf("Peak Usage: %" PRId64 " bytes\t", m_stats.peakUsage);
   printf("Peak Alloc: %" PRId64 " bytes\n", m_stats.peakAlloc);
 
-  printf("Slabs: %lu KiB\n", m_slabs.size() * SLAB_SIZE / 1024);
+  printf("Slabs: %lu KiB (%" PRId64 " reused, %" PRId64 " allocated)\n",
+         m_slabs.size() * SLAB_SIZE / 1024, m_slabsReused, m_slabsAllocated);
 }
 
 /*
@@ -255,7 +283,7 @@ void MemoryManager::checkMemory() {
  *
  * There are three kinds of smart mallocation:
  *
- *  a) Large allocations.  (size >= kMaxSmartSize)
+ *  a) Large allocations.  (size > kMaxSmartSize)
  *
  *     In this case we behave as a wrapper around the normal libc
  *     malloc/free.  We insert a SweepNode header at the front of the
@@ -272,7 +300,8 @@ void MemoryManager::checkMemory() {
  *     later.  We differentiate this from a SweepNode (for a big
  *     allocation) by assuming that no SweepNode::prev will point to
  *     an address in the first kMaxSmartSize bytes of virtual address
- *     space.
+ *     space.  (Linux won't map anything there unless mmap_min_addr
+ *     has been lowered below 64K.)
  *
  *  c) Size-untracked small allocation
  *
@@ -308,8 +337,7 @@ inline void* MemoryManager::smartMalloc(size_t nbytes) {
   nbytes = smartSizeClass(nbytes);
   m_stats.usage += nbytes;
 
-  auto const idx = (nbytes - 1) >> kLgSizeQuantum;
-  assert(idx < kNumSizes && idx >= 0);
+  auto const idx = smartSizeIndex(nbytes);
   void* vp = m_sizeTrackedFree[idx].maybePop();
   if (UNLIKELY(vp == nullptr)) {
     return smartMallocSlab(nbytes);
@@ -325,11 +353,13 @@ inline void MemoryManager::smartFree(void* ptr) {
   auto const padbytes = n->padbytes;
   if (LIKELY(padbytes <= kMaxSmartSize)) {
     assert(memset(ptr, kSmartFreeFill, padbytes - sizeof(SmallNode)));
-    auto const idx = (padbytes - 1) >> kLgSizeQuantum;
-    assert(idx < kNumSizes && idx >= 0);
     FTRACE(1, "smartFree: {}\n", ptr);
-    m_sizeTrackedFree[idx].push(ptr);
     m_stats.usage -= padbytes;
+    if (UNLIKELY(m_arenaLeft > 0)) {
+      arenaFree(padbytes);
+      return;
+    }
+    m_sizeTrackedFree[smartSizeIndex(padbytes)].push(ptr);
     return;
   }
   smartFreeBig(n);
@@ -370,6 +400,35 @@ inline void* MemoryManager::smartRealloc(void* inputPtr, size_t nbytes) {
   return debugPostAllocate(newNode + 1, 0, 0);
 }
 
+/*
+ * Reuse a slab retained by an earlier request on this thread, or
+ * malloc a fresh one.  With Server.HugeSlabs, fresh slabs are aligned
+ * to SLAB_SIZE so each one can be backed by a single huge page.
+ */
+char* MemoryManager::takeSlab() {
+  if (!m_slabPool.empty()) {
+    char* slab = m_slabPool.back();
+    m_slabPool.pop_back();
+    ++m_slabsReused;
+    return slab;
+  }
+  char* slab;
+  if (RuntimeOption::ServerHugeSlabs) {
+    void* mem;
+    if (posix_memalign(&mem, SLAB_SIZE, SLAB_SIZE) != 0) {
+      throw OutOfMemoryException(SLAB_SIZE);
+    }
+    hintHuge(mem, SLAB_SIZE);
+    slab = static_cast<char*>(mem);
+  } else {
+    slab = (char*) Util::safe_malloc(SLAB_SIZE);
+  }
+  // Only fresh slabs show up in jemalloc's per-thread counters.
+  JEMALLOC_STATS_ADJUST(&m_stats, SLAB_SIZE);
+  ++m_slabsAllocated;
+  return slab;
+}
+
 /*
  * Get a new slab, then allocate nbytes from it and install it in our
  * slab list.  Return the newly allocated nbytes-sized block.
@@ -378,9 +437,8 @@ NEVER_INLINE char* MemoryManager::newSlab(size_t nbytes) {
   if (UNLIKELY(m_stats.usage > m_stats.maxBytes)) {
     refreshStatsHelper();
   }
-  char* slab = (char*) Util::safe_malloc(SLAB_SIZE);
+  char* slab = takeSlab();
   assert(uintptr_t(slab) % 16 == 0);
-  JEMALLOC_STATS_ADJUST(&m_stats, SLAB_SIZE);
   m_stats.alloc += SLAB_SIZE;
   if (m_stats.alloc > m_stats.peakAlloc) {
     m_stats.peakAlloc = m_stats.alloc;
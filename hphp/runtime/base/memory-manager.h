@@ -158,7 +158,8 @@ struct MemoryManager : boost::noncopyable {
   typedef ThreadLocalSingleton<MemoryManager> TlsWrapper;
   struct MaskAlloc;
 
-  static constexpr size_t kMaxSmartSize = 2048;
+  static constexpr unsigned kLgMaxSmartSize = 16;
+  static constexpr size_t kMaxSmartSize = size_t(1) << kLgMaxSmartSize;
 
   static void Create(void* storage);
   static void Delete(MemoryManager*);
@@ -168,6 +169,7 @@ struct MemoryManager : boost::noncopyable {
   }
 
   MemoryManager();
+  ~MemoryManager();
 
   /**
    * Mark current allocator's position as ending point of a generation and
@@ -325,17 +327,51 @@ struct MemoryManager : boost::noncopyable {
     MemoryManager* const m_mm;
   };
 
+  /**
+   * Slabs this request took from the thread's retained pool, and slabs
+   * it had to malloc.  Reset with the other stats at session start.
+   */
+  int64_t getSlabsReused() const { return m_slabsReused; }
+  int64_t getSlabsAllocated() const { return m_slabsAllocated; }
+
+  /*
+   * Request arena mode.  Frees of small blocks become no-ops and the
+   * memory is only reclaimed when rollback() recycles the slabs.  Once
+   * maxDeadBytes of freed memory has piled up the arena closes, and
+   * frees go back on the free lists for the rest of the request.
+   * resetStats() turns arena mode off.
+   *
+   * Nothing can escape the arena: apc_store and static string/array
+   * promotion copy their input out of smart memory, the same as they
+   * do when the request's memory is swept normally.
+   */
+  void beginArena(int64_t maxDeadBytes);
+  bool inArena() const { return m_arenaLeft > 0; }
+  int64_t getArenaFrees() const { return m_arenaFrees; }
+  int64_t getArenaDeadBytes() const { return m_arenaDeadBytes; }
+
   /*
    * Return the smart size class for a given requested allocation
    * size.
    *
+   * Size classes are 16 bytes apart up to kMaxLinearSize, and four
+   * per doubling from there to kMaxSmartSize.
+   *
    * The return value is greater than or equal to the parameter, and
-   * less than or equal to MaxSmallSize.
+   * less than or equal to kMaxSmartSize.
    *
    * Pre: requested <= kMaxSmartSize
    */
   static uint32_t smartSizeClass(uint32_t requested);
 
+  /*
+   * Index of the free list for blocks of the given size.  All sizes
+   * that round up to the same smartSizeClass share an index.
+   *
+   * Pre: bytes > 0 && bytes <= kMaxSmartSize
+   */
+  static uint32_t smartSizeIndex(uint32_t bytes);
+
   /*
    * Allocate/deallocate a smart-allocated memory block in a given
    * small size class.  You must be able to tell the deallocation
@@ -429,11 +465,18 @@ private:
   };
 
   static constexpr unsigned kLgSizeQuantum = 4; // 16 bytes
-  static constexpr unsigned kNumSizes = kMaxSmartSize >> kLgSizeQuantum;
   static constexpr size_t kSmartSizeMask = (1 << kLgSizeQuantum) - 1;
+  static constexpr unsigned kLgMaxLinearSize = 11;
+  static constexpr size_t kMaxLinearSize = size_t(1) << kLgMaxLinearSize;
+  static constexpr unsigned kNumLinearSizes = kMaxLinearSize >> kLgSizeQuantum;
+  static constexpr unsigned kLgSizesPerDoubling = 2;
+  static constexpr unsigned kNumSizes = kNumLinearSizes +
+    ((kLgMaxSmartSize - kLgMaxLinearSize) << kLgSizesPerDoubling);
 
 private:
   char* newSlab(size_t nbytes);
+  char* takeSlab();
+  void arenaFree(size_t bytes);
   void* smartEnlist(SweepNode*);
   void* smartMallocSlab(size_t padbytes);
   void* smartMallocBig(size_t nbytes);
@@ -467,6 +510,13 @@ private:
   MemoryUsageStats m_stats;
 
   std::vector<char*> m_slabs;
+  // Slabs kept from earlier requests, up to Server.RetainedSlabs.
+  std::vector<char*> m_slabPool;
+  int64_t m_slabsReused;
+  int64_t m_slabsAllocated;
+  int64_t m_arenaLeft; // dead bytes allowed before the arena closes
+  int64_t m_arenaFrees;
+  int64_t m_arenaDeadBytes;
 
 #ifdef USE_JEMALLOC
   uint64_t* m_allocated;
@@ -41,7 +41,7 @@ struct HeapProfileServer {
 
   HeapProfileServer() :
     m_server(ServerFactoryRegistry::createServer(
-      RuntimeOption::ServerType,
+      RuntimeOption::AuxServerType(),
       RuntimeOption::ServerIP,
       RuntimeOption::HHProfServerPort,
       RuntimeOption::HHProfServerThreads
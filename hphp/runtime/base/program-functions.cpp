@@ -69,7 +69,10 @@
 
 #include "hphp/runtime/vm/runtime.h"
 #include "hphp/runtime/vm/repo.h"
+#include "hphp/runtime/vm/treadmill.h"
 #include "hphp/runtime/vm/jit/translator.h"
+#include "hphp/runtime/vm/jit/jit-workers.h"
+#include "hphp/runtime/vm/jit/prof-data-serialize.h"
 #include "hphp/compiler/builtin_symbols.h"
 
 using namespace boost::program_options;
@@ -1402,6 +1405,12 @@ void hphp_process_init() {
 
   PageletServer::Restart();
   XboxServer::Restart();
+  Transl::startJitWorkers();
+  Transl::startTCCollector();
+  if (RuntimeOption::EvalJitPGO &&
+      !RuntimeOption::EvalJitPGOProfilePath.empty()) {
+    JIT::loadPGOProfile(RuntimeOption::EvalJitPGOProfilePath);
+  }
   Stream::RegisterCoreWrappers();
   Extension::InitModules();
   for (InitFiniNode *in = extra_process_init; in; in = in->next) {
@@ -1410,6 +1419,9 @@ void hphp_process_init() {
   int64_t save = RuntimeOption::SerializationSizeLimit;
   RuntimeOption::SerializationSizeLimit = StringData::MaxSize;
   apc_load(apcExtension::LoadThread);
+  if (RuntimeOption::ServerExecutionMode()) {
+    apc_load_snapshot();
+  }
   RuntimeOption::SerializationSizeLimit = save;
 
   Transl::TargetCache::requestExit();
@@ -1579,6 +1591,12 @@ void hphp_session_exit() {
   // Server note has to live long enough for the access log to fire.
   // RequestLocal is too early.
   ServerNote::Reset();
+  // The treadmill is what keeps pinned APC values (see
+  // SharedVariant::toLocal) alive, and globals, statics and the sweep
+  // below can still be holding them, so the request only finishes as
+  // far as it's concerned once the heap is gone.
+  int64_t const treadmillIdx =
+    Treadmill::inRequest() ? g_vmContext->m_currentThreadIdx : -1;
   g_context.destroy();
 
   ThreadInfo::s_threadInfo->clearPendingException();
@@ -1609,6 +1627,7 @@ void hphp_session_exit() {
     free_global_variables_after_sweep();
     g_context.getCheck();
   }
+  if (treadmillIdx >= 0) Treadmill::finishRequest(treadmillIdx);
 
   ThreadInfo::s_threadInfo->onSessionExit();
 }
@@ -1616,6 +1635,16 @@ void hphp_session_exit() {
 void hphp_process_exit() {
   PageletServer::Stop();
   XboxServer::Stop();
+  Transl::stopTCCollector();
+  Transl::stopJitWorkers();
+  if (RuntimeOption::EvalJitPGO &&
+      !RuntimeOption::EvalJitPGOProfilePath.empty()) {
+    JIT::dumpPGOProfile(RuntimeOption::EvalJitPGOProfilePath);
+  }
+  if (RuntimeOption::ServerExecutionMode()) {
+    // Requests are done by now, so there's no need to wait for writers.
+    apc_dump_snapshot(0);
+  }
   Eval::Debugger::Stop();
   Extension::ShutdownModules();
   LightProcess::Close();
@@ -88,6 +88,7 @@ int64_t RuntimeOption::StringOffsetLimit = 10 * 1024 * 1024; // 10MB
 
 std::string RuntimeOption::AccessLogDefaultFormat;
 std::vector<AccessLogFileData> RuntimeOption::AccessLogs;
+int64_t RuntimeOption::AccessLogBufferSize = 16 << 20;
 
 std::string RuntimeOption::AdminLogFormat;
 std::string RuntimeOption::AdminLogFile;
@@ -104,6 +105,7 @@ int RuntimeOption::ServerPort;
 int RuntimeOption::ServerPortFd = -1;
 int RuntimeOption::ServerBacklog = 128;
 int RuntimeOption::ServerConnectionLimit = 0;
+int RuntimeOption::ServerEventLoops = 0;
 int RuntimeOption::ServerThreadCount = 50;
 bool RuntimeOption::ServerThreadRoundRobin = false;
 constexpr int kDefaultWarmupThrottleRequestCount = 0;
@@ -112,7 +114,10 @@ int RuntimeOption::ServerWarmupThrottleRequestCount =
 int RuntimeOption::ServerThreadDropCacheTimeoutSeconds = 0;
 int RuntimeOption::ServerThreadJobLIFOSwitchThreshold = INT_MAX;
 int RuntimeOption::ServerThreadJobMaxQueuingMilliSeconds = -1;
+int RuntimeOption::ServerThreadJobCoDelTargetMilliSeconds = 0;
+int RuntimeOption::ServerThreadJobCoDelIntervalMilliSeconds = 100;
 bool RuntimeOption::ServerThreadDropStack = false;
+bool RuntimeOption::ServerThreadNumaBind = false;
 bool RuntimeOption::ServerHttpSafeMode = false;
 bool RuntimeOption::ServerStatCache = true;
 std::vector<std::string> RuntimeOption::ServerWarmupRequests;
@@ -127,6 +132,12 @@ int RuntimeOption::FiberCount = 1;
 int RuntimeOption::RequestTimeoutSeconds = 0;
 int RuntimeOption::PspTimeoutSeconds = 0;
 size_t RuntimeOption::ServerMemoryHeadRoom = 0;
+int RuntimeOption::ServerRetainedSlabs = 4;
+bool RuntimeOption::ServerHugeSlabs = false;
+bool RuntimeOption::ServerRequestArena = false;
+boost::container::flat_set<std::string>
+RuntimeOption::ServerRequestArenaEndPoints;
+int64_t RuntimeOption::ServerRequestArenaMaxDeadBytes = 64 << 20;
 int64_t RuntimeOption::RequestMemoryMaxBytes =
   std::numeric_limits<int64_t>::max();
 int64_t RuntimeOption::ImageMemoryMaxBytes = 0;
@@ -159,6 +170,7 @@ int64_t RuntimeOption::UploadMaxFileSize;
 std::string RuntimeOption::UploadTmpDir;
 bool RuntimeOption::EnableFileUploads;
 bool RuntimeOption::EnableUploadProgress;
+bool RuntimeOption::UploadKeepRawPostData = false;
 int RuntimeOption::Rfc1867Freq;
 std::string RuntimeOption::Rfc1867Prefix;
 std::string RuntimeOption::Rfc1867Name;
@@ -213,6 +225,10 @@ bool RuntimeOption::EnableStaticContentCache = true;
 bool RuntimeOption::EnableStaticContentFromDisk = true;
 bool RuntimeOption::EnableOnDemandUncompress = true;
 bool RuntimeOption::EnableStaticContentMMap = true;
+int RuntimeOption::StaticContentStatSeconds = 2;
+int64_t RuntimeOption::StaticContentCacheSize = 64 << 20;
+bool RuntimeOption::StaticContentMMapFromDisk = false;
+bool RuntimeOption::StaticContentGzipSidecar = false;
 
 bool RuntimeOption::Utf8izeReplace = true;
 
@@ -291,6 +307,7 @@ std::string RuntimeOption::StatsXSL;
 std::string RuntimeOption::StatsXSLProxy;
 int RuntimeOption::StatsSlotDuration = 10 * 60; // 10 minutes
 int RuntimeOption::StatsMaxSlot = 12 * 6; // 12 hours
+int RuntimeOption::StatsMaxEndpoints = 64;
 
 bool RuntimeOption::EnableAPCSizeStats = false;
 bool RuntimeOption::EnableAPCSizeGroup = false;
@@ -637,6 +654,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
                                       getString(AccessLogDefaultFormat)));
       }
     }
+    AccessLogBufferSize = logger["AccessLogBufferSize"].getInt64(16 << 20);
 
     AdminLogFormat = logger["AdminLog.Format"].getString("%h %t %s %U");
     AdminLogFile = logger["AdminLog.File"].getString();
@@ -696,6 +714,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     ServerPort = server["Port"].getUInt16(80);
     ServerBacklog = server["Backlog"].getInt16(128);
     ServerConnectionLimit = server["ConnectionLimit"].getInt16(0);
+    ServerEventLoops = server["EventLoops"].getInt32(0);
     ServerThreadCount = server["ThreadCount"].getInt32(50);
     ServerThreadRoundRobin = server["ThreadRoundRobin"].getBool();
     ServerWarmupThrottleRequestCount =
@@ -712,7 +731,12 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
         ServerThreadJobLIFOSwitchThreshold);
     ServerThreadJobMaxQueuingMilliSeconds =
       server["ThreadJobMaxQueuingMilliSeconds"].getInt16(-1);
+    ServerThreadJobCoDelTargetMilliSeconds =
+      server["ThreadJobCoDelTargetMilliSeconds"].getInt32(0);
+    ServerThreadJobCoDelIntervalMilliSeconds =
+      server["ThreadJobCoDelIntervalMilliSeconds"].getInt32(100);
     ServerThreadDropStack = server["ThreadDropStack"].getBool();
+    ServerThreadNumaBind = server["ThreadNumaBind"].getBool();
     ServerHttpSafeMode = server["HttpSafeMode"].getBool();
     ServerStatCache = server["StatCache"].getBool(true);
     server["WarmupRequests"].get(ServerWarmupRequests);
@@ -721,6 +745,12 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     RequestTimeoutSeconds = server["RequestTimeoutSeconds"].getInt32(0);
     PspTimeoutSeconds = server["PspTimeoutSeconds"].getInt32(0);
     ServerMemoryHeadRoom = server["MemoryHeadRoom"].getInt64(0);
+    ServerRetainedSlabs = server["RetainedSlabs"].getInt32(4);
+    ServerHugeSlabs = server["HugeSlabs"].getBool(hugePagesSoundNice());
+    Hdf arena = server["RequestArena"];
+    ServerRequestArena = arena["Enable"].getBool();
+    arena["EndPoints"].get(ServerRequestArenaEndPoints);
+    ServerRequestArenaMaxDeadBytes = arena["MaxDeadBytes"].getInt64(64 << 20);
     RequestMemoryMaxBytes = server["RequestMemoryMaxBytes"].
       getInt64(std::numeric_limits<int64_t>::max());
     ResponseQueueCount = server["ResponseQueueCount"].getInt32(0);
@@ -805,6 +835,14 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     if (EnableStaticContentMMap) {
       EnableOnDemandUncompress = true;
     }
+    StaticContentStatSeconds =
+      server["StaticContentStatSeconds"].getInt32(2);
+    StaticContentCacheSize =
+      server["StaticContentCacheSize"].getInt64(64 << 20);
+    StaticContentMMapFromDisk =
+      server["StaticContentMMapFromDisk"].getBool(false);
+    StaticContentGzipSidecar =
+      server["StaticContentGzipSidecar"].getBool(false);
     Utf8izeReplace = server["Utf8izeReplace"].getBool(true);
 
     StartupDocument = server["StartupDocument"].getString();
@@ -865,6 +903,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
     RuntimeOption::AllowedDirectories.push_back(UploadTmpDir);
     EnableFileUploads = upload["EnableFileUploads"].getBool(true);
     EnableUploadProgress = upload["EnableUploadProgress"].getBool();
+    UploadKeepRawPostData = upload["KeepRawPostData"].getBool(false);
     Rfc1867Freq = upload["Rfc1867Freq"].getInt32(256 * 1024);
     if (Rfc1867Freq < 0) Rfc1867Freq = 256 * 1024;
     Rfc1867Prefix = upload["Rfc1867Prefix"].getString("vupload_");
@@ -1046,6 +1085,7 @@ void RuntimeOption::Load(Hdf &config, StringVec *overwrites /* = NULL */,
 
     StatsSlotDuration = stats["SlotDuration"].getInt32(10 * 60); // 10 minutes
     StatsMaxSlot = stats["MaxSlot"].getInt32(12 * 6); // 12 hours
+    StatsMaxEndpoints = stats["MaxEndpoints"].getInt32(64);
 
     {
       Hdf apcSize = stats["APCSize"];
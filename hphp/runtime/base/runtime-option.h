@@ -45,6 +45,13 @@ public:
     return strcmp(ExecutionMode, "cli") == 0;
   }
 
+  // Server.Type for the admin, satellite and profiling servers. A reuseport
+  // server pins one event loop to each CPU, which only the page server gets
+  // to do; the others stay on a single libevent loop.
+  static std::string AuxServerType() {
+    return ServerType == "reuseport" ? "libevent" : ServerType;
+  }
+
   static const char *ExecutionMode;
   static std::string BuildId;
   static std::string InstanceId;
@@ -83,6 +90,7 @@ public:
 
   static std::string AccessLogDefaultFormat;
   static std::vector<AccessLogFileData> AccessLogs;
+  static int64_t AccessLogBufferSize;
 
   static std::string AdminLogFormat;
   static std::string AdminLogFile;
@@ -98,13 +106,17 @@ public:
   static int ServerPortFd;
   static int ServerBacklog;
   static int ServerConnectionLimit;
+  static int ServerEventLoops;
   static int ServerThreadCount;
   static int ServerWarmupThrottleRequestCount;
   static bool ServerThreadRoundRobin;
   static int ServerThreadDropCacheTimeoutSeconds;
   static int ServerThreadJobLIFOSwitchThreshold;
   static int ServerThreadJobMaxQueuingMilliSeconds;
+  static int ServerThreadJobCoDelTargetMilliSeconds;
+  static int ServerThreadJobCoDelIntervalMilliSeconds;
   static bool ServerThreadDropStack;
+  static bool ServerThreadNumaBind;
   static bool ServerHttpSafeMode;
   static bool ServerStatCache;
   static std::vector<std::string> ServerWarmupRequests;
@@ -119,6 +131,11 @@ public:
   static int RequestTimeoutSeconds;
   static int PspTimeoutSeconds;
   static size_t ServerMemoryHeadRoom;
+  static int ServerRetainedSlabs;
+  static bool ServerHugeSlabs;
+  static bool ServerRequestArena;
+  static boost::container::flat_set<std::string> ServerRequestArenaEndPoints;
+  static int64_t ServerRequestArenaMaxDeadBytes;
   static int64_t RequestMemoryMaxBytes;
   static int64_t ImageMemoryMaxBytes;
   static int ResponseQueueCount;
@@ -150,6 +167,7 @@ public:
   static std::string UploadTmpDir;
   static bool EnableFileUploads;
   static bool EnableUploadProgress;
+  static bool UploadKeepRawPostData;
   static int Rfc1867Freq;
   static std::string Rfc1867Prefix;
   static std::string Rfc1867Name;
@@ -205,6 +223,10 @@ public:
   static bool EnableStaticContentFromDisk;
   static bool EnableOnDemandUncompress;
   static bool EnableStaticContentMMap;
+  static int StaticContentStatSeconds;
+  static int64_t StaticContentCacheSize;
+  static bool StaticContentMMapFromDisk;
+  static bool StaticContentGzipSidecar;
 
   static bool Utf8izeReplace;
 
@@ -278,6 +300,7 @@ public:
   static std::string StatsXSLProxy;
   static int StatsSlotDuration;
   static int StatsMaxSlot;
+  static int StatsMaxEndpoints;
 
   static bool EnableAPCSizeStats;
   static bool EnableAPCSizeGroup;
@@ -372,8 +395,11 @@ public:
   F(bool, ProfileHWEnable,             true)                            \
   F(string, ProfileHWEvents,           string(""))                      \
   F(bool, JitAlwaysInterpOne,          false)                           \
+  F(bool, InterpSuperInstrs,           true)                            \
   F(uint32_t, JitMaxTranslations,      12)                              \
   F(uint64_t, JitGlobalTranslationLimit, -1)                            \
+  F(uint32_t, JitTCCollectPercent,     0)                               \
+  F(uint32_t, JitTCCollectInterval,    60)                              \
   F(bool, JitTrampolines,              true)                            \
   F(string, JitProfilePath,            string(""))                      \
   F(bool, JitTypePrediction,           true)                            \
@@ -387,6 +413,7 @@ public:
                                                                         \
   F(bool, JitDisabledByHphpd,          false)                           \
   F(bool, ThreadingJit,                false)                           \
+  F(uint32_t, JitWorkerThreads,        1)                               \
   F(bool, JitTransCounters,            false)                           \
   F(bool, HHIRGenericDtorHelper,       true)                            \
   F(bool, HHIRCse,                     true)                            \
@@ -416,6 +443,11 @@ public:
   F(uint64_t, JitPGOThreshold,         kDefaultJitPGOThreshold)         \
   F(bool,     JitPGOHotOnly,           ServerExecutionMode())           \
   F(bool,     JitPGOUsePostConditions, true)                            \
+  F(string,   JitPGOProfilePath,       string(""))                      \
+  F(uint32_t, JitPGOProfileMaxRegions, 100000)                          \
+  F(bool,     JitPGOHotLayout,         true)                            \
+  F(uint32_t, JitPGOMinArcPercent,     0)                               \
+  F(uint32_t, JitPGOLoopUnroll,        1)                               \
   F(bool, HHIRRelaxGuards,             hhirRelaxGuardsDefault())        \
   F(bool, HHBCRelaxGuards,             hhbcRelaxGuardsDefault())        \
   /* DumpBytecode =1 dumps user php, =2 dumps systemlib & user php */   \
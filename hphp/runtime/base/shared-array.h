@@ -30,12 +30,13 @@ namespace HPHP {
  * Wrapper for a shared memory map.
  */
 class SharedArray : public ArrayData, Sweepable {
-  explicit SharedArray(SharedVariant* source)
+  explicit SharedArray(SharedVariant* source, bool pinned = false)
     : ArrayData(kSharedKind)
     , m_arr(source)
-    , m_localCache(nullptr) {
+    , m_localCache(nullptr)
+    , m_pinned(pinned) {
     m_size = m_arr->arrSize();
-    source->incRef();
+    if (!pinned) source->incRef();
   }
 
   ~SharedArray();
@@ -118,7 +119,7 @@ public:
   static ArrayData* EscalateForSort(ArrayData*);
 
   // implements Sweepable.sweep()
-  void sweep() FOLLY_OVERRIDE { m_arr->decRef(); }
+  void sweep() FOLLY_OVERRIDE { if (!m_pinned) m_arr->decRef(); }
 
 private:
   ssize_t getIndex(int64_t k) const;
@@ -130,6 +131,9 @@ public:
   void getChildren(std::vector<TypedValue *> &out);
   SharedVariant *m_arr;
   mutable TypedValue* m_localCache;
+  // m_arr outlives the request (see SharedVariant::toLocal), so no
+  // reference is held on it, and elements are wrapped pinned as well.
+  bool m_pinned;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -164,7 +164,8 @@ ALWAYS_INLINE void StringData::enlist() {
 }
 
 HOT_FUNC NEVER_INLINE
-StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len) {
+StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len,
+                                       bool pinned) {
   auto const data       = shared->stringData();
   auto const hash       = shared->rawStringData()->m_hash & STRHASH_MASK;
   auto const capAndHash = static_cast<uint64_t>(hash) << 32;
@@ -178,8 +179,11 @@ StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len) {
   sd->m_capAndHash  = capAndHash;
 
   sd->sharedPayload()->shared = shared;
-  sd->enlist();
-  shared->incRef();
+  sd->sharedPayload()->pinned = pinned;
+  if (!pinned) {
+    sd->enlist();
+    shared->incRef();
+  }
 
   assert(sd->m_len == len);
   assert(sd->m_count == 0);
@@ -189,14 +193,14 @@ StringData* StringData::MakeSVSlowPath(SharedVariant* shared, uint32_t len) {
   return sd;
 }
 
-StringData* StringData::Make(SharedVariant* shared) {
+StringData* StringData::Make(SharedVariant* shared, bool pinned) {
   // No need to check if len > MaxSize, because if it were we'd never
   // have made the StringData in the SharedVariant without throwing.
   assert(size_t(shared->stringLength()) <= size_t(MaxSize));
 
   auto const len        = shared->stringLength();
   if (UNLIKELY(len > SmallStringReserve)) {
-    return MakeSVSlowPath(shared, len);
+    return MakeSVSlowPath(shared, len, pinned);
   }
 
   auto const psrc       = shared->stringData();
@@ -234,7 +238,7 @@ StringData* StringData::Make(SharedVariant* shared) {
 }
 
 HOT_FUNC
-Variant SharedVariant::toLocal() {
+Variant SharedVariant::toLocal(bool pinned /* = false */) {
   switch (m_type) {
   case KindOfBoolean:
     {
@@ -254,14 +258,14 @@ Variant SharedVariant::toLocal() {
     }
   case KindOfString:
     {
-      return StringData::Make(this);
+      return StringData::Make(this, pinned);
     }
   case KindOfArray:
     {
       if (getSerializedArray()) {
         return apc_unserialize(m_data.str->data(), m_data.str->size());
       }
-      return SharedArray::Make(this);
+      return SharedArray::Make(this, pinned);
     }
   case KindOfUninit:
   case KindOfNull:
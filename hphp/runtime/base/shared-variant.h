@@ -83,7 +83,13 @@ public:
     }
   }
 
-  Variant toLocal();
+  /*
+   * Request-local copy of the value.  Strings and arrays are wrappers
+   * around this SharedVariant that hold a reference to it, unless it's
+   * pinned: known to stay alive until the current request ends, as
+   * values fetched through a StoreReadIndex are.
+   */
+  Variant toLocal(bool pinned = false);
 
   int64_t intData() const {
     assert(is(KindOfInt64));
@@ -52,6 +52,9 @@ namespace Stats {
   STAT(TgtCache_MethodMiss) \
   STAT(TgtCache_MethodFast) \
   STAT(TgtCache_MethodBypass) \
+  STAT(TgtCache_MethodInlineHit) \
+  STAT(TgtCache_MethodChainHit) \
+  STAT(TgtCache_MethodMegamorphic) \
   STAT(TgtCache_GlobalHit) \
   STAT(TgtCache_GlobalMiss) \
   STAT(TgtCache_StaticMethodHit) \
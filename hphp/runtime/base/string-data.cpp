@@ -239,8 +239,10 @@ void StringData::releaseDataSlowPath() {
   assert(isShared());
   assert(checkSane());
 
-  sharedPayload()->shared->decRef();
-  delist();
+  if (!sharedPayload()->pinned) {
+    sharedPayload()->shared->decRef();
+    delist();
+  }
   freeForSize(this, sizeof(StringData) + sizeof(SharedPayload));
 }
 
@@ -124,9 +124,10 @@ struct StringData {
 
   /*
    * Create a request-local StringData that wraps an APC SharedVariant
-   * that contains a string.
+   * that contains a string.  If pinned, shared is known to outlive the
+   * current request and the string doesn't hold a reference to it.
    */
-  static StringData* Make(SharedVariant* shared);
+  static StringData* Make(SharedVariant* shared, bool pinned = false);
 
   /*
    * Create a StringData that is allocated by malloc, instead of the
@@ -417,12 +418,14 @@ struct StringData {
 
 private:
   struct SharedPayload {
-    SweepNode node;
+    SweepNode node; // unused if pinned
     SharedVariant* shared;
+    bool pinned;
   };
 
 private:
-  static StringData* MakeSVSlowPath(SharedVariant*, uint32_t len);
+  static StringData* MakeSVSlowPath(SharedVariant*, uint32_t len,
+                                    bool pinned);
 
   StringData(const StringData&) = delete;
   StringData& operator=(const StringData&) = delete;
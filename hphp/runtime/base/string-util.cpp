@@ -207,6 +207,13 @@ String StringUtil::HtmlEncode(CStrRef input, QuoteStyle quoteStyle,
   }
 
   int len = input.size();
+  // Most input has nothing to encode; share it rather than copying it.
+  if (string_html_encode_scan(input.data(), len,
+                              quoteStyle != QuoteStyle::No,
+                              quoteStyle == QuoteStyle::Both,
+                              utf8, nbsp) == len) {
+    return input;
+  }
   char *ret = string_html_encode(input.data(), len,
                                  quoteStyle != QuoteStyle::No,
                                  quoteStyle == QuoteStyle::Both,
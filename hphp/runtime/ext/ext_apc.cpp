@@ -71,6 +71,10 @@ void apcExtension::moduleLoad(Hdf config) {
   FileStorageKeepFileLinked = fileStorage["KeepFileLinked"].getBool();
 
   ConcurrentTableLockFree = apc["ConcurrentTableLockFree"].getBool(false);
+  ShardCount = apc["ShardCount"].getInt32(16);
+  LockFreeReads = apc["LockFreeReads"].getBool(true);
+  MemoryBudget = apc["MemoryBudget"].getInt64(0);
+  SnapshotFile = apc["SnapshotFile"].getString();
   KeyMaturityThreshold = apc["KeyMaturityThreshold"].getInt32(20);
   MaximumCapacity = apc["MaximumCapacity"].getInt64(0);
   KeyFrequencyUpdatePeriod = apc["KeyFrequencyUpdatePeriod"].getInt32(1000);
@@ -122,6 +126,10 @@ std::string apcExtension::FileStoragePrefix;
 int apcExtension::FileStorageAdviseOutPeriod = 1800;
 std::string apcExtension::FileStorageFlagKey;
 bool apcExtension::ConcurrentTableLockFree = false;
+int apcExtension::ShardCount = 16;
+bool apcExtension::LockFreeReads = true;
+int64_t apcExtension::MemoryBudget = 0;
+std::string apcExtension::SnapshotFile;
 bool apcExtension::FileStorageKeepFileLinked = false;
 std::vector<std::string> apcExtension::NoTTLPrefix;
 
@@ -295,10 +303,28 @@ Variant f_apc_exists(CVarRef key, int64_t cache_id /* = 0 */) {
   return s_apc_store[cache_id].exists(key.toString());
 }
 
-const StaticString s_start_time("start_time");
+const StaticString
+  s_start_time("start_time"),
+  s_num_entries("num_entries"),
+  s_mem_size("mem_size"),
+  s_memory_budget("memory_budget"),
+  s_num_evictions("num_evictions"),
+  s_evicted_size("evicted_size");
 
 Variant f_apc_cache_info(int64_t cache_id /* = 0 */, bool limited /* = false */) {
-  return make_map_array(s_start_time, start_time());
+  if (cache_id < 0 || cache_id >= MAX_SHARED_STORE) {
+    throw_invalid_argument("cache_id: %" PRId64, cache_id);
+    return false;
+  }
+  ConcurrentTableSharedStore& store = s_apc_store[cache_id];
+  ArrayInit info(6);
+  info.set(s_start_time, start_time());
+  info.set(s_num_entries, store.size());
+  info.set(s_mem_size, store.memoryUsed());
+  info.set(s_memory_budget, apcExtension::MemoryBudget);
+  info.set(s_num_evictions, store.evictionCount());
+  info.set(s_evicted_size, store.evictedSize());
+  return info.create();
 }
 
 Array f_apc_sma_info(bool limited /* = false */) {
@@ -1370,6 +1396,22 @@ String apc_reserialize(CStrRef str) {
 ///////////////////////////////////////////////////////////////////////////////
 // debugging support
 
+bool apc_load_snapshot() {
+  if (!apcExtension::Enable || apcExtension::SnapshotFile.empty()) {
+    return false;
+  }
+  Timer timer(Timer::WallTime, "loading APC snapshot");
+  return s_apc_store[0].loadSnapshot(apcExtension::SnapshotFile);
+}
+
+bool apc_dump_snapshot(int waitSeconds) {
+  if (!apcExtension::Enable || apcExtension::SnapshotFile.empty()) {
+    return false;
+  }
+  return s_apc_store[0].dumpSnapshot(apcExtension::SnapshotFile,
+                                     waitSeconds);
+}
+
 bool apc_dump(const char *filename, bool keyOnly, int waitSeconds) {
   const int CACHE_ID = 0; /* 0 is used as default for apc */
   std::ofstream out(filename);
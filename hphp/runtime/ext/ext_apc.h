@@ -55,6 +55,10 @@ class apcExtension : public Extension {
   static int FileStorageAdviseOutPeriod;
   static std::string FileStorageFlagKey;
   static bool ConcurrentTableLockFree;
+  static int ShardCount;
+  static bool LockFreeReads;
+  static int64_t MemoryBudget;
+  static std::string SnapshotFile;
   static bool FileStorageKeepFileLinked;
   static std::vector<std::string> NoTTLPrefix;
 
@@ -102,6 +106,10 @@ bool f_apc_bin_loadfile(CStrRef filename,
 
 void apc_load(int thread);
 
+// warm restarts through apcExtension::SnapshotFile
+bool apc_load_snapshot();
+bool apc_dump_snapshot(int waitSeconds);
+
 // needed by generated apc archive .cpp files
 void apc_load_impl(struct cache_info *info,
                    const char **int_keys, long long *int_values,
@@ -16,6 +16,7 @@
 */
 
 #include "hphp/runtime/ext/ext_math.h"
+#include "hphp/runtime/base/hphp-array.h"
 #include "hphp/runtime/base/zend-math.h"
 #include "hphp/runtime/base/zend-multiply.h"
 
@@ -29,11 +30,53 @@ const int64_t k_PHP_ROUND_HALF_ODD =  PHP_ROUND_HALF_ODD;
 
 double f_pi() { return k_M_PI;}
 
+/*
+ * min() or max() of a packed array whose elements are all ints or all
+ * doubles, compared in place rather than copied out into Variants.  For
+ * those types less() and more() are just < and >.  Returns false for any
+ * other array, which then takes the generic path.
+ */
+template <class Better>
+static bool packedNumericExtreme(const Array& v, Variant& ret, Better better) {
+  if (!v->isPacked()) return false;
+  auto const a = static_cast<const HphpArray*>(v.get());
+  auto const n = a->size();
+  auto const first = a->packedElm(0);
+  if (first->m_type == KindOfInt64) {
+    int64_t best = first->m_data.num;
+    for (uint32_t k = 1; k < n; ++k) {
+      auto const tv = a->packedElm(k);
+      if (tv->m_type != KindOfInt64) return false;
+      if (better(tv->m_data.num, best)) best = tv->m_data.num;
+    }
+    ret = best;
+    return true;
+  }
+  if (first->m_type == KindOfDouble) {
+    double best = first->m_data.dbl;
+    for (uint32_t k = 1; k < n; ++k) {
+      auto const tv = a->packedElm(k);
+      if (tv->m_type != KindOfDouble) return false;
+      if (better(tv->m_data.dbl, best)) best = tv->m_data.dbl;
+    }
+    ret = best;
+    return true;
+  }
+  return false;
+}
+
+struct Less {
+  template <class T> bool operator()(T a, T b) const { return a < b; }
+};
+struct More {
+  template <class T> bool operator()(T a, T b) const { return a > b; }
+};
+
 Variant f_min(int _argc, CVarRef value, CArrRef _argv /* = null_array */) {
   Variant ret;
   if (_argv.empty() && value.is(KindOfArray)) {
     Array v = value.toArray();
-    if (!v.empty()) {
+    if (!v.empty() && !packedNumericExtreme(v, ret, Less())) {
       ssize_t pos = v->iter_begin();
       if (pos != ArrayData::invalid_index) {
         ret = v->getValue(pos);
@@ -66,7 +109,7 @@ Variant f_max(int _argc, CVarRef value, CArrRef _argv /* = null_array */) {
   Variant ret;
   if (_argv.empty() && value.is(KindOfArray)) {
     Array v = value.toArray();
-    if (!v.empty()) {
+    if (!v.empty() && !packedNumericExtreme(v, ret, More())) {
       ssize_t pos = v->iter_begin();
       if (pos != ArrayData::invalid_index) {
         ret = v->getValue(pos);
@@ -24,6 +24,7 @@
 #include "hphp/runtime/base/bstring.h"
 #include "hphp/runtime/base/request-local.h"
 #include "hphp/util/lock.h"
+#include "hphp/util/string-scan.h"
 #include <locale.h>
 #include "hphp/runtime/server/http-request-handler.h"
 #include "hphp/runtime/server/http-protocol.h"
@@ -182,24 +183,27 @@ String f_stripcslashes(CStrRef str) {
 }
 
 String f_addslashes(CStrRef str) {
-  if (str.empty()) {
+  static const char kSpecial[] = { '\0', '\\', '"', '\'' };
+  StringSlice sl  = str.slice();
+  const char* src = sl.begin();
+  const char* end = sl.end();
+
+  size_t run = string_scan_any(src, sl.size(), kSpecial, sizeof kSpecial);
+  if (src + run == end) {
     return str;
   }
 
-  return stringForEachBuffered(str.size(), str,
-    [&] (StringBuffer& ret, const char* src, const char* end) {
-      switch (*src) {
-        case '\0':
-          ret.append('\\');
-          ret.append('0');
-          break;
-        case '\\': case '\"': case '\'':
-          ret.append('\\');
-          /* fall through */
-        default:
-          ret.append(*src);
-      }
-    });
+  StringBuffer ret(sl.size() + 16);
+  for (;;) {
+    ret.append(src, run);
+    src += run;
+    if (src == end) break;
+    ret.append('\\');
+    ret.append(*src ? *src : '0');
+    ++src;
+    run = string_scan_any(src, end - src, kSpecial, sizeof kSpecial);
+  }
+  return ret.detach();
 }
 
 String f_stripslashes(CStrRef str) {
@@ -338,12 +342,34 @@ String f_strrev(CStrRef str) {
   return ret;
 }
 
+static String stringToCase(CStrRef str, CaseConv conv) {
+  StringSlice sl = str.slice();
+  size_t first = string_scan_case(sl.begin(), sl.size(), conv);
+  if (first == sl.size()) {
+    return str;
+  }
+
+  if (str->getCount() == 1) {
+    char* sdata = str->mutableData();
+    string_convert_case(sdata + first, sdata + first, sl.size() - first, conv);
+    return str;
+  }
+
+  String ret(sl.size(), ReserveString);
+  char* dst = ret.bufferSlice().begin();
+  memcpy(dst, sl.begin(), first);
+  string_convert_case(dst + first, sl.begin() + first, sl.size() - first,
+                      conv);
+  ret->setSize(sl.size());
+  return ret;
+}
+
 String f_strtolower(CStrRef str) {
-  return stringForEachFast(str, tolower);
+  return stringToCase(str, CaseConv::Lower);
 }
 
 String f_strtoupper(CStrRef str) {
-  return stringForEachFast(str, toupper);
+  return stringToCase(str, CaseConv::Upper);
 }
 
 template <class OpTo, class OpIs> ALWAYS_INLINE
@@ -403,6 +429,10 @@ String stringTrim(CStrRef str, CStrRef charlist) {
     for (; end >= start && flags[(unsigned char)str[end]]; --end) {}
   }
 
+  if (start == 0 && end == len - 1) {
+    return str;
+  }
+
   if (str->getCount() == 1) {
     int slen = end - start + 1;
     if (start) {
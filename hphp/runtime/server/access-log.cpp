@@ -14,6 +14,9 @@
    +----------------------------------------------------------------------+
 */
 #include "hphp/runtime/server/access-log.h"
+
+#include <algorithm>
+
 #include "hphp/runtime/base/datetime.h"
 #include "hphp/runtime/base/timestamp.h"
 #include <time.h>
@@ -27,14 +30,14 @@
 #include "hphp/util/timer.h"
 #include "hphp/util/util.h"
 #include "hphp/runtime/base/hardware-counter.h"
-
-using std::endl;
+#include "folly/Conv.h"
 
 namespace HPHP {
 
 ///////////////////////////////////////////////////////////////////////////////
 
 AccessLog::~AccessLog() {
+  stopWriter();
   signal(SIGCHLD, SIG_DFL);
   for (uint i = 0; i < m_output.size(); ++i) {
     if (m_output[i].log) {
@@ -74,7 +77,11 @@ void AccessLog::init(const string &format,
 
 void AccessLog::openFiles(const string &username) {
   assert(m_output.empty() && m_cronOutput.empty());
+  m_defaultProgram = compileFormat(m_defaultFormat);
   if (m_files.empty()) return;
+  for (auto const& file : m_files) {
+    m_programs.push_back(compileFormat(file.format));
+  }
   for (vector<AccessLogFileData>::const_iterator it = m_files.begin();
        it != m_files.end(); ++it) {
     const string &file = it->file;
@@ -105,6 +112,24 @@ void AccessLog::openFiles(const string &username) {
       m_output.emplace_back(fp);
     }
   }
+
+  // The writer only starts once the outputs it writes to are all there.
+  if (RuntimeOption::AccessLogBufferSize > 0) {
+    m_pending.resize(m_files.size());
+    m_writer.reset(new AsyncFunc<AccessLog>(this, &AccessLog::writerThread));
+    m_writer->start();
+  }
+}
+
+void AccessLog::stopWriter() {
+  if (!m_writer) return;
+  {
+    Lock l(&m_writerSync);
+    m_stopping = true;
+    m_writerSync.notify();
+  }
+  m_writer->waitForEnd();
+  m_writer.reset();
 }
 
 void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
@@ -113,17 +138,38 @@ void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
 
   AccessLog::ThreadData *threadData = m_fGetThreadData();
   FILE *threadLog = threadData->log;
+  string line;
   if (threadLog) {
-    int bytes = writeLog(transport, vhost, threadLog, m_defaultFormat.c_str());
+    renderLine(line, m_defaultProgram, transport, vhost);
+    int bytes = writeLog(threadLog, line);
     threadData->flusher.recordWriteAndMaybeDropCaches(threadLog, bytes);
   }
+  if (m_writer) {
+    std::vector<string> lines(m_files.size());
+    for (uint i = 0; i < m_files.size(); ++i) {
+      renderLine(lines[i], m_programs[i], transport, vhost);
+    }
+    Lock l(&m_writerSync);
+    for (uint i = 0; i < m_files.size(); ++i) {
+      if (m_pendingBytes + lines[i].size() >
+          size_t(RuntimeOption::AccessLogBufferSize)) {
+        ++m_dropped;
+        continue;
+      }
+      m_pending[i] += lines[i];
+      m_pendingBytes += lines[i].size();
+    }
+    m_writerSync.notify();
+    return;
+  }
   if (Logger::UseCronolog) {
     for (uint i = 0; i < m_cronOutput.size(); ++i) {
       Cronolog &cronOutput = *m_cronOutput[i];
       FILE *outFile = cronOutput.getOutputFile();
       if (!outFile) continue;
-      const char *format = m_files[i].format.c_str();
-      int bytes = writeLog(transport, vhost, outFile, format);
+      line.clear();
+      renderLine(line, m_programs[i], transport, vhost);
+      int bytes = writeLog(outFile, line);
       cronOutput.flusher.recordWriteAndMaybeDropCaches(outFile, bytes);
     }
   } else {
@@ -131,8 +177,9 @@ void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
       LogFileData& output = m_output[i];
       FILE *outFile = output.log;
       if (!outFile) continue;
-      const char *format = m_files[i].format.c_str();
-      int bytes = writeLog(transport, vhost, outFile, format);
+      line.clear();
+      renderLine(line, m_programs[i], transport, vhost);
+      int bytes = writeLog(outFile, line);
       if (m_files[i].file[0] != '|') {
         output.flusher.recordWriteAndMaybeDropCaches(outFile, bytes);
       }
@@ -140,126 +187,167 @@ void AccessLog::log(Transport *transport, const VirtualHost *vhost) {
   }
 }
 
-int AccessLog::writeLog(Transport *transport, const VirtualHost *vhost,
-                        FILE *outFile, const char *format) {
-   char c;
-   std::ostringstream out;
-   while ((c = *format++)) {
-     if (c != '%') {
-       out << c;
-       continue;
-     }
-
-     if (parseConditions(format, transport->getResponseCode())) {
-       string arg = parseArgument(format);
-       if (!genField(out, format, transport, vhost, arg)) {
-         out << "-";
-       }
-     } else {
-       skipField(format);
-       out << "-";
-     }
-   }
-   out << endl;
-   string output = out.str();
-   int nbytes = fprintf(outFile, "%s", output.c_str());
-   fflush(outFile);
-   return nbytes;
+int AccessLog::writeLog(FILE *outFile, const string &line) {
+  int nbytes = fwrite(line.data(), 1, line.size(), outFile);
+  fflush(outFile);
+  return nbytes;
 }
 
-bool AccessLog::parseConditions(const char* &format, int code) {
-  bool wantMatch = true;
-  if (*format == '!') {
-    wantMatch = false;
-    format++;
-  } else if (!isdigit(*format)) {
-    // No conditions
-    return true;
+/*
+ * Writes out everything queued for m_files[i] since the last time.
+ */
+void AccessLog::writeOut(uint i, const string &data) {
+  if (Logger::UseCronolog) {
+    Cronolog &cronOutput = *m_cronOutput[i];
+    FILE *outFile = cronOutput.getOutputFile();
+    if (!outFile) return;
+    int bytes = writeLog(outFile, data);
+    cronOutput.flusher.recordWriteAndMaybeDropCaches(outFile, bytes);
+  } else {
+    LogFileData& output = m_output[i];
+    FILE *outFile = output.log;
+    if (!outFile) return;
+    int bytes = writeLog(outFile, data);
+    if (m_files[i].file[0] != '|') {
+      output.flusher.recordWriteAndMaybeDropCaches(outFile, bytes);
+    }
   }
-  char buf[4];
-  buf[3] = '\0';
+}
 
-  bool matched = false;
-  while(isdigit(*format)) {
-    buf[0] = format[0];
-    buf[1] = format[1];
-    buf[2] = format[2];
-    int c = atoi(buf);
-    if (c == code) {
-      matched = true;
-      break;
+void AccessLog::writerThread() {
+  std::vector<string> batch(m_pending.size());
+  for (;;) {
+    uint64_t dropped;
+    bool stopping;
+    {
+      Lock l(&m_writerSync);
+      while (!m_pendingBytes && !m_stopping) {
+        m_writerSync.wait();
+      }
+      for (uint i = 0; i < batch.size(); ++i) {
+        batch[i].swap(m_pending[i]);
+      }
+      m_pendingBytes = 0;
+      dropped = m_dropped;
+      m_dropped = 0;
+      stopping = m_stopping;
     }
-    format+=4;
-  }
-  while (!(*format == '{' || isalpha(*format))) {
-    format++;
+    if (dropped) {
+      Logger::Warning("Access log writer fell behind, dropped %" PRIu64
+                      " lines", dropped);
+    }
+    for (uint i = 0; i < batch.size(); ++i) {
+      if (batch[i].empty()) continue;
+      writeOut(i, batch[i]);
+      batch[i].clear();
+    }
+    if (stopping) return;
   }
-  return wantMatch == matched;
 }
 
-string AccessLog::parseArgument(const char* &format) {
-  if (*format != '{') return string();
-  format++;
-  const char *start = format;
-  while (*format != '}') { format++; }
-  string res(start, format - start);
-  format++;
-  return res;
+/*
+ * Parses an Apache-style format string once, so logging a request only
+ * has to walk the resulting fields.
+ */
+AccessLog::Format AccessLog::compileFormat(const string &format) {
+  Format fields;
+  Field field;
+  const char *p = format.c_str();
+  while (char c = *p++) {
+    if (c != '%') {
+      field.text += c;
+      continue;
+    }
+    if (*p == '%') {
+      field.text += *p++;
+      continue;
+    }
+    if (*p == '!') {
+      field.negate = true;
+      p++;
+    }
+    while (isdigit(*p)) {
+      char *end;
+      field.codes.push_back(strtol(p, &end, 10));
+      p = end;
+      if (*p == ',') p++;
+    }
+    while (*p && *p != '{' && !isalpha(*p)) p++;
+    if (*p == '{') {
+      const char *start = ++p;
+      while (*p && *p != '}') p++;
+      field.arg.assign(start, p - start);
+      if (*p) p++;
+    }
+    while (*p && !isalpha(*p)) p++;
+    // a directive without a letter only ever logs "-"
+    field.type = *p ? *p++ : '-';
+    fields.push_back(field);
+    field = Field();
+  }
+  if (!field.text.empty()) {
+    fields.push_back(field);
+  }
+  return fields;
 }
 
-void AccessLog::skipField(const char* &format) {
-  // Skip argument
-  if (*format == '{') {
-    while (*format != '}') { format++; }
-    format++;
+void AccessLog::renderLine(string &out, const Format &format,
+                           Transport *transport, const VirtualHost *vhost) {
+  int code = transport->getResponseCode();
+  for (auto const& field : format) {
+    out += field.text;
+    if (!field.type) continue;
+    bool wanted = true;
+    if (!field.codes.empty()) {
+      bool matched = std::find(field.codes.begin(), field.codes.end(),
+                               code) != field.codes.end();
+      wanted = matched != field.negate;
+    }
+    if (!wanted || !genField(out, field.type, field.arg, transport, vhost)) {
+      out += '-';
+    }
   }
-  // Find control letter
-  while (!isalpha(*format)) { format++; }
-  // Skip it
-  format++;
+  out += '\n';
 }
 
-static void escape_data(std::ostringstream &out, const char *s, int len)
+static void escape_data(string &out, const char *s, int len)
 {
   static const char digits[] = "0123456789abcdef";
 
   for (int i = 0; i < len; i++) {
     unsigned char uc = *s++;
     switch (uc) {
-      case '"':  out << "\\\""; break;
-      case '\\': out << "\\\\"; break;
-      case '\b': out << "\\b";  break;
-      case '\f': out << "\\f";  break;
-      case '\n': out << "\\n";  break;
-      case '\r': out << "\\r";  break;
-      case '\t': out << "\\t";  break;
+      case '"':  out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\b': out += "\\b";  break;
+      case '\f': out += "\\f";  break;
+      case '\n': out += "\\n";  break;
+      case '\r': out += "\\r";  break;
+      case '\t': out += "\\t";  break;
       default:
         if (uc >= ' ' && (uc & 127) == uc) {
-          out << (char)uc;
+          out += (char)uc;
         } else {
-          out << "\\x" << digits[(uc >> 4) & 15] << digits[(uc >> 0) & 15];
+          out += "\\x";
+          out += digits[(uc >> 4) & 15];
+          out += digits[(uc >> 0) & 15];
         }
         break;
     }
   }
 }
 
-bool AccessLog::genField(std::ostringstream &out, const char* &format,
-                         Transport *transport, const VirtualHost *vhost,
-                         const string &arg) {
+bool AccessLog::genField(string &out, char type, const string &arg,
+                         Transport *transport, const VirtualHost *vhost) {
   int responseSize = transport->getResponseSize();
   int code = transport->getResponseCode();
 
-  while (!isalpha(*format)) { format++; }
-  char type = *format;
-  format++;
-
   switch (type) {
   case 'b':
     if (responseSize == 0) return false;
     // Fall through
   case 'B':
-    out << responseSize;
+    folly::toAppend(responseSize, &out);
     break;
   case 'C':
     if (arg.empty()) {
@@ -274,7 +362,7 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
     {
       struct timespec now;
       Timer::GetMonotonicTime(now);
-      out << gettime_diff_us(transport->getWallTime(), now);
+      folly::toAppend(gettime_diff_us(transport->getWallTime(), now), &out);
     }
     break;
   case 'd':
@@ -282,14 +370,14 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
 #ifdef CLOCK_THREAD_CPUTIME_ID
       struct timespec now;
       gettime(CLOCK_THREAD_CPUTIME_ID, &now);
-      out << gettime_diff_us(transport->getCpuTime(), now);
+      folly::toAppend(gettime_diff_us(transport->getCpuTime(), now), &out);
 #else
       return false;
 #endif
     }
     break;
   case 'h':
-    out << transport->getRemoteHost();
+    out += transport->getRemoteHost();
     break;
   case 'i':
     if (arg.empty()) return false;
@@ -299,21 +387,21 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
 
       if (vhost && vhost->hasLogFilter() &&
           strcasecmp(arg.c_str(), "Referer") == 0) {
-        out << vhost->filterUrl(header);
+        out += vhost->filterUrl(header);
       } else {
-        out << header;
+        out += header;
       }
     }
     break;
   case 'I':
-    out << transport->getRequestSize();
+    folly::toAppend(transport->getRequestSize(), &out);
     break;
   case 'n':
     if (arg.empty()) return false;
     {
       String note = ServerNote::Get(arg);
       if (note.isNull()) return false;
-      out << note.c_str();
+      out += note.c_str();
     }
     break;
   case 'r':
@@ -326,28 +414,30 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       default: break;
       }
       if (!method) return false;
-      out << method << " ";
+      out += method;
+      out += ' ';
 
       const char *url = transport->getUrl();
       if (vhost && vhost->hasLogFilter()) {
-        out << vhost->filterUrl(url);
+        out += vhost->filterUrl(url);
       } else {
-        out << url;
+        out += url;
       }
 
       string httpVersion = transport->getHTTPVersion();
-      out << " HTTP/" << httpVersion;
+      out += " HTTP/";
+      out += httpVersion;
     }
     break;
   case 's':
-    out << code;
+    folly::toAppend(code, &out);
     break;
   case 'S':
     // %S is not defined in Apache, we grab it here
     {
       const std::string &info (transport->getResponseInfo());
       if (info.empty()) return false;
-      out << info;
+      out += info;
     }
     break;
   case 't':
@@ -360,21 +450,22 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       }
       char buf[256];
       time_t rawtime;
-      struct tm * timeinfo;
+      struct tm timeinfo;
       time(&rawtime);
-      timeinfo = localtime(&rawtime);
-      strftime(buf, 256, format, timeinfo);
-      out << buf;
+      localtime_r(&rawtime, &timeinfo);
+      strftime(buf, 256, format, &timeinfo);
+      out += buf;
     }
     break;
   case 'T':
-    out << TimeStamp::Current() - m_fGetThreadData()->startTime;
+    folly::toAppend(TimeStamp::Current() - m_fGetThreadData()->startTime,
+                    &out);
     break;
   case 'U':
     {
       String b, q;
       RequestURI::splitURL(transport->getUrl(), b, q);
-      out << b.c_str();
+      out += b.c_str();
     }
     break;
   case 'v':
@@ -382,26 +473,26 @@ bool AccessLog::genField(std::ostringstream &out, const char* &format,
       string host = transport->getHeader("Host");
       const string &sname = VirtualHost::GetCurrent()->serverName(host);
       if (sname.empty() || RuntimeOption::ForceServerNameToHeader) {
-        out << host;
+        out += host;
       } else {
-        out << sname;
+        out += sname;
       }
     }
     break;
   case 'Y':
     {
       int64_t now = HardwareCounter::GetInstructionCount();
-      out << now - transport->getInstructions();
+      folly::toAppend(now - transport->getInstructions(), &out);
     }
     break;
   case 'y':
-    out << ServerStats::Get("page.inst.psp");
+    folly::toAppend(ServerStats::Get("page.inst.psp"), &out);
     break;
   case 'Z':
-     out << ServerStats::Get("page.wall.psp");
+     folly::toAppend(ServerStats::Get("page.wall.psp"), &out);
      break;
   case 'z':
-     out << ServerStats::Get("page.cpu.psp");
+     folly::toAppend(ServerStats::Get("page.cpu.psp"), &out);
      break;
   default:
     return false;
@@ -16,7 +16,11 @@
 #ifndef incl_HPHP_ACCESS_LOG_H_
 #define incl_HPHP_ACCESS_LOG_H_
 
+#include <memory>
+
 #include "hphp/runtime/base/base-includes.h"
+#include "hphp/util/async-func.h"
+#include "hphp/util/synchronizable.h"
 #include "hphp/util/thread-local.h"
 #include "hphp/util/logger.h"
 #include "hphp/util/lock.h"
@@ -52,6 +56,17 @@ public:
   std::string format;
 };
 
+/**
+ * Writes a line in an Apache-style format for every request, to each of the
+ * configured files and to the thread's own log if it has one.
+ *
+ * Formats are compiled once, when the log is initialized. With a non-zero
+ * Log.AccessLogBufferSize, request threads only render their lines and
+ * append them to a per-file buffer; a writer thread writes each buffer out
+ * in one go and is the only one to touch the files, so a slow disk or a
+ * Cronolog rotation never holds up a request. Lines that don't fit in the
+ * buffer are dropped and counted rather than making requests wait.
+ */
 class AccessLog {
 public:
   class ThreadData {
@@ -63,7 +78,8 @@ public:
   };
   typedef ThreadData* (*GetThreadDataFunc)();
   explicit AccessLog(GetThreadDataFunc f) :
-      m_initialized(false), m_fGetThreadData(f) {}
+      m_initialized(false), m_fGetThreadData(f), m_pendingBytes(0),
+      m_dropped(0), m_stopping(false) {}
   ~AccessLog();
   void init(const std::string &defaultFormat,
             std::vector<AccessLogFileData> &files,
@@ -77,14 +93,27 @@ public:
   std::string &defaultFormat() { return m_defaultFormat; }
   std::vector<AccessLogFileData> &files() { return m_files; }
 private:
-  bool parseConditions(const char* &format, int code);
-  std::string parseArgument(const char* &format);
-  bool genField(std::ostringstream &out, const char* &format,
-                Transport *transport, const VirtualHost *vhost,
-                const std::string &arg);
-  void skipField(const char* &format);
-  int writeLog(Transport *transport, const VirtualHost *vhost,
-               FILE *outFile, const char *format);
+  // One % directive of a compiled format, and the text before it.
+  struct Field {
+    Field() : type(0), negate(false) {}
+    std::string text;
+    char type;               // directive letter; 0 for trailing text
+    std::string arg;         // %{arg}x
+    std::vector<int> codes;  // %200,304x: only for these response codes
+    bool negate;             // %!200,304x: for all codes but these
+  };
+  typedef std::vector<Field> Format;
+
+  static Format compileFormat(const std::string &format);
+  void renderLine(std::string &out, const Format &format,
+                  Transport *transport, const VirtualHost *vhost);
+  bool genField(std::string &out, char type, const std::string &arg,
+                Transport *transport, const VirtualHost *vhost);
+  int writeLog(FILE *outFile, const std::string &line);
+
+  void writeOut(uint i, const std::string &data);
+  void writerThread();
+  void stopWriter();
 
   std::vector<LogFileData> m_output;
   std::vector<CronologPtr> m_cronOutput;
@@ -92,6 +121,16 @@ private:
   GetThreadDataFunc m_fGetThreadData;
   std::string m_defaultFormat;
   std::vector<AccessLogFileData> m_files;
+  Format m_defaultProgram;
+  std::vector<Format> m_programs; // one per entry in m_files
+
+  // Guards m_pending, m_pendingBytes, m_dropped and m_stopping.
+  Synchronizable m_writerSync;
+  std::vector<std::string> m_pending; // one per entry in m_files
+  size_t m_pendingBytes;
+  uint64_t m_dropped;
+  bool m_stopping;
+  std::unique_ptr<AsyncFunc<AccessLog>> m_writer;
 
   void openFiles(const std::string &username);
   Mutex m_lock;
@@ -34,6 +34,7 @@
 #include "hphp/runtime/base/shared-store-stats.h"
 #include "hphp/runtime/vm/repo.h"
 #include "hphp/runtime/vm/jit/translator.h"
+#include "hphp/runtime/vm/jit/prof-data-serialize.h"
 #include "hphp/util/alloc.h"
 #include "hphp/util/timer.h"
 #include "hphp/util/repo-schema.h"
@@ -173,6 +174,12 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "    (same as /stats.xml)\n"
         "/stats.html:      show server stats in HTML\n"
         "    (same as /stats.xml)\n"
+        "/stats.latency.xml: show queue, wall and CPU time (us) and peak\n"
+        "                  memory (bytes) percentiles of each page in XML\n"
+        "/stats.latency.json: same in JSON\n"
+        "/stats.latency.kvp: same in key-value pairs\n"
+        "/stats.latency.html: same in HTML\n"
+        "/stats.counters:  show running totals of registered counters\n"
 
         "/apc-ss:          get apc size stats\n"
         "/apc-ss-flat:     get apc size stats in flat format\n"
@@ -181,9 +188,14 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "                  only valid when EnableAPCSizeDetail is true\n"
         "    keysample     optional, only dump keys that belongs to the same\n"
         "                  group as <keysample>\n"
+        "/apc-mem:         get apc memory use against Server.APC.MemoryBudget\n"
+        "                  and evictions, per store\n"
         "/const-ss:        get const_map_size\n"
         "/static-strings:  get number of static strings\n"
         "/dump-apc:        dump all current value in APC to /tmp/apc_dump\n"
+        "/dump-apc-snapshot: write APC to Server.APC.SnapshotFile, for the\n"
+        "                  next server to start warm\n"
+        "    waitseconds   as with dump-apc\n"
         "/dump-const:      dump all constant value in constant map to\n"
         "                  /tmp/const_map_dump\n"
         "/dump-file-repo:  dump file repository to /tmp/file_repo_dump\n"
@@ -201,6 +213,8 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
         "/vm-dump-tc:      dump translation cache to /tmp/tc_dump_a and\n"
         "                  /tmp/tc_dump_astub\n"
         "/vm-tcreset:      throw away translations and start over\n"
+        "/vm-dump-pgo:     write optimized JIT regions to\n"
+        "                  Eval.JitPGOProfilePath\n"
         "/vm-namedentities:show size of the NamedEntityTable\n"
         ;
 #ifdef USE_TCMALLOC
@@ -328,6 +342,21 @@ void AdminRequestHandler::handleRequest(Transport *transport) {
       break;
     }
 
+    if (cmd == "apc-mem") {
+      std::ostringstream out;
+      out << "budget " << apcExtension::MemoryBudget << endl;
+      for (int i = 0; i < MAX_SHARED_STORE; i++) {
+        ConcurrentTableSharedStore& store = s_apc_store[i];
+        out << "store " << i
+            << ": entries " << store.size()
+            << ", used " << store.memoryUsed()
+            << ", evictions " << store.evictionCount()
+            << ", evicted " << store.evictedSize() << endl;
+      }
+      transport->sendString(out.str());
+      break;
+    }
+
     if (cmd == "pcre-cache-size") {
       std::ostringstream size;
       size << preg_pcre_cache_size() << endl;
@@ -539,6 +568,16 @@ static bool send_report(Transport *transport, ServerStats::Format format,
   return true;
 }
 
+static bool send_latency(Transport *transport, ServerStats::Format format,
+                         const char *mime) {
+  string out;
+  ServerStats::ReportLatency(out, format);
+
+  transport->addHeader("Content-Type", mime);
+  transport->sendString(out);
+  return true;
+}
+
 static bool send_status(Transport *transport, ServerStats::Format format,
                         const char *mime) {
   string out;
@@ -580,6 +619,8 @@ bool AdminRequestHandler::handleCheckRequest(const std::string &cmd,
     ServerPtr server = HttpServer::Server->getPageServer();
     appendStat("load", server->getActiveWorker());
     appendStat("queued", server->getQueuedJobs());
+    appendStat("overloaded", server->isOverloaded());
+    appendStat("shed", server->getShedJobs());
     Transl::Translator* tx = Transl::Translator::Get();
     appendStat("hhbc-roarena-capac", hhbc_arena_capacity());
     appendStat("tc-size", tx->getCodeSize());
@@ -714,6 +755,27 @@ bool AdminRequestHandler::handleStatsRequest(const std::string &cmd,
     return send_report(transport, ServerStats::Format::HTML, "text/html");
   }
 
+  if (cmd == "stats.latency.xml") {
+    return send_latency(transport, ServerStats::Format::XML,
+                        "application/xml");
+  }
+  if (cmd == "stats.latency.json") {
+    return send_latency(transport, ServerStats::Format::JSON,
+                        "application/json");
+  }
+  if (cmd == "stats.latency.kvp") {
+    return send_latency(transport, ServerStats::Format::KVP, "text/plain");
+  }
+  if (cmd == "stats.latency.html" || cmd == "stats.latency.htm") {
+    return send_latency(transport, ServerStats::Format::HTML, "text/html");
+  }
+  if (cmd == "stats.counters") {
+    string out;
+    ServerStats::GetCounters(out);
+    transport->sendString(out);
+    return true;
+  }
+
   if (cmd == "stats.xsl") {
     string xsl;
     if (!RuntimeOption::StatsXSLProxy.empty()) {
@@ -899,6 +961,16 @@ bool AdminRequestHandler::handleVMRequest(const std::string &cmd,
     }
     return true;
   }
+  if (cmd == "vm-dump-pgo") {
+    if (RuntimeOption::EvalJitPGOProfilePath.empty()) {
+      transport->sendString("Eval.JitPGOProfilePath is not set");
+    } else if (JIT::dumpPGOProfile(RuntimeOption::EvalJitPGOProfilePath)) {
+      transport->sendString("Done");
+    } else {
+      transport->sendString("Error dumping the PGO profile");
+    }
+    return true;
+  }
   return false;
 }
 
@@ -940,6 +1012,20 @@ bool AdminRequestHandler::handleDumpCacheRequest(const std::string &cmd,
     transport->sendString("Done");
     return true;
   }
+  if (cmd == "dump-apc-snapshot") {
+    if (!apcExtension::Enable || apcExtension::SnapshotFile.empty()) {
+      transport->sendString("Not Enabled\n");
+      return true;
+    }
+    int waitSeconds = transport->getIntParam("waitseconds");
+    if (!waitSeconds) {
+      waitSeconds = RuntimeOption::RequestTimeoutSeconds > 0 ?
+                    RuntimeOption::RequestTimeoutSeconds : 10;
+    }
+    transport->sendString(apc_dump_snapshot(waitSeconds) ? "Done\n"
+                                                         : "Failed\n");
+    return true;
+  }
   if (cmd == "dump-file-repo") {
     if (file_dump) {
       (*file_dump)("/tmp/file_repo_dump");
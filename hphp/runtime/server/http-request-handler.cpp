@@ -18,8 +18,10 @@
 #include "hphp/runtime/base/program-functions.h"
 #include "hphp/runtime/base/execution-context.h"
 #include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/base/memory-manager.h"
 #include "hphp/util/timer.h"
 #include "hphp/runtime/server/static-content-cache.h"
+#include "hphp/runtime/server/static-file-cache.h"
 #include "hphp/runtime/server/dynamic-content-cache.h"
 #include "hphp/runtime/server/server-stats.h"
 #include "hphp/util/network.h"
@@ -49,16 +51,108 @@ HttpRequestHandler::HttpRequestHandler(int timeout)
                                  "requests_timed_out_on_queue",
                                  {ServiceData::StatsType::COUNT})) { }
 
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+bool parseNumber(const char *&p, int64_t &n) {
+  if (!isdigit(*p)) return false;
+  n = 0;
+  for (; isdigit(*p); ++p) {
+    if (n < INT_MAX) n = n * 10 + (*p - '0');
+  }
+  return true;
+}
+
+/*
+ * Parses a Range header asking for one range of a len byte body, either end
+ * of which may be left out (RFC 2616 14.35.1). Returns 1 with the range in
+ * first and last, 0 if the range starts past the end of the body, and -1 if
+ * the header is malformed or asks for several ranges; those get the whole
+ * body, which is always allowed.
+ */
+int parseByteRange(const string &header, int len, int &first, int &last) {
+  if (header.compare(0, 6, "bytes=") != 0 ||
+      header.find(',') != string::npos) {
+    return -1;
+  }
+  const char *p = header.c_str() + 6;
+  while (isspace(*p)) ++p;
+  int64_t from, to;
+  if (*p == '-') {
+    ++p;
+    if (!parseNumber(p, to)) return -1;
+    if (to == 0 || len == 0) return 0;
+    from = to < len ? len - to : 0;
+    to = len - 1;
+  } else {
+    if (!parseNumber(p, from) || *p++ != '-') return -1;
+    if (!parseNumber(p, to)) to = INT_MAX;
+    if (to < from) return -1;
+    if (from >= len) return 0;
+    if (to >= len) to = len - 1;
+  }
+  while (isspace(*p)) ++p;
+  if (*p) return -1;
+  first = from;
+  last = to;
+  return 1;
+}
+
+bool matchesETag(const string &header, const char *etag) {
+  // a comma separated list of entity tags, or "*"
+  size_t pos = 0;
+  while (pos < header.size()) {
+    size_t end = header.find(',', pos);
+    if (end == string::npos) end = header.size();
+    size_t b = header.find_first_not_of(" \t", pos);
+    size_t e = header.find_last_not_of(" \t", end - 1);
+    if (b != string::npos && b < end) {
+      // weak comparison is fine for GET
+      if (header.compare(b, 2, "W/") == 0) b += 2;
+      string tag = header.substr(b, e + 1 - b);
+      if (tag == "*" || tag == etag) return true;
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+}
+
 void HttpRequestHandler::sendStaticContent(Transport *transport,
                                            const char *data, int len,
                                            time_t mtime,
                                            bool compressed,
                                            const std::string &cmd,
-                                           const char *ext) {
+                                           const char *ext,
+                                           const char *etag) {
   assert(ext);
   assert(cmd.rfind('.') != string::npos);
   assert(strcmp(ext, cmd.c_str() + cmd.rfind('.') + 1) == 0);
 
+  // misnomer, it means we have made decision on compression, transport
+  // should not attempt to compress it.
+  transport->disableCompression();
+
+  time_t base = time(nullptr);
+  if (RuntimeOption::ExpiresActive) {
+    time_t exp = base + RuntimeOption::ExpiresDefault;
+    char age[20];
+    snprintf(age, sizeof(age), "max-age=%d", RuntimeOption::ExpiresDefault);
+    transport->addHeader("Cache-Control", age);
+    transport->addHeader("Expires",
+      DateTime(exp, true).toString(DateTime::DateFormat::HttpHeader).c_str());
+  }
+
+  if (etag) {
+    transport->addHeader("ETag", etag);
+    if (matchesETag(transport->getHeader("If-None-Match"), etag)) {
+      transport->sendRaw((void*)"", 0, 304);
+      return;
+    }
+  }
+
   hphp_string_imap<string>::const_iterator iter =
     RuntimeOption::StaticFileExtensions.find(ext);
   if (iter != RuntimeOption::StaticFileExtensions.end()) {
@@ -77,19 +171,11 @@ void HttpRequestHandler::sendStaticContent(Transport *transport,
     transport->addHeader("Content-Type", "application/octet-stream");
   }
 
-  time_t base = time(nullptr);
-  if (RuntimeOption::ExpiresActive) {
-    time_t exp = base + RuntimeOption::ExpiresDefault;
-    char age[20];
-    snprintf(age, sizeof(age), "max-age=%d", RuntimeOption::ExpiresDefault);
-    transport->addHeader("Cache-Control", age);
-    transport->addHeader("Expires",
-      DateTime(exp, true).toString(DateTime::DateFormat::HttpHeader).c_str());
-  }
-
+  string lastModified;
   if (mtime) {
-    transport->addHeader("Last-Modified",
-      DateTime(mtime, true).toString(DateTime::DateFormat::HttpHeader).c_str());
+    lastModified =
+      DateTime(mtime, true).toString(DateTime::DateFormat::HttpHeader).data();
+    transport->addHeader("Last-Modified", lastModified.c_str());
   }
   transport->addHeader("Accept-Ranges", "bytes");
 
@@ -103,9 +189,35 @@ void HttpRequestHandler::sendStaticContent(Transport *transport,
     }
   }
 
-  // misnomer, it means we have made decision on compression, transport
-  // should not attempt to compress it.
-  transport->disableCompression();
+  // Ranges of compressed bodies would be ranges of the gzip stream; those
+  // just get the whole thing.
+  string range = compressed ? "" : transport->getHeader("Range");
+  if (!range.empty()) {
+    // If-Range holds the validator the client's partial copy came with
+    string ifRange = transport->getHeader("If-Range");
+    if (ifRange.empty() || (etag && ifRange == etag) ||
+        (!lastModified.empty() && ifRange == lastModified)) {
+      int first, last;
+      switch (parseByteRange(range, len, first, last)) {
+      case 1: {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "bytes %d-%d/%d", first, last, len);
+        transport->addHeader("Content-Range", buf);
+        transport->sendRaw((void*)(data + first), last - first + 1, 206);
+        return;
+      }
+      case 0: {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "bytes */%d", len);
+        transport->addHeader("Content-Range", buf);
+        transport->sendRaw((void*)"", 0, 416);
+        return;
+      }
+      default:
+        break;
+      }
+    }
+  }
 
   transport->sendRaw((void*)data, len, 200, compressed);
 }
@@ -207,7 +319,8 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
           decompressed_data = const_cast<char*>(data);
           compressed = false;
         }
-        sendStaticContent(transport, data, len, 0, compressed, path, ext);
+        sendStaticContent(transport, data, len, 0, compressed, path, ext,
+                          nullptr);
         StaticContentCache::TheFileCache->adviseOutMemory();
         ServerStats::LogPage(path, 200);
         GetAccessLog().log(transport, vhost);
@@ -218,13 +331,22 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
     if (RuntimeOption::EnableStaticContentFromDisk) {
       String translated = File::TranslatePath(String(absPath));
       if (!translated.empty()) {
-        CstrBuffer sb(translated.data());
-        if (sb.valid()) {
-          struct stat st;
-          st.st_mtime = 0;
-          stat(translated.data(), &st);
-          sendStaticContent(transport, sb.data(), sb.size(), st.st_mtime,
-                            false, path, ext);
+        std::shared_ptr<StaticFile> file =
+          StaticFileCache::Find(translated.data());
+        if (file) {
+          // Ranges are served from the file itself, so the client can
+          // resume with the same representation.
+          bool gzip = false;
+          if (file->gzip) {
+            transport->addHeader("Vary", "Accept-Encoding");
+            if (transport->acceptEncoding("gzip") &&
+                transport->getHeader("Range").empty()) {
+              file = file->gzip;
+              gzip = true;
+            }
+          }
+          sendStaticContent(transport, file->data, file->size, file->mtime,
+                            gzip, path, ext, file->etag.c_str());
           ServerStats::LogPage(path, 200);
           GetAccessLog().log(transport, vhost);
           return;
@@ -238,7 +360,8 @@ void HttpRequestHandler::handleRequest(Transport *transport) {
       assert(transport->getUrl());
       string key = path + transport->getUrl();
       if (DynamicContentCache::TheCache.find(key, data, len, compressed)) {
-        sendStaticContent(transport, data, len, 0, compressed, path, ext);
+        sendStaticContent(transport, data, len, 0, compressed, path, ext,
+                          nullptr);
         ServerStats::LogPage(path, 200);
         GetAccessLog().log(transport, vhost);
         return;
@@ -331,6 +454,14 @@ bool HttpRequestHandler::executePHPRequest(Transport *transport,
     Eval::Debugger::InterruptRequestStarted(transport->getUrl());
   }
 
+  MemoryManager* mm = MemoryManager::TheMemoryManager();
+  if (RuntimeOption::ServerRequestArena &&
+      (RuntimeOption::ServerRequestArenaEndPoints.empty() ||
+       RuntimeOption::ServerRequestArenaEndPoints.count(
+         transport->getCommand()))) {
+    mm->beginArena(RuntimeOption::ServerRequestArenaMaxDeadBytes);
+  }
+
   bool error = false;
   std::string errorMsg = "Internal Server Error";
   ret = hphp_invoke(context, file, false, Array(), uninit_null(),
@@ -392,6 +523,18 @@ bool HttpRequestHandler::executePHPRequest(Transport *transport,
 
   transport->onSendEnd();
   hphp_context_exit(context, true, true, transport->getUrl());
+  static const ServerStats::CounterId slabReused =
+    ServerStats::RegisterCounter("mem.slab.reused");
+  static const ServerStats::CounterId slabAllocated =
+    ServerStats::RegisterCounter("mem.slab.allocated");
+  static const ServerStats::CounterId arenaFrees =
+    ServerStats::RegisterCounter("mem.arena.frees");
+  static const ServerStats::CounterId arenaDead =
+    ServerStats::RegisterCounter("mem.arena.dead");
+  ServerStats::Log(slabReused, mm->getSlabsReused());
+  ServerStats::Log(slabAllocated, mm->getSlabsAllocated());
+  ServerStats::Log(arenaFrees, mm->getArenaFrees());
+  ServerStats::Log(arenaDead, mm->getArenaDeadBytes());
   ServerStats::LogPage(file, code);
   return ret;
 }
@@ -54,7 +54,8 @@ private:
   void sendStaticContent(Transport *transport, const char *data, int len,
                          time_t mtime, bool compressed,
                          const std::string &cmd,
-                         const char *ext);
+                         const char *ext,
+                         const char *etag);
   bool executePHPRequest(Transport *transport, RequestURI &reqURI,
                          SourceRootInfo &sourceRootInfo,
                          bool cachableDynamicContent);
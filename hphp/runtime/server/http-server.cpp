@@ -98,7 +98,7 @@ HttpServer::HttpServer()
   }
 
   m_adminServer = ServerFactoryRegistry::createServer
-    (RuntimeOption::ServerType,
+    (RuntimeOption::AuxServerType(),
      RuntimeOption::ServerIP, RuntimeOption::AdminServerPort,
      RuntimeOption::AdminThreadCount);
   m_adminServer->setRequestHandlerFactory<AdminRequestHandler>(
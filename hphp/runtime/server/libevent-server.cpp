@@ -25,8 +25,11 @@
 #include "hphp/runtime/server/server-stats.h"
 #include "hphp/util/compatibility.h"
 #include "hphp/util/logger.h"
+#include "hphp/util/numa.h"
 #include "hphp/util/timer.h"
 
+#include "folly/String.h"
+
 ///////////////////////////////////////////////////////////////////////////////
 // static handler
 
@@ -83,6 +86,7 @@ LibEventServer::LibEventServer(const std::string &address, int port,
   : Server(address, port, thread),
     m_accept_sock(-1),
     m_accept_sock_ssl(-1),
+    m_dispatcherCPU(-1),
     m_dispatcher(thread, RuntimeOption::ServerThreadRoundRobin,
                  RuntimeOption::ServerThreadDropCacheTimeoutSeconds,
                  RuntimeOption::ServerThreadDropStack,
@@ -90,6 +94,8 @@ LibEventServer::LibEventServer(const std::string &address, int port,
                  RuntimeOption::ServerThreadJobMaxQueuingMilliSeconds,
                  kNumPriorities),
     m_dispatcherThread(this, &LibEventServer::dispatch) {
+  m_dispatcher.setCoDel(RuntimeOption::ServerThreadJobCoDelTargetMilliSeconds,
+                        RuntimeOption::ServerThreadJobCoDelIntervalMilliSeconds);
   m_eventBase = event_base_new();
   m_server = evhttp_new(m_eventBase);
   m_server_ssl = nullptr;
@@ -151,6 +157,12 @@ void LibEventServer::start() {
     Logger::Info("Listen on ssl port %d",m_port_ssl);
   }
 
+  if (RuntimeOption::ServerThreadNumaBind) {
+    m_dispatcher.setNumaPolicy(m_dispatcherCPU >= 0 ?
+                               cpu_numa_node(m_dispatcherCPU) :
+                               LibEventDispatcher::kNumaSpread);
+  }
+
   setStatus(RunStatus::RUNNING);
   m_dispatcher.start();
   m_dispatcherThread.start();
@@ -176,6 +188,19 @@ void LibEventServer::dispatchWithTimeout(int timeoutSeconds) {
 }
 
 void LibEventServer::dispatch() {
+#ifndef __APPLE__
+  if (m_dispatcherCPU >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(m_dispatcherCPU, &cpus);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (err != 0) {
+      Logger::Warning("Unable to pin the event loop for port %d to CPU %d: %s",
+                      m_port, m_dispatcherCPU, folly::errnoStr(err).c_str());
+    }
+  }
+#endif
+
   m_pipeStop.open();
   event_set(&m_eventStop, m_pipeStop.getOut(), EV_READ|EV_PERSIST,
             on_thread_stop, m_eventBase);
@@ -117,8 +117,19 @@ public:
   virtual int getQueuedJobs() {
     return m_dispatcher.getQueuedJobs();
   }
+  virtual bool isOverloaded() {
+    return m_dispatcher.isOverloaded();
+  }
+  virtual int64_t getShedJobs() {
+    return m_dispatcher.getShedJobs();
+  }
   int getLibEventConnectionCount();
 
+  /**
+   * Run the event loop on the given CPU only. Must be called before start().
+   */
+  void setDispatcherCPU(int cpu) { m_dispatcherCPU = cpu; }
+
   /**
    * Request handler called by evhttp library.
    */
@@ -158,6 +169,8 @@ protected:
   event m_eventStop;
   CPipe m_pipeStop;
 
+  int m_dispatcherCPU;
+
 private:
   enum RequestPriority {
     PRIORITY_NORMAL = 0,
@@ -170,7 +183,9 @@ private:
                           const std::string& key_file,
                           const std::string& cert_file);
 
-  JobQueueDispatcher<LibEventJobPtr, LibEventWorker> m_dispatcher;
+  typedef JobQueueDispatcher<LibEventJobPtr, LibEventWorker>
+    LibEventDispatcher;
+  LibEventDispatcher m_dispatcher;
   AsyncFunc<LibEventServer> m_dispatcherThread;
 
   PendingResponseQueue m_responseQueue;
@@ -0,0 +1,267 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/runtime/server/reuse-port-server.h"
+
+#include <algorithm>
+#include <cstring>
+#include <netdb.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/util/logger.h"
+#include "hphp/util/process.h"
+#include "folly/Conv.h"
+#include "folly/String.h"
+
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT 15
+#endif
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+ReusePortServer::ReusePortServer(const std::string &address, int port,
+                                 int thread)
+  : Server(address, port, thread), m_portSSL(0) {
+  // Loops are pinned round-robin to the CPUs this process may run on,
+  // which under a cpuset are usually fewer than the ones online.
+  std::vector<int> cpus;
+#ifndef __APPLE__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+    }
+  } else {
+    Logger::Warning("reuseport: unable to read CPU affinity, "
+                    "event loops won't be pinned: %s",
+                    folly::errnoStr(errno).c_str());
+  }
+#endif
+  int loops = RuntimeOption::ServerEventLoops > 0 ?
+    RuntimeOption::ServerEventLoops :
+    (cpus.empty() ? Process::GetCPUCount() : (int)cpus.size());
+  loops = std::max(1, std::min(loops, thread));
+  for (int i = 0; i < loops; i++) {
+    int workers = thread / loops + (i < thread % loops ? 1 : 0);
+    auto loop = std::make_shared<LibEventServerWithFd>(address, port, workers);
+    if (!cpus.empty()) {
+      loop->setDispatcherCPU(cpus[i % cpus.size()]);
+    }
+    m_loops.push_back(loop);
+  }
+}
+
+ReusePortServer::~ReusePortServer() {
+  closeSockets();
+}
+
+int ReusePortServer::listenReusePort(const std::string &address, int port) {
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  std::string service = folly::to<std::string>(port);
+  if (getaddrinfo(address.empty() ? nullptr : address.c_str(),
+                  service.c_str(), &hints, &res) != 0) {
+    Logger::Error("reuseport: unable to resolve %s", address.c_str());
+    return -1;
+  }
+
+  int fd = -1;
+  for (auto ai = res; ai; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) continue;
+    int yes = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == 0 &&
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == 0 &&
+        bind(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+      break;
+    }
+    Logger::Error("reuseport: unable to bind port %d: %s", port,
+                  folly::errnoStr(errno).c_str());
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+void ReusePortServer::closeSockets() {
+  // The loops' evhttps close the sockets they accepted on; these are only
+  // the ones left over from a start() that failed part way.
+  for (auto fd : m_socks) close(fd);
+  for (auto fd : m_socksSSL) close(fd);
+  m_socks.clear();
+  m_socksSSL.clear();
+}
+
+void ReusePortServer::start() {
+  if (getStatus() == RunStatus::RUNNING) return;
+
+  // Bind every socket before any loop listens, so a port conflict fails
+  // the whole server instead of leaving some loops running.
+  for (size_t i = 0; i < m_loops.size(); i++) {
+    int fd = listenReusePort(m_address, m_port);
+    if (fd < 0) {
+      closeSockets();
+      throw FailedToListenException(m_address, m_port);
+    }
+    m_socks.push_back(fd);
+    if (m_portSSL) {
+      fd = listenReusePort(m_address, m_portSSL);
+      if (fd < 0) {
+        closeSockets();
+        throw FailedToListenException(m_address, m_portSSL);
+      }
+      m_socksSSL.push_back(fd);
+    }
+  }
+
+  for (size_t i = 0; i < m_loops.size(); i++) {
+    auto& loop = m_loops[i];
+    loop->setRequestHandlerFactory(m_handlerFactory);
+    loop->setUrlChecker(m_urlChecker);
+    loop->setServerSocketFd(m_socks[i]);
+    if (m_portSSL) loop->setSSLSocketFd(m_socksSSL[i]);
+  }
+  m_socks.clear();
+  m_socksSSL.clear();
+
+  for (auto& loop : m_loops) {
+    loop->start();
+  }
+  Logger::Info("reuseport: %d event loops on port %d",
+               (int)m_loops.size(), m_port);
+  setStatus(RunStatus::RUNNING);
+}
+
+void ReusePortServer::waitForEnd() {
+  for (auto& loop : m_loops) {
+    loop->waitForEnd();
+  }
+}
+
+void ReusePortServer::stop() {
+  Lock lock(m_mutex);
+  if (getStatus() != RunStatus::RUNNING) return;
+  setStatus(RunStatus::STOPPING);
+
+  // Each loop drains its own listen queue for up to ShutdownListenWait
+  // seconds, so stop them side by side rather than one after another.
+  std::vector<std::thread> stoppers;
+  for (auto& loop : m_loops) {
+    stoppers.emplace_back([loop] { loop->stop(); });
+  }
+  for (auto& t : stoppers) {
+    t.join();
+  }
+  setStatus(RunStatus::STOPPED);
+}
+
+void ReusePortServer::addWorkers(int numWorkers) {
+  int loops = m_loops.size();
+  for (int i = 0; i < loops; i++) {
+    int n = numWorkers / loops + (i < numWorkers % loops ? 1 : 0);
+    if (n) m_loops[i]->addWorkers(n);
+  }
+}
+
+int ReusePortServer::getActiveWorker() {
+  int total = 0;
+  for (auto& loop : m_loops) total += loop->getActiveWorker();
+  return total;
+}
+
+int ReusePortServer::getQueuedJobs() {
+  int total = 0;
+  for (auto& loop : m_loops) total += loop->getQueuedJobs();
+  return total;
+}
+
+int ReusePortServer::getLibEventConnectionCount() {
+  int total = 0;
+  for (auto& loop : m_loops) total += loop->getLibEventConnectionCount();
+  return total;
+}
+
+bool ReusePortServer::isOverloaded() {
+  for (auto& loop : m_loops) {
+    if (loop->isOverloaded()) return true;
+  }
+  return false;
+}
+
+int64_t ReusePortServer::getShedJobs() {
+  int64_t total = 0;
+  for (auto& loop : m_loops) total += loop->getShedJobs();
+  return total;
+}
+
+bool ReusePortServer::enableSSL(int port) {
+  for (auto& loop : m_loops) {
+    if (!loop->enableSSL(port)) return false;
+  }
+  m_portSSL = port;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+class ReusePortServerFactory : public ServerFactory {
+public:
+  ReusePortServerFactory() {}
+
+  virtual ServerPtr createServer(const ServerOptions& options);
+};
+
+ServerPtr ReusePortServerFactory::createServer(const ServerOptions& options) {
+  if (options.m_serverFD != -1 || options.m_sslFD != -1 ||
+      !options.m_takeoverFilename.empty()) {
+    // Inherited and taken-over sockets are a single listener; there's
+    // nothing to spread across loops.
+    Logger::Warning("reuseport: falling back to libevent server for "
+                    "inherited or taken over sockets");
+    return ServerFactoryRegistry::getInstance()->getFactory("libevent")->
+      createServer(options);
+  }
+  return std::make_shared<ReusePortServer>(options.m_address, options.m_port,
+                                           options.m_numThreads);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+extern "C" {
+
+/*
+ * Automatically register ReusePortServerFactory on program start
+ */
+void register_reuse_port_server() __attribute__((constructor));
+void register_reuse_port_server() {
+  auto registry = HPHP::ServerFactoryRegistry::getInstance();
+  auto factory = std::make_shared<HPHP::ReusePortServerFactory>();
+  registry->registerFactory("reuseport", factory);
+}
+
+}
@@ -0,0 +1,76 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_HTTP_SERVER_REUSE_PORT_SERVER_H_
+#define incl_HPHP_HTTP_SERVER_REUSE_PORT_SERVER_H_
+
+#include "hphp/runtime/server/libevent-server-with-fd.h"
+
+#include <vector>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A server made of several independent LibEventServers ("loops"), one per
+ * core by default. Each loop listens on its own SO_REUSEPORT socket bound
+ * to the same address, so the kernel spreads new connections across them,
+ * and each has its own event_base, response queue and JobQueue of workers.
+ * Nothing is shared between loops on the request path, so there is no
+ * single dispatch thread to saturate.
+ *
+ * Loops are plain LibEventServers handing out LibEventTransports, so
+ * request handlers, access logging and stats see no difference.
+ *
+ * Selected for the page server with Server.Type = reuseport; other servers
+ * get a LibEventServer (RuntimeOption::AuxServerType()). Server.EventLoops
+ * sets the number of loops (0 means one per CPU the process may run on,
+ * never more than there are threads); each loop is pinned to one of those
+ * CPUs.
+ */
+class ReusePortServer : public Server {
+public:
+  ReusePortServer(const std::string &address, int port, int thread);
+  ~ReusePortServer();
+
+  // implementing Server
+  virtual void start();
+  virtual void waitForEnd();
+  virtual void stop();
+  virtual void addWorkers(int numWorkers);
+  virtual int getActiveWorker();
+  virtual int getQueuedJobs();
+  virtual int getLibEventConnectionCount();
+  virtual bool isOverloaded();
+  virtual int64_t getShedJobs();
+  virtual bool enableSSL(int port);
+
+  int getLoopCount() const { return m_loops.size(); }
+
+private:
+  static int listenReusePort(const std::string &address, int port);
+  void closeSockets();
+
+  std::vector<std::shared_ptr<LibEventServerWithFd>> m_loops;
+  std::vector<int> m_socks;
+  std::vector<int> m_socksSSL;
+  int m_portSSL;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_HTTP_SERVER_REUSE_PORT_SERVER_H_
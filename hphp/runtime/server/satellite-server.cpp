@@ -89,8 +89,8 @@ public:
   explicit InternalPageServer(SatelliteServerInfoPtr info)
     : m_allowedURLs(info->getURLs()) {
     m_server = ServerFactoryRegistry::createServer
-      (RuntimeOption::ServerType, RuntimeOption::ServerIP, info->getPort(),
-       info->getThreadCount());
+      (RuntimeOption::AuxServerType(), RuntimeOption::ServerIP,
+       info->getPort(), info->getThreadCount());
     m_server->setRequestHandlerFactory<HttpRequestHandler>(
       info->getTimeoutSeconds().count());
     m_server->setUrlChecker(std::bind(&InternalPageServer::checkURL, this,
@@ -135,8 +135,8 @@ class DanglingPageServer : public SatelliteServer {
 public:
   explicit DanglingPageServer(SatelliteServerInfoPtr info) {
     m_server = ServerFactoryRegistry::createServer
-      (RuntimeOption::ServerType, RuntimeOption::ServerIP, info->getPort(),
-       info->getThreadCount());
+      (RuntimeOption::AuxServerType(), RuntimeOption::ServerIP,
+       info->getPort(), info->getThreadCount());
     m_server->setRequestHandlerFactory<HttpRequestHandler>(
       info->getTimeoutSeconds().count());
   }
@@ -165,8 +165,8 @@ class RPCServer : public SatelliteServer {
 public:
   explicit RPCServer(SatelliteServerInfoPtr info) {
     m_server = ServerFactoryRegistry::createServer
-      (RuntimeOption::ServerType, RuntimeOption::ServerIP, info->getPort(),
-       info->getThreadCount());
+      (RuntimeOption::AuxServerType(), RuntimeOption::ServerIP,
+       info->getPort(), info->getThreadCount());
     m_server->setRequestHandlerFactory([info] {
         auto handler = make_unique<RPCRequestHandler>(
           info->getTimeoutSeconds().count(), true);
@@ -25,6 +25,7 @@
 #include "hphp/runtime/base/array-init.h"
 #include "hphp/util/json.h"
 #include "hphp/util/compatibility.h"
+#include "hphp/util/logger.h"
 #include "hphp/util/process.h"
 #include "hphp/util/timer.h"
 #include "hphp/runtime/base/hardware-counter.h"
@@ -117,6 +118,8 @@ void ServerStats::GetAllKeys(set<string> &allKeys,
   allKeys.insert("load");
   allKeys.insert("idle");
   allKeys.insert("queued");
+  allKeys.insert("overloaded");
+  allKeys.insert("shed");
 }
 
 void ServerStats::Filter(list<TimeSlot*> &slots, const std::string &keys,
@@ -250,6 +253,8 @@ void ServerStats::Aggregate(list<TimeSlot*> &slots, const std::string &agg,
   int load = HttpServer::Server->getPageServer()->getActiveWorker();
   int idle = RuntimeOption::ServerThreadCount - load;
   int queued = HttpServer::Server->getPageServer()->getQueuedJobs();
+  bool overloaded = HttpServer::Server->getPageServer()->isOverloaded();
+  int64_t shed = HttpServer::Server->getPageServer()->getShedJobs();
 
   for (list<TimeSlot*>::const_iterator iter = slots.begin();
        iter != slots.end(); ++iter) {
@@ -274,6 +279,12 @@ void ServerStats::Aggregate(list<TimeSlot*> &slots, const std::string &agg,
       if (wantedKeys.find("queued") != wantedKeys.end()) {
         values["queued"] = queued;
       }
+      if (wantedKeys.find("overloaded") != wantedKeys.end()) {
+        values["overloaded"] = overloaded;
+      }
+      if (wantedKeys.find("shed") != wantedKeys.end()) {
+        values["shed"] = shed;
+      }
 
       for (map<string, int>::const_iterator iter = udfKeys.begin();
            iter != udfKeys.end(); ++iter) {
@@ -604,6 +615,77 @@ Mutex ServerStats::s_lock;
 vector<ServerStats*> ServerStats::s_loggers;
 bool ServerStats::s_profile_network = false;
 IMPLEMENT_THREAD_LOCAL_NO_CHECK(ServerStats, ServerStats::s_logger);
+vector<ServerStats::EndpointTotals> ServerStats::s_retiredEndpoints;
+int64_t ServerStats::s_retiredCounters[ServerStats::kMaxCounters];
+
+namespace {
+
+/*
+ * Names given out ids by RegisterCounter() and endpoint(). Ids are never
+ * taken back, so readers only need to load the count; names below it never
+ * change.
+ */
+struct NameRegistry {
+  explicit NameRegistry(int capacity)
+    : m_names(new string[capacity]), m_capacity(capacity), m_count(0) {}
+
+  // Returns the name's id, or -1 if the registry is full.
+  int lookup(const string &name) {
+    Lock lock(m_lock, false);
+    auto iter = m_ids.find(name);
+    if (iter != m_ids.end()) return iter->second;
+    int id = m_count.load(std::memory_order_relaxed);
+    if (id == m_capacity) return -1;
+    m_names[id] = name;
+    m_ids[name] = id;
+    m_count.store(id + 1, std::memory_order_release);
+    return id;
+  }
+
+  int count() const { return m_count.load(std::memory_order_acquire); }
+  const string &name(int id) const { return m_names[id]; }
+  int capacity() const { return m_capacity; }
+
+private:
+  Mutex m_lock;
+  hphp_string_map<int> m_ids;
+  std::unique_ptr<string[]> m_names;
+  const int m_capacity;
+  std::atomic<int> m_count;
+};
+
+NameRegistry &counter_registry() {
+  static NameRegistry registry(ServerStats::kMaxCounters);
+  return registry;
+}
+
+// id 0 is where pages past Stats.MaxEndpoints go
+NameRegistry &endpoint_registry() {
+  static NameRegistry *registry = [] {
+    auto r = new NameRegistry(std::max(RuntimeOption::StatsMaxEndpoints, 0) +
+                              1);
+    r->lookup("(other)");
+    return r;
+  }();
+  return *registry;
+}
+
+}
+
+ServerStats::CounterId ServerStats::RegisterCounter(const string &name) {
+  int id = counter_registry().lookup(name);
+  if (id < 0) {
+    Logger::Error("Too many server stats counters, not counting %s",
+                  name.c_str());
+  }
+  return id;
+}
+
+void ServerStats::Log(CounterId id, int64_t value) {
+  if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats && id >= 0) {
+    ServerStats::s_logger->log(id, value);
+  }
+}
 
 void ServerStats::LogPage(const string &url, int code) {
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
@@ -658,8 +740,26 @@ void ServerStats::Reset() {
 void ServerStats::Clear() {
   Lock lock(s_lock, false);
   for (unsigned int i = 0; i < s_loggers.size(); i++) {
-    s_loggers[i]->clear();
+    ServerStats *ss = s_loggers[i];
+    ss->clear();
+    // Racing with the owner thread can lose a few of its updates; that's
+    // all the harm it can do.
+    for (int c = 0; c < kMaxCounters; c++) {
+      ss->m_counterTotals[c].store(0, std::memory_order_relaxed);
+    }
+    int n = endpoint_registry().count();
+    for (int e = 0; e < n; e++) {
+      EndpointStats *es = ss->m_endpoints[e].load(std::memory_order_acquire);
+      if (es) {
+        es->m_queue.clear();
+        es->m_wall.clear();
+        es->m_cpu.clear();
+        es->m_memory.clear();
+      }
+    }
   }
+  s_retiredEndpoints.clear();
+  memset(s_retiredCounters, 0, sizeof(s_retiredCounters));
 }
 
 void ServerStats::CollectSlots(list<TimeSlot*> &slots, int64_t from, int64_t to) {
@@ -802,6 +902,144 @@ void ServerStats::Report(string &output, Format format,
   output = out.str();
 }
 
+void ServerStats::EndpointTotals::add(const EndpointStats &s) {
+  m_queue.add(s.m_queue);
+  m_wall.add(s.m_wall);
+  m_cpu.add(s.m_cpu);
+  m_memory.add(s.m_memory);
+}
+
+void ServerStats::EndpointTotals::add(const EndpointTotals &s) {
+  m_queue.add(s.m_queue);
+  m_wall.add(s.m_wall);
+  m_cpu.add(s.m_cpu);
+  m_memory.add(s.m_memory);
+}
+
+void ServerStats::GetCounters(string &out) {
+  int n = counter_registry().count();
+  int64_t totals[kMaxCounters];
+  {
+    Lock lock(s_lock, false);
+    for (int c = 0; c < n; c++) {
+      totals[c] = s_retiredCounters[c];
+    }
+    for (unsigned int i = 0; i < s_loggers.size(); i++) {
+      for (int c = 0; c < n; c++) {
+        totals[c] +=
+          s_loggers[i]->m_counterTotals[c].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  for (int c = 0; c < n; c++) {
+    out += counter_registry().name(c);
+    out += ": ";
+    out += lexical_cast<string>(totals[c]);
+    out += "\n";
+  }
+}
+
+void ServerStats::ReportLatency(string &output, Format format) {
+  NameRegistry &registry = endpoint_registry();
+  int n = registry.count();
+  vector<EndpointTotals> totals(n);
+  {
+    // Only thread creation and exit wait on this; requests never do.
+    Lock lock(s_lock, false);
+    for (unsigned int i = 0; i < s_loggers.size(); i++) {
+      for (int e = 0; e < n; e++) {
+        EndpointStats *es =
+          s_loggers[i]->m_endpoints[e].load(std::memory_order_acquire);
+        if (es) totals[e].add(*es);
+      }
+    }
+    int retired = std::min((int)s_retiredEndpoints.size(), n);
+    for (int e = 0; e < retired; e++) {
+      totals[e].add(s_retiredEndpoints[e]);
+    }
+  }
+
+  static const struct {
+    const char *name;
+    LogHistogram::Snapshot EndpointTotals::*snapshot;
+  } metrics[] = {
+    { "queue",  &EndpointTotals::m_queue },
+    { "wall",   &EndpointTotals::m_wall },
+    { "cpu",    &EndpointTotals::m_cpu },
+    { "memory", &EndpointTotals::m_memory },
+  };
+  static const struct {
+    const char *name;
+    double fraction;
+  } percentiles[] = {
+    { "p50",  0.5 },
+    { "p99",  0.99 },
+    { "p999", 0.999 },
+  };
+
+  std::ostringstream out;
+  if (format == Format::KVP) {
+    out << "{";
+    bool first = true;
+    for (int e = 0; e < n; e++) {
+      if (!totals[e].m_wall.total) continue;
+      string key = registry.name(e) + ".";
+      if (!first) out << ",\n";
+      first = false;
+      out << '"' << JSON::Escape((key + "hit").c_str()) << "\": "
+          << totals[e].m_wall.total;
+      for (auto const &m : metrics) {
+        const LogHistogram::Snapshot &s = totals[e].*m.snapshot;
+        string mkey = key + m.name + ".";
+        out << ", \"" << JSON::Escape((mkey + "avg").c_str()) << "\": "
+            << s.mean();
+        for (auto const &p : percentiles) {
+          out << ", \"" << JSON::Escape((mkey + p.name).c_str()) << "\": "
+              << s.percentile(p.fraction);
+        }
+      }
+    }
+    out << "}\n";
+  } else {
+    Writer *w;
+    if (format == Format::XML) {
+      w = new XMLWriter(out);
+    } else if (format == Format::HTML) {
+      w = new HTMLWriter(out);
+    } else {
+      assert(format == Format::JSON);
+      w = new JSONWriter(out);
+    }
+
+    w->writeFileHeader();
+    w->beginObject("latency");
+    w->beginList("pages");
+    for (int e = 0; e < n; e++) {
+      if (!totals[e].m_wall.total) continue;
+      w->beginObject("page");
+      w->writeEntry("url", registry.name(e));
+      w->writeEntry("hit", (int64_t)totals[e].m_wall.total);
+      for (auto const &m : metrics) {
+        const LogHistogram::Snapshot &s = totals[e].*m.snapshot;
+        w->beginObject(m.name);
+        w->writeEntry("avg", s.mean());
+        for (auto const &p : percentiles) {
+          w->writeEntry(p.name, s.percentile(p.fraction));
+        }
+        w->endObject(m.name);
+      }
+      w->endObject("page");
+    }
+    w->endList("pages");
+    w->endObject("latency");
+    w->writeFileFooter();
+
+    delete w;
+  }
+
+  output = out.str();
+}
+
 static std::string format_duration(timeval &duration) {
   string ret;
   if (duration.tv_sec > 0 || duration.tv_usec > 0) {
@@ -874,6 +1112,11 @@ void ServerStats::ReportStatus(std::string &output, Format format) {
   w->writeEntry("start", DateTime(HttpServer::StartTime).
                 toString(DateTime::DateFormatCookie).data());
   w->writeEntry("up", format_duration(up));
+  if (HttpServer::Server) {
+    ServerPtr server = HttpServer::Server->getPageServer();
+    w->writeEntry("overloaded", server->isOverloaded() ? "yes" : "no");
+    w->writeEntry("shed", server->getShedJobs());
+  }
   w->endObject("process");
 
   w->beginList("threads");
@@ -996,10 +1239,21 @@ ServerStats::ThreadStatus::ThreadStatus()
   memset(m_vhost, 0, sizeof(m_vhost));
 }
 
-ServerStats::ServerStats() : m_last(0), m_min(0), m_max(0) {
+ServerStats::ServerStats()
+    : m_last(0), m_min(0), m_max(0), m_countersUsed(0), m_timing(false) {
   m_slots.resize(RuntimeOption::StatsMaxSlot);
   clear();
 
+  memset(m_counters, 0, sizeof(m_counters));
+  for (int c = 0; c < kMaxCounters; c++) {
+    m_counterTotals[c].store(0, std::memory_order_relaxed);
+  }
+  int endpoints = endpoint_registry().capacity();
+  m_endpoints.reset(new std::atomic<EndpointStats*>[endpoints]);
+  for (int e = 0; e < endpoints; e++) {
+    m_endpoints[e].store(nullptr, std::memory_order_relaxed);
+  }
+
   Lock lock(s_lock, false);
   s_loggers.push_back(this);
 }
@@ -1007,8 +1261,22 @@ ServerStats::ServerStats() : m_last(0), m_min(0), m_max(0) {
 ServerStats::~ServerStats() {
   clear();
 
-  // Remove this from the s_loggers vector
+  // Remove this from the s_loggers vector, keeping what it counted
   Lock lock(s_lock, false);
+  for (int c = 0; c < kMaxCounters; c++) {
+    s_retiredCounters[c] += m_counterTotals[c].load(std::memory_order_relaxed);
+  }
+  int endpoints = endpoint_registry().count();
+  for (int e = 0; e < endpoints; e++) {
+    EndpointStats *es = m_endpoints[e].load(std::memory_order_relaxed);
+    if (es) {
+      if (s_retiredEndpoints.size() <= (size_t)e) {
+        s_retiredEndpoints.resize(e + 1);
+      }
+      s_retiredEndpoints[e].add(*es);
+      delete es;
+    }
+  }
   int pos = -1;
   // Scan the vector looking for this instance of ServerStats. Scanning
   // the vector is not terribly efficient, but this doesn't happen often
@@ -1029,11 +1297,24 @@ void ServerStats::log(const string &name, int64_t value) {
   m_values[name] += value;
 }
 
+void ServerStats::log(CounterId id, int64_t value) {
+  m_counters[id] += value;
+  m_countersUsed |= uint64_t(1) << id;
+  auto &total = m_counterTotals[id];
+  total.store(total.load(std::memory_order_relaxed) + value,
+              std::memory_order_relaxed);
+}
+
 int64_t ServerStats::get(const std::string &name) {
   CounterMap::const_iterator iter = m_values.find(name);
   if (iter != m_values.end()) {
     return iter->second;
   }
+  NameRegistry &counters = counter_registry();
+  for (uint64_t used = m_countersUsed; used; used &= used - 1) {
+    int id = __builtin_ctzll(used);
+    if (counters.name(id) == name) return m_counters[id];
+  }
   return 0;
 }
 
@@ -1063,6 +1344,15 @@ void ServerStats::logPage(const string &url, int code) {
     ps.m_code = code;
     ps.m_hit++;
     Merge(ps.m_values, m_values);
+    for (uint64_t used = m_countersUsed; used; used &= used - 1) {
+      int id = __builtin_ctzll(used);
+      ps.m_values[counter_registry().name(id)] += m_counters[id];
+    }
+  }
+
+  if (m_timing) {
+    m_timing = false;
+    logLatency(url);
   }
 
   m_last = now;
@@ -1079,6 +1369,47 @@ void ServerStats::logPage(const string &url, int code) {
 
 void ServerStats::reset() {
   m_values.clear();
+  for (uint64_t used = m_countersUsed; used; used &= used - 1) {
+    m_counters[__builtin_ctzll(used)] = 0;
+  }
+  m_countersUsed = 0;
+}
+
+ServerStats::EndpointStats *ServerStats::endpoint(const string &url) {
+  int id;
+  auto iter = m_endpointIds.find(url);
+  if (iter != m_endpointIds.end()) {
+    id = iter->second;
+  } else {
+    id = std::max(endpoint_registry().lookup(url), 0);
+    // pages past the limit all map to 0; don't let them grow the cache
+    if (m_endpointIds.size() >= 4096) m_endpointIds.clear();
+    m_endpointIds[url] = id;
+  }
+
+  EndpointStats *es = m_endpoints[id].load(std::memory_order_relaxed);
+  if (!es) {
+    es = new EndpointStats();
+    m_endpoints[id].store(es, std::memory_order_release);
+  }
+  return es;
+}
+
+void ServerStats::logLatency(const string &url) {
+  static const CounterId queuing = RegisterCounter("page.wall.queuing");
+
+  EndpointStats *es = endpoint(url);
+  timespec wallEnd;
+  Timer::GetMonotonicTime(wallEnd);
+  es->m_wall.add(gettime_diff_us(m_wallStart, wallEnd));
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec cpuEnd;
+  gettime(CLOCK_THREAD_CPUTIME_ID, &cpuEnd);
+  es->m_cpu.add(gettime_diff_us(m_cpuStart, cpuEnd));
+#endif
+  es->m_queue.add(queuing >= 0 ? m_counters[queuing] : 0);
+  es->m_memory.add(
+    MemoryManager::TheMemoryManager()->getStats(true).peakUsage);
 }
 
 void ServerStats::clear() {
@@ -1122,6 +1453,12 @@ void ServerStats::startRequest(const char *url, const char *clientIP,
                                const char *vhost) {
   ++m_threadStatus.m_requestCount;
 
+  m_timing = true;
+  Timer::GetMonotonicTime(m_wallStart);
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  gettime(CLOCK_THREAD_CPUTIME_ID, &m_cpuStart);
+#endif
+
   m_threadStatus.m_mm = ThreadInfo::s_threadInfo->m_mm;
   gettimeofday(&m_threadStatus.m_start, 0);
   memset(&m_threadStatus.m_done, 0, sizeof(m_threadStatus.m_done));
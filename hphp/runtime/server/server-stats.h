@@ -18,9 +18,12 @@
 #define incl_HPHP_SERVERSTATS_H_
 
 #include "hphp/util/lock.h"
+#include "hphp/util/log-histogram.h"
 #include "hphp/util/thread-local.h"
 #include <curl/curl.h>
 #include <time.h>
+#include <atomic>
+#include <memory>
 #include "hphp/runtime/base/shared-string.h"
 #include "hphp/runtime/base/types.h"
 
@@ -55,6 +58,28 @@ public:
                      const std::string &url, int code,
                      const std::string &prefix);
 
+  /**
+   * Counters with a fixed slot in every thread, registered once by name, so
+   * logging one is an array add instead of a string hash. Per page they
+   * still show up under their names like Log()'ed values; their running
+   * totals are read by GetCounters() without stopping any thread.
+   * RegisterCounter() returns -1 once kMaxCounters names are taken, and
+   * Log(-1, ...) does nothing.
+   */
+  typedef int CounterId;
+  static const int kMaxCounters = 64;
+  static CounterId RegisterCounter(const std::string &name);
+  static void Log(CounterId id, int64_t value);
+  static void GetCounters(std::string &out);
+
+  /**
+   * Queue, wall and CPU time (us) and peak memory (bytes) histograms of
+   * every page, for the first Stats.MaxEndpoints distinct pages; the rest
+   * share one "(other)" entry. Each thread fills its own, and reports add
+   * them up without taking any lock a request thread takes.
+   */
+  static void ReportLatency(std::string &out, Format format);
+
   // thread status functions
   static void LogBytes(int64_t bytes);
   static void StartRequest(const char *url, const char *clientIP,
@@ -90,6 +115,25 @@ private:
   static std::vector<ServerStats*> s_loggers;
   static DECLARE_THREAD_LOCAL_NO_CHECK(ServerStats, s_logger);
 
+  struct EndpointStats {
+    LogHistogram m_queue;
+    LogHistogram m_wall;
+    LogHistogram m_cpu;
+    LogHistogram m_memory;
+  };
+  struct EndpointTotals {
+    void add(const EndpointStats &s);
+    void add(const EndpointTotals &s);
+
+    LogHistogram::Snapshot m_queue;
+    LogHistogram::Snapshot m_wall;
+    LogHistogram::Snapshot m_cpu;
+    LogHistogram::Snapshot m_memory;
+  };
+  // what exited threads had recorded, guarded by s_lock
+  static std::vector<EndpointTotals> s_retiredEndpoints;
+  static int64_t s_retiredCounters[kMaxCounters];
+
   typedef hphp_shared_string_map<int64_t> CounterMap;
 
   struct PageStats {
@@ -130,12 +174,28 @@ private:
   int64_t m_max;  // latest timepoint
   CounterMap m_values;  // current page's name value pairs
 
+  // current page's registered counters, and which of them were logged
+  int64_t m_counters[kMaxCounters];
+  uint64_t m_countersUsed;
+  // running totals, written only by this thread
+  std::atomic<int64_t> m_counterTotals[kMaxCounters];
+
+  // indexed by endpoint id; entries are filled in once by this thread
+  std::unique_ptr<std::atomic<EndpointStats*>[]> m_endpoints;
+  hphp_string_map<int> m_endpointIds; // cache of the global registry
+  bool m_timing;                      // startRequest() set these
+  timespec m_wallStart;
+  timespec m_cpuStart;
+
   void log(const std::string &name, int64_t value);
+  void log(CounterId id, int64_t value);
   int64_t get(const std::string &name);
   void logPage(const std::string &url, int code);
   void reset();
   void clear();
   void collect(std::list<TimeSlot*> &slots, int64_t from, int64_t to);
+  EndpointStats *endpoint(const std::string &url);
+  void logLatency(const std::string &url);
 
   /**
    * Live status, instead of historical statistics.
@@ -224,6 +224,13 @@ public:
 
   virtual int getLibEventConnectionCount() = 0;
 
+  /**
+   * Whether the job queue is shedding load, and how many jobs it has shed
+   * (Server.ThreadJobCoDelTargetMilliSeconds).
+   */
+  virtual bool isOverloaded() { return false; }
+  virtual int64_t getShedJobs() { return 0; }
+
   /**
    * Create a new RequestHandler.
    */
@@ -0,0 +1,214 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/runtime/server/static-file-cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <climits>
+
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/util/lock.h"
+#include "hphp/util/logger.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+StaticFile::~StaticFile() {
+  if (m_mapped) {
+    munmap(const_cast<char*>(data), size);
+  } else if (size) {
+    free(const_cast<char*>(data));
+  }
+}
+
+std::shared_ptr<StaticFile> StaticFile::Load(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+
+  // Use what fstat() says about the file actually opened, in case it was
+  // replaced after the caller's stat().
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size > INT_MAX) {
+    close(fd);
+    return nullptr;
+  }
+
+  std::shared_ptr<StaticFile> file(new StaticFile());
+  file->mtime = st.st_mtime;
+  file->ino = st.st_ino;
+  file->dev = st.st_dev;
+  char etag[64];
+  snprintf(etag, sizeof(etag), "\"%lx-%lx-%lx\"",
+           (unsigned long)st.st_ino, (unsigned long)st.st_size,
+           (unsigned long)st.st_mtime);
+  file->etag = etag;
+
+  if (st.st_size == 0) {
+    close(fd);
+    file->data = "";
+    return file;
+  }
+
+  if (RuntimeOption::StaticContentMMapFromDisk) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+      Logger::Warning("unable to mmap %s: %s", path.c_str(),
+                      strerror(errno));
+      return nullptr;
+    }
+    file->data = (const char *)p;
+    file->size = st.st_size;
+    file->m_mapped = true;
+    return file;
+  }
+
+  char *buf = (char *)malloc(st.st_size);
+  off_t done = 0;
+  while (done < st.st_size) {
+    ssize_t n = pread(fd, buf + done, st.st_size - done, done);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    done += n;
+  }
+  close(fd);
+  if (done < st.st_size) {
+    // truncated while we were reading it; the next request tries again
+    free(buf);
+    return nullptr;
+  }
+  file->data = buf;
+  file->size = st.st_size;
+  return file;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+Mutex StaticFileCache::s_mutex;
+hphp_hash_map<std::string, StaticFileCache::Entry, string_hash>
+  StaticFileCache::s_files;
+StaticFileCache::LruList StaticFileCache::s_lru;
+int64_t StaticFileCache::s_bytes = 0;
+
+std::shared_ptr<StaticFile> StaticFileCache::Find(const std::string &path) {
+  // Files dropped from the cache are freed after the lock is released.
+  std::vector<std::shared_ptr<StaticFile>> dropped;
+
+  time_t now = time(nullptr);
+  std::shared_ptr<StaticFile> cached;
+  {
+    Lock lock(s_mutex, false);
+    auto iter = s_files.find(path);
+    if (iter != s_files.end()) {
+      cached = iter->second.file;
+      if (now - iter->second.checked <
+          RuntimeOption::StaticContentStatSeconds) {
+        s_lru.splice(s_lru.begin(), s_lru, iter->second.lru);
+        return cached;
+      }
+    }
+  }
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    if (cached) erase(path);
+    return nullptr;
+  }
+  std::string gzPath = path + ".gz";
+  struct stat gzst;
+  bool hasGzip = RuntimeOption::StaticContentGzipSidecar &&
+    stat(gzPath.c_str(), &gzst) == 0 && S_ISREG(gzst.st_mode) &&
+    gzst.st_mtime >= st.st_mtime;
+
+  std::shared_ptr<StaticFile> file;
+  if (cached && cached->sameAs(st) &&
+      (hasGzip ? cached->gzip && cached->gzip->sameAs(gzst)
+               : !cached->gzip)) {
+    file = cached;
+  } else {
+    file = StaticFile::Load(path);
+    if (!file) {
+      if (cached) erase(path);
+      return nullptr;
+    }
+    if (hasGzip) {
+      file->gzip = StaticFile::Load(gzPath);
+      if (file->gzip) {
+        // a different representation of the same resource, as in
+        // Apache's mod_deflate
+        file->gzip->etag = file->etag;
+        file->gzip->etag.insert(file->etag.size() - 1, "-gzip");
+      }
+    }
+  }
+
+  Lock lock(s_mutex, false);
+  insert(path, file, now, dropped);
+  return file;
+}
+
+void StaticFileCache::insert(
+    const std::string &path, const std::shared_ptr<StaticFile> &file,
+    time_t now, std::vector<std::shared_ptr<StaticFile>> &dropped) {
+  auto iter = s_files.find(path);
+  if (iter != s_files.end()) {
+    if (iter->second.file == file) {
+      iter->second.checked = now;
+      s_lru.splice(s_lru.begin(), s_lru, iter->second.lru);
+      return;
+    }
+    s_bytes -= iter->second.file->footprint();
+    dropped.push_back(iter->second.file);
+    s_lru.erase(iter->second.lru);
+    s_files.erase(iter);
+  }
+
+  // too big to keep; it's read again for every request
+  int64_t bytes = file->footprint();
+  if (bytes > RuntimeOption::StaticContentCacheSize) return;
+
+  while (s_bytes + bytes > RuntimeOption::StaticContentCacheSize) {
+    auto victim = s_files.find(s_lru.back());
+    assert(victim != s_files.end());
+    s_bytes -= victim->second.file->footprint();
+    dropped.push_back(victim->second.file);
+    s_files.erase(victim);
+    s_lru.pop_back();
+  }
+
+  s_lru.push_front(path);
+  Entry &entry = s_files[path];
+  entry.file = file;
+  entry.checked = now;
+  entry.lru = s_lru.begin();
+  s_bytes += bytes;
+}
+
+void StaticFileCache::erase(const std::string &path) {
+  std::shared_ptr<StaticFile> file;
+  Lock lock(s_mutex, false);
+  auto iter = s_files.find(path);
+  if (iter == s_files.end()) return;
+  file = iter->second.file;
+  s_bytes -= file->footprint();
+  s_lru.erase(iter->second.lru);
+  s_files.erase(iter);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,111 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_STATIC_FILE_CACHE_H_
+#define incl_HPHP_STATIC_FILE_CACHE_H_
+
+#include <sys/stat.h>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hphp/util/base.h"
+#include "hphp/util/mutex.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * A static file served from disk: its contents, read into memory or mapped
+ * read-only, and the stat data its response headers come from. A StaticFile
+ * never changes once made; when the file on disk does, StaticFileCache loads
+ * it again, and the old contents go away with the last request using them.
+ */
+struct StaticFile {
+  ~StaticFile();
+
+  /**
+   * Reads, or with RuntimeOption::StaticContentMMapFromDisk maps, the file at
+   * path. Returns nullptr if it can't be opened or read.
+   */
+  static std::shared_ptr<StaticFile> Load(const std::string &path);
+
+  bool sameAs(const struct stat &st) const {
+    return ino == st.st_ino && dev == st.st_dev && size == st.st_size &&
+           mtime == st.st_mtime;
+  }
+
+  // bytes held by this file and its sidecar
+  int64_t footprint() const {
+    return size + (gzip ? gzip->size : 0);
+  }
+
+  const char *data;
+  int size;
+  time_t mtime;
+  ino_t ino;
+  dev_t dev;
+  std::string etag; // quoted, ready for the ETag header
+
+  // "name.gz" next to "name", if there is one no older than this file.
+  std::shared_ptr<StaticFile> gzip;
+
+private:
+  StaticFile()
+    : data(nullptr), size(0), mtime(0), ino(0), dev(0), m_mapped(false) {}
+
+  bool m_mapped;
+};
+
+/**
+ * Files for EnableStaticContentFromDisk, by translated path, so a hot asset
+ * is read from disk once. Holds up to RuntimeOption::StaticContentCacheSize
+ * bytes, dropping the least recently used files first. Stat results are
+ * trusted for RuntimeOption::StaticContentStatSeconds.
+ */
+class StaticFileCache {
+public:
+  /**
+   * The current contents of a regular file, or nullptr if there is no such
+   * file or it can't be read.
+   */
+  static std::shared_ptr<StaticFile> Find(const std::string &path);
+
+private:
+  typedef std::list<std::string> LruList;
+
+  struct Entry {
+    std::shared_ptr<StaticFile> file;
+    time_t checked;
+    LruList::iterator lru;
+  };
+
+  static void insert(const std::string &path,
+                     const std::shared_ptr<StaticFile> &file, time_t now,
+                     std::vector<std::shared_ptr<StaticFile>> &dropped);
+  static void erase(const std::string &path);
+
+  static Mutex s_mutex;
+  static hphp_hash_map<std::string, Entry, string_hash> s_files;
+  static LruList s_lru; // most recently used first
+  static int64_t s_bytes;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_STATIC_FILE_CACHE_H_
@@ -583,7 +583,7 @@ bool Transport::setCookie(CStrRef name, CStrRef value, int64_t expire /* = 0 */,
 ///////////////////////////////////////////////////////////////////////////////
 
 void Transport::prepareHeaders(bool compressed, bool chunked,
-    const String &response, const String& orig_response) {
+    const void *data, int size, const void *orig_data, int orig_size) {
   for (HeaderMap::const_iterator iter = m_responseHeaders.begin();
        iter != m_responseHeaders.end(); ++iter) {
     const vector<string> &values = iter->second;
@@ -614,14 +614,14 @@ void Transport::prepareHeaders(bool compressed, bool chunked,
       } else {
         string cur_md5 = it->second[0];
         String expected_md5 = StringUtil::Base64Encode(StringUtil::MD5(
-          orig_response, true));
+          String((const char *)orig_data, orig_size, CopyString), true));
         // Can never trust these PHP people...
         if (expected_md5.c_str() != cur_md5) {
           raise_warning("Content-MD5 mismatch. Expected: %s, Got: %s",
             expected_md5.c_str(), cur_md5.c_str());
         }
         addHeaderImpl("Content-MD5", StringUtil::Base64Encode(StringUtil::MD5(
-          response, true)).c_str());
+          String((const char *)data, size, CopyString), true)).c_str());
       }
     }
   }
@@ -668,7 +668,10 @@ void Transport::prepareHeaders(bool compressed, bool chunked,
 
 String Transport::prepareResponse(const void *data, int size, bool &compressed,
                                   bool last) {
-  String response((const char *)data, size, CopyString);
+  // Only compressed output is returned; a null String means data goes out
+  // as it is, so large bodies are not copied once more on their way to
+  // sendImpl().
+  String response;
 
   // we don't use chunk encoding to send anything pre-compressed
   assert(!compressed || !m_chunkedEncoding);
@@ -753,6 +756,8 @@ void Transport::sendRawLocked(void *data, int size, int code /* = 200 */,
   // compression handling
   ServerStatsHelper ssh("send");
   String response = prepareResponse(data, size, compressed, !chunked);
+  const void *out = response.isNull() ? data : response.data();
+  int outSize = response.isNull() ? size : response.size();
 
   if (m_responseCode < 0) {
     m_responseCode = code;
@@ -761,20 +766,23 @@ void Transport::sendRawLocked(void *data, int size, int code /* = 200 */,
 
   // HTTP header handling
   if (!m_headerSent) {
-    String orig_response((const char *)data, size, CopyString);
-    prepareHeaders(compressed, chunked, response, orig_response);
+    prepareHeaders(compressed, chunked, out, outSize, data, size);
     m_headerSent = true;
   }
 
-  m_responseSize += response.size();
+  m_responseSize += outSize;
   ServerStats::SetThreadMode(ServerStats::ThreadMode::Writing);
-  sendImpl(response.data(), response.size(), m_responseCode, chunked);
+  sendImpl(out, outSize, m_responseCode, chunked);
   ServerStats::SetThreadMode(ServerStats::ThreadMode::Processing);
 
   ServerStats::LogBytes(size);
   if (RuntimeOption::EnableStats && RuntimeOption::EnableWebStats) {
-    ServerStats::Log("network.uncompressed", size);
-    ServerStats::Log("network.compressed", response.size());
+    static const ServerStats::CounterId bytesIn =
+      ServerStats::RegisterCounter("network.uncompressed");
+    static const ServerStats::CounterId bytesOut =
+      ServerStats::RegisterCounter("network.compressed");
+    ServerStats::Log(bytesIn, size);
+    ServerStats::Log(bytesOut, outSize);
   }
 }
 
@@ -790,7 +798,9 @@ void Transport::onSendEnd() {
   if (m_compressor && m_chunkedEncoding) {
     bool compressed = false;
     String response = prepareResponse("", 0, compressed, true);
-    sendImpl(response.data(), response.size(), m_responseCode, true);
+    if (!response.isNull()) {
+      sendImpl(response.data(), response.size(), m_responseCode, true);
+    }
   }
   onSendEndImpl();
 }
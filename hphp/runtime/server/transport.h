@@ -422,8 +422,8 @@ protected:
   bool moveUploadedFileHelper(CStrRef filename, CStrRef destination);
 
 private:
-  void prepareHeaders(bool compressed, bool chunked, const String &response,
-    const String& orig_response);
+  void prepareHeaders(bool compressed, bool chunked,
+    const void *data, int size, const void *orig_data, int orig_size);
 };
 
 ///////////////////////////////////////////////////////////////////////////////
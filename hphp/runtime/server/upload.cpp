@@ -208,53 +208,72 @@ typedef struct {
   int throw_size;
   char *cursor;
   int read_post_bytes;
+
+  /* whether post_data accumulates the whole body, or is just the chunk
+     being parsed, pointing into the transport's buffer once borrowed */
+  bool keep_post_data;
+  bool post_data_borrowed;
 } multipart_buffer;
 
 typedef std::list<std::pair<std::string, std::string> > header_list;
 
-static int read_post(multipart_buffer *self, char *buf, int bytes_to_read) {
-  always_assert(bytes_to_read > 0);
-  always_assert(self->post_data);
-  always_assert(self->cursor >= self->post_data);
+/*
+  makes the next chunk of post data from the transport current.
+  returns its size, or 0 if there is no more.
+
+  unless the whole body is being kept, the chunk isn't copied: cursor
+  points into the transport's buffer, which stays valid until the next
+  call, and the first chunk (our own copy) is freed.
+*/
+static int more_post_data(multipart_buffer *self) {
+  always_assert(self->cursor ==
+                self->post_data + (self->post_size - self->throw_size));
+  if (!self->transport->hasMorePostData()) return 0;
+
+  int extra_byte_read = 0;
+  const void *extra = self->transport->getMorePostData(extra_byte_read);
+  if (extra_byte_read == 0) return 0;
+  if (self->keep_post_data) {
+    self->post_data = (const char *)Util::buffer_append(
+      self->post_data, self->post_size, extra, extra_byte_read);
+    self->cursor = (char*)self->post_data + self->post_size;
+  } else {
+    if (!self->post_data_borrowed) {
+      free((void *)self->post_data);
+      self->post_data_borrowed = true;
+    }
+    self->post_data = (const char *)extra;
+    self->throw_size = self->post_size;
+    self->cursor = (char*)self->post_data;
+  }
+  self->post_size += extra_byte_read;
+  return extra_byte_read;
+}
+
+/* bytes of the current chunk of post data not read yet */
+static int post_bytes_remaining(multipart_buffer *self) {
   int bytes_remaining = (self->post_size - self->throw_size) -
                         (self->cursor - self->post_data);
   always_assert(bytes_remaining >= 0);
-  if (bytes_to_read <= bytes_remaining) {
-    memcpy(buf, self->cursor, bytes_to_read);
-    self->cursor += bytes_to_read;
-    return bytes_to_read;
-  }
+  return bytes_remaining;
+}
 
-  int bytes_read = bytes_remaining;
-  memcpy(buf, self->cursor, bytes_remaining);
-  bytes_to_read -= bytes_remaining;
-  always_assert(self->cursor = (char *)self->post_data +
-                        (self->post_size - self->throw_size));
-  while (bytes_to_read > 0 && self->transport->hasMorePostData()) {
-    int extra_byte_read = 0;
-    const void *extra = self->transport->getMorePostData(extra_byte_read);
-    if (extra_byte_read == 0) break;
-    if (RuntimeOption::AlwaysPopulateRawPostData) {
-      self->post_data = (const char *)Util::buffer_append(
-        self->post_data, self->post_size, extra, extra_byte_read);
-      self->cursor = (char*)self->post_data + self->post_size;
-    } else {
-      self->post_data =
-        (const char *)realloc((void *)self->post_data, extra_byte_read + 1);
-      memcpy((void *)self->post_data, extra, extra_byte_read);
-      ((char*)self->post_data)[extra_byte_read] = 0;
-      self->throw_size = self->post_size;
-      self->cursor = (char*)self->post_data;
-    }
-    self->post_size += extra_byte_read;
-    if (bytes_to_read <= extra_byte_read) {
-      memcpy(buf + bytes_read, self->cursor, bytes_to_read);
-      self->cursor += bytes_to_read;
-      return bytes_read + bytes_to_read;
+static int read_post(multipart_buffer *self, char *buf, int bytes_to_read) {
+  always_assert(bytes_to_read > 0);
+  always_assert(self->post_data);
+  always_assert(self->cursor >= self->post_data);
+  int bytes_read = 0;
+  while (bytes_to_read > 0) {
+    int bytes_remaining = post_bytes_remaining(self);
+    if (bytes_remaining == 0 &&
+        (bytes_remaining = more_post_data(self)) == 0) {
+      break;
     }
-    memcpy(buf + bytes_read, self->cursor, extra_byte_read);
-    bytes_to_read -= extra_byte_read;
-    bytes_read += extra_byte_read;
+    int n = bytes_to_read < bytes_remaining ? bytes_to_read : bytes_remaining;
+    memcpy(buf + bytes_read, self->cursor, n);
+    self->cursor += n;
+    bytes_read += n;
+    bytes_to_read -= n;
   }
   return bytes_read;
 }
@@ -337,6 +356,8 @@ static multipart_buffer *multipart_buffer_new(Transport *transport,
   self->cursor = (char*)self->post_data;
   self->post_size = size;
   self->throw_size = 0;
+  self->keep_post_data = RuntimeOption::AlwaysPopulateRawPostData &&
+                         RuntimeOption::UploadKeepRawPostData;
   return self;
 }
 
@@ -665,6 +686,59 @@ static int multipart_buffer_read(multipart_buffer *self, char *buf,
 }
 
 
+/*
+  like multipart_buffer_read, but instead of copying the data it points
+  *out at it, and returns as much as there is before a possible boundary.
+  once the buffer is drained, data comes straight from the post data, so
+  file parts can be written out without passing through the buffer.
+*/
+static int multipart_buffer_next(multipart_buffer *self, char **out,
+                                 int *end) {
+  if (self->bytes_in_buffer == 0) {
+    int avail = post_bytes_remaining(self);
+    if (avail == 0) avail = more_post_data(self);
+    /* a CR at the end of the chunk may start the next boundary */
+    if (avail > 0 && self->cursor[avail - 1] == '\r') avail--;
+    if (avail > 0 &&
+        !php_ap_memstr(self->cursor, avail,
+                       self->boundary_next, self->boundary_next_len, 1)) {
+      *out = self->cursor;
+      self->cursor += avail;
+      self->read_post_bytes += avail;
+      return avail;
+    }
+  }
+
+  /* near a boundary, or the buffer has data: same as multipart_buffer_read */
+  if (self->bytes_in_buffer < self->bufsize) {
+    fill_buffer(self);
+  }
+
+  int max;
+  char *bound;
+  if ((bound =
+       php_ap_memstr(self->buf_begin, self->bytes_in_buffer,
+                     self->boundary_next, self->boundary_next_len, 1))) {
+    max = bound - self->buf_begin;
+    if (end &&
+        php_ap_memstr(self->buf_begin, self->bytes_in_buffer,
+                      self->boundary_next, self->boundary_next_len, 0)) {
+      *end = 1;
+    }
+  } else {
+    max = self->bytes_in_buffer;
+  }
+
+  int len = max;
+  if (bound && len > 0 && self->buf_begin[len - 1] == '\r') {
+    len--;
+  }
+  *out = self->buf_begin;
+  self->bytes_in_buffer -= len;
+  self->buf_begin += len;
+  return len;
+}
+
 /*
   XXX: this is horrible memory-usage-wise, but we only expect
   to do this on small pieces of form data.
@@ -733,7 +807,7 @@ void rfc1867PostHandler(Transport *transport,
   }
 
   while (!multipart_buffer_eof(mbuff)) {
-    char buff[FILLUNIT];
+    char *buff;
     char *cd=nullptr,*param=nullptr,*filename=nullptr, *tmp=nullptr;
     size_t blen=0, wlen=0;
     off_t offset;
@@ -920,7 +994,7 @@ void rfc1867PostHandler(Transport *transport,
       offset = 0;
       end = 0;
       while (!cancel_upload &&
-             (blen = multipart_buffer_read(mbuff, buff, sizeof(buff), &end)))
+             (blen = multipart_buffer_next(mbuff, &buff, &end)))
       {
         if (php_rfc1867_callback != nullptr) {
           multipart_event_file_data event_file_data;
@@ -940,14 +1014,18 @@ void rfc1867PostHandler(Transport *transport,
         }
 
 
+        // blen can be a whole chunk of post data, so count it before
+        // writing it rather than after
         if (VirtualHost::GetUploadMaxFileSize() > 0 &&
-            total_bytes > VirtualHost::GetUploadMaxFileSize()) {
+            total_bytes + int64_t(blen) >
+            VirtualHost::GetUploadMaxFileSize()) {
           Logger::Verbose("upload_max_filesize of %" PRId64 " bytes exceeded "
                           "- file [%s=%s] not saved",
                           VirtualHost::GetUploadMaxFileSize(),
                           param, filename);
           cancel_upload = UPLOAD_ERROR_A;
-        } else if (max_file_size && (total_bytes > max_file_size)) {
+        } else if (max_file_size &&
+                   total_bytes + int64_t(blen) > max_file_size) {
           Logger::Verbose("MAX_FILE_SIZE of %d bytes exceeded - "
                           "file [%s=%s] not saved",
                           max_file_size, param, filename);
@@ -1176,8 +1254,14 @@ void rfc1867PostHandler(Transport *transport,
     }
   }
 fileupload_done:
-  data = mbuff->post_data;
-  size = mbuff->post_size;
+  if (mbuff->post_data_borrowed) {
+    /* the body wasn't kept; the caller frees what it gets back */
+    data = calloc(1, 1);
+    size = 0;
+  } else {
+    data = mbuff->post_data;
+    size = mbuff->post_size;
+  }
   if (php_rfc1867_callback != nullptr) {
     multipart_event_end event_end;
 
@@ -6997,6 +6997,97 @@ OPCODES
 #undef DECODE_JMP
 #undef DECODE
 
+/*
+ * Superinstructions: short bytecode sequences that dispatchImpl() runs as
+ * one step, saving the dispatches in between and, for CGetL CGetL2 Add,
+ * the stack traffic. Whether a sequence is there is checked each time its
+ * first instruction runs, so jumps into the middle of one need no special
+ * handling. Each fuse*() either runs the whole sequence, leaving pc after
+ * it, or does nothing and returns false, in which case the first
+ * instruction runs on its own.
+ */
+static constexpr bool isFusionHead(Op op) {
+  return op == OpCGetL || op == OpString || op == OpFPushFuncD;
+}
+
+/*
+ * Whether the sequence headed by op ends in a control flow instruction,
+ * for dispatchBB(): FPushFuncD's ends in FCall.
+ */
+static constexpr bool fusionEndsInCtlFlow(Op op) {
+  return op == OpFPushFuncD;
+}
+
+static inline bool isNumericCell(const Cell* c) {
+  return c->m_type == KindOfInt64 || c->m_type == KindOfDouble;
+}
+
+/*
+ * CGetL x; CGetL2 y; Add|Sub|Mul with both locals ints or doubles. The
+ * result is pushed directly instead of the two operands.
+ */
+OPTBLD_INLINE bool VMExecutionContext::fuseCGetL(PC& pc) {
+  PC next = pc + 1;
+  auto const local1 = decodeVariableSizeImm(&next);
+  if (toOp(*next) != OpCGetL2) return false;
+  ++next;
+  auto const local2 = decodeVariableSizeImm(&next);
+  auto const op = toOp(*next);
+  if (op != OpAdd && op != OpSub && op != OpMul) return false;
+
+  auto const c1 = tvToCell(frame_local(m_fp, local1));
+  auto const c2 = tvToCell(frame_local(m_fp, local2));
+  if (!isNumericCell(c1) || !isNumericCell(c2)) return false;
+  // No refcounting, and arithmetic on numbers can't raise.
+  *m_stack.allocC() = op == OpAdd ? cellAdd(*c2, *c1) :
+                      op == OpSub ? cellSub(*c2, *c1) :
+                                    cellMul(*c2, *c1);
+  pc = next + 1;
+  return true;
+}
+
+/*
+ * String s; Concat onto a string, which is appended to in place when the
+ * stack holds the only reference to it.
+ */
+OPTBLD_INLINE bool VMExecutionContext::fuseString(PC& pc) {
+  PC next = pc + 1 + sizeof(Id);
+  if (toOp(*next) != OpConcat) return false;
+  auto const c1 = m_stack.topC();
+  if (!IS_STRING_TYPE(c1->m_type)) return false;
+
+  auto const s = m_fp->m_func->unit()->lookupLitstrId(*(Id*)(pc + 1));
+  m_pc = next;
+  concat_assign(cellAsVariant(*c1), StrNR(s).asString());
+  pc = next + 1;
+  return true;
+}
+
+/*
+ * FPushFuncD 0 <func>; FCall 0.
+ */
+OPTBLD_INLINE bool VMExecutionContext::fuseFPushFuncD(PC& pc) {
+  PC next = pc + 1;
+  if (decodeVariableSizeImm(&next) != 0) return false;
+  next += sizeof(Id);
+  if (toOp(*next) != OpFCall) return false;
+
+  iopFPushFuncD(pc);
+  // FCall can throw, and the unwinder needs to know the ActRec is there.
+  SYNC();
+  iopFCall(pc);
+  return true;
+}
+
+OPTBLD_INLINE bool VMExecutionContext::fuse(Op op, PC& pc) {
+  switch (op) {
+    case OpCGetL:      return fuseCGetL(pc);
+    case OpString:     return fuseString(pc);
+    case OpFPushFuncD: return fuseFPushFuncD(pc);
+    default:           return false;
+  }
+}
+
 static inline void
 profileReturnValue(const DataType dt) {
   const Func* f = liveFunc();
@@ -7027,11 +7118,26 @@ inline void VMExecutionContext::dispatchImpl(int numInstrs) {
 #define O(name, imm, push, pop, flags) \
     &&LabelCover##name,
     OPCODES
+#undef O
+  };
+  static const void *optabFused[] = {
+#define O(name, imm, push, pop, flags) \
+    isFusionHead(Op::name) ? &&LabelFused##name : &&Label##name,
+    OPCODES
 #undef O
   };
   assert(sizeof(optabDirect) / sizeof(const void *) == Op_count);
   assert(sizeof(optabDbg) / sizeof(const void *) == Op_count);
   const void **optab = optabDirect;
+  // Superinstructions run several instructions per dispatch, so they're
+  // off when dispatch has to count or hook instructions, including for
+  // the per-opcode stats.  None of them has control flow before its last
+  // instruction, so dispatchBB() can still stop at the end of the basic
+  // block.
+  if (!limInstrs && !Stats::enabled() &&
+      RuntimeOption::EvalInterpSuperInstrs) {
+    optab = optabFused;
+  }
   bool collectCoverage = ThreadInfo::s_threadInfo->
     m_reqInjectionData.getCoverage();
   if (collectCoverage) {
@@ -7076,6 +7182,15 @@ inline void VMExecutionContext::dispatchImpl(int numInstrs) {
   DISPATCH();
 
 #define O(name, imm, pusph, pop, flags)                       \
+  LabelFused##name:                                           \
+    if (isFusionHead(Op::name) && fuse(Op::name, pc)) {       \
+      SYNC();                                                 \
+      if (breakOnCtlFlow) {                                   \
+        isCtlFlow = fusionEndsInCtlFlow(Op::name);            \
+      }                                                       \
+      DISPATCH();                                             \
+    }                                                         \
+    goto Label##name;                                         \
   LabelDbg##name:                                             \
     phpDebuggerOpcodeHook(pc);                                \
   LabelCover##name:                                           \
@@ -2429,33 +2429,56 @@ void CodeGenerator::cgLdObjMethod(IRInstruction *inst) {
   auto actRecReg = m_regs[actRec].reg();
   CacheHandle handle = Transl::TargetCache::MethodCache::alloc();
 
-  // lookup in the targetcache
-  assert(MethodCache::kNumLines == 1);
-  if (debug) {
-    MethodCache::Pair p;
-    static_assert(sizeof(p.m_value) == 8,
-                  "MethodCache::Pair::m_value assumed to be 8 bytes");
-    static_assert(sizeof(p.m_key) == 8,
-                  "MethodCache::Pair::m_key assumed to be 8 bytes");
-  }
+  static_assert(sizeof(MethodCache::Pair::m_value) == 8,
+                "MethodCache::Pair::m_value assumed to be 8 bytes");
+  static_assert(sizeof(MethodCache::Pair::m_key) == 8,
+                "MethodCache::Pair::m_key assumed to be 8 bytes");
+  auto line = [&] (int i, size_t field) {
+    return rVmTl[handle + i * sizeof(MethodCache::Pair) + field];
+  };
+  auto const keyOff = offsetof(MethodCache::Pair, m_key);
+  auto const valOff = offsetof(MethodCache::Pair, m_value);
 
+  /*
+   * Probe the first line inline.  On a miss, probe the others in astubs,
+   * jumping back to store the Func* on a hit, and call the slow path
+   * helper if none match.
+   */
+  Label chain, hit, done;
+  bool const sameBlock = m_as.base() == m_astubs.base();
   // preload handle->m_value
-  m_as.loadq(rVmTl[handle + offsetof(MethodCache::Pair, m_value)], m_rScratch);
-  m_as.cmpq (rVmTl[handle + offsetof(MethodCache::Pair, m_key)], clsReg);
-  ifThenElse(CC_E, // if handle->key == cls
-             [&] { // then actReg->m_func = handle->value
-               m_as.storeq(m_rScratch, actRecReg[AROFF(m_func)]);
-             },
-             [&] { // else call slow path helper
-               cgCallHelper(m_as,
-                            CppCall(methodCacheSlowPath),
-                            kVoidDest,
-                            SyncOptions::kSyncPoint,
-                            ArgGroup(m_regs).addr(rVmTl, handle)
-                                            .ssa(actRec)
-                                            .ssa(name)
-                                            .ssa(cls));
-             });
+  m_as.   loadq (line(0, valOff), m_rScratch);
+  m_as.   cmpq  (line(0, keyOff), clsReg);
+  m_as.   jcc   (CC_NE, chain);
+  Stats::emitInc(m_as, Stats::TgtCache_MethodInlineHit);
+  asm_label(m_as, hit);
+  m_as.   storeq(m_rScratch, actRecReg[AROFF(m_func)]);
+  if (sameBlock) {
+    m_as. jmp   (done);
+  } else {
+    asm_label(m_as, done);
+  }
+
+  asm_label(m_astubs, chain);
+  for (int i = 1; i < MethodCache::kNumLines; ++i) {
+    m_astubs.loadq(line(i, valOff), m_rScratch);
+    m_astubs.cmpq (line(i, keyOff), clsReg);
+    Stats::emitInc(m_astubs, Stats::TgtCache_MethodChainHit, 1, CC_E);
+    m_astubs.jcc  (CC_E, hit);
+  }
+  cgCallHelper(m_astubs,
+               CppCall(methodCacheSlowPath),
+               kVoidDest,
+               SyncOptions::kSyncPoint,
+               ArgGroup(m_regs).addr(rVmTl, handle)
+                               .ssa(actRec)
+                               .ssa(name)
+                               .ssa(cls));
+  if (sameBlock) {
+    asm_label(m_astubs, done);
+  } else {
+    m_astubs.jmp(done);
+  }
 }
 
 void CodeGenerator::cgLdObjInvoke(IRInstruction* inst) {
@@ -4485,6 +4508,38 @@ void CodeGenerator::cgLdElem(IRInstruction* inst) {
   }
 }
 
+void CodeGenerator::cgCheckPackedArrayBounds(IRInstruction* inst) {
+  auto arrReg = m_regs[inst->src(0)].reg();
+  auto idx = inst->src(1);
+  // Unsigned compares, so negative keys are out of bounds too.
+  if (idx->isConst()) {
+    m_as.cmpl(idx->getValInt(), arrReg[ArrayData::offsetofSize()]);
+  } else {
+    m_as.loadl(arrReg[ArrayData::offsetofSize()], toReg32(m_rScratch));
+    m_as.cmpq(m_regs[idx].reg(), m_rScratch);
+  }
+  emitFwdJcc(CC_BE, inst->taken());
+}
+
+void CodeGenerator::cgLdPackedArrayElem(IRInstruction* inst) {
+  static_assert(sizeof(HphpArray::Elm) == 24,
+                "HphpArray::Elm size expected to be 24 bytes");
+  auto arrReg = m_regs[inst->src(0)].reg();
+  auto idx = inst->src(1);
+  if (idx->isConst()) {
+    m_as.loadq(arrReg[HphpArray::dataOff()], m_rScratch);
+    cgLoad(inst->dst(), m_rScratch[idx->getValInt() * sizeof(HphpArray::Elm) +
+                                   HphpArray::elmDataOff()]);
+    return;
+  }
+  // m_rScratch = m_data + idx * 24
+  auto idxReg = m_regs[idx].reg();
+  m_as.lea(idxReg[idxReg * 2], m_rScratch);
+  m_as.shlq(3, m_rScratch);
+  m_as.addq(arrReg[HphpArray::dataOff()], m_rScratch);
+  cgLoad(inst->dst(), m_rScratch[HphpArray::elmDataOff()]);
+}
+
 void CodeGenerator::cgStElem(IRInstruction* inst) {
   SSATmp* base = inst->src(0);
   auto baseReg = m_regs[base].reg();
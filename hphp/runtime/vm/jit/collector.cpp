@@ -23,12 +23,22 @@
 #include "hphp/runtime/base/strings.h"
 #include <string>
 #include <queue>
+#include <map>
+#include <memory>
 
+#include "folly/ScopeGuard.h"
+
+#include "hphp/util/async-func.h"
+#include "hphp/util/lock.h"
+#include "hphp/util/synchronizable.h"
 #include "hphp/util/trace.h"
 #include "hphp/util/debug.h"
 #include "hphp/runtime/base/file-repository.h"
+#include "hphp/runtime/base/runtime-option.h"
 #include "hphp/system/systemlib.h"
 #include "hphp/runtime/vm/treadmill.h"
+#include "hphp/runtime/vm/jit/jit-workers.h"
+#include "hphp/runtime/vm/jit/prof-data-serialize.h"
 #include "hphp/runtime/vm/jit/translator-inline.h"
 #include "hphp/runtime/vm/jit/translator-x64.h"
 
@@ -87,6 +97,8 @@ void verifyFuncReferencesSevered() {
 }
 
 void severFuncReferences(Translator* tx) {
+  // Func::resetPrologues() uses the current thread's translator's stubs.
+  assert(Translator::Get() == tx);
   DEBUG_ONLY time_t start = time(nullptr);
   struct FuncPatcher : public FuncVisitor {
     FuncPatcher() { }
@@ -102,11 +114,78 @@ void severFuncReferences(Translator* tx) {
 
 /*
  * This global flag prevents more than one replacement from happening at a
- * time, and prevents us from burning TCAs into external structures (e.g.,
- * Func's prologue tables) during periods where we can't resolve which TC to
- * use.
+ * time.  While it is set, requests that started on the old translator may
+ * still be running in the old space: the old translator makes no more
+ * code, and prologues and func bodies made by the new one are kept in
+ * s_pendingPrologues rather than burned into Funcs, where old code would
+ * find them.
  */
 volatile bool Translator::s_replaceInFlight;
+uint32_t Translator::s_numReplaces;
+
+namespace {
+
+// Protects s_pendingPrologues. Func bodies (Func::getFuncBody()) are kept
+// under kFuncBody.
+Mutex s_pendingLock;
+std::map<std::pair<const Func*,int>,TCA> s_pendingPrologues;
+const int kFuncBody = -1;
+
+TCA pendingEntry(const Func* func, int idx) {
+  Lock lock(s_pendingLock);
+  auto it = s_pendingPrologues.find(std::make_pair(func, idx));
+  return it == s_pendingPrologues.end() ? nullptr : it->second;
+}
+
+void setPendingEntry(const Func* func, int idx, TCA tca) {
+  Lock lock(s_pendingLock);
+  s_pendingPrologues[std::make_pair(func, idx)] = tca;
+}
+
+}
+
+TCA Translator::getPrologue(const Func* func, int paramIdx) {
+  if (UNLIKELY(s_replaceInFlight)) {
+    if (TCA tca = pendingEntry(func, paramIdx)) return tca;
+  }
+  return (TCA)func->getPrologue(paramIdx);
+}
+
+void Translator::setPrologue(Func* func, int paramIdx, TCA prologue) {
+  assert(s_writeLease.amOwner());
+  if (UNLIKELY(s_replaceInFlight)) {
+    setPendingEntry(func, paramIdx, prologue);
+    return;
+  }
+  func->setPrologue(paramIdx, prologue);
+}
+
+TCA Translator::getFuncBody(const Func* func) {
+  if (UNLIKELY(s_replaceInFlight)) {
+    if (TCA tca = pendingEntry(func, kFuncBody)) return tca;
+  }
+  return func->getFuncBody();
+}
+
+void Translator::setFuncBody(Func* func, TCA funcBody) {
+  assert(s_writeLease.amOwner());
+  if (UNLIKELY(s_replaceInFlight)) {
+    setPendingEntry(func, kFuncBody, funcBody);
+    return;
+  }
+  func->setFuncBody(funcBody);
+}
+
+void Translator::forgetPendingPrologues(const Func* func,
+                                        std::vector<TCA>& prologues) {
+  if (LIKELY(!s_replaceInFlight)) return;
+  Lock lock(s_pendingLock);
+  auto it = s_pendingPrologues.lower_bound(std::make_pair(func, kFuncBody));
+  while (it != s_pendingPrologues.end() && it->first.first == func) {
+    if (it->first.second != kFuncBody) prologues.push_back(it->second);
+    it = s_pendingPrologues.erase(it);
+  }
+}
 
 bool Translator::replace() {
   if (!RuntimeOption::EvalJit) return false;
@@ -118,19 +197,30 @@ bool Translator::replace() {
 
   // Maybe a replacement started and ended while we waited for the lock.
   if (this != nextTx64) return false;
-  // Exclude the creation of new prologue entries while we clean up
-  // old prologues; these are external references to the old code.
 
   s_replaceInFlight = true;
-  TranslatorX64* current = tx64;
-  severFuncReferences(current);
+  s_numReplaces++;
+  TranslatorX64* current = nextTx64;
+  // The new translator becomes this thread's while it's set up; give the
+  // caller back the one it was using.
+  TranslatorX64* const caller = tx64;
+  SCOPE_EXIT { tx64 = caller; };
   TranslatorX64* n00b = new TranslatorX64();
+  n00b->initUniqueStubs();
+  // Point every prologue at the new space's fcallHelperThunk. A request
+  // still running in the old space that calls through one gets to
+  // current->funcPrologue(), which refuses, and interprets the callee.
+  severFuncReferences(n00b);
   TRACE(0, "Tx64: replace %p a.code %p -> %p a.code %p complete\n",
         current, current->mainCode.base(),
         n00b, n00b->mainCode.base());
-  n00b->initUniqueStubs();
+  // Regions already optimized in the old space go straight to optimized
+  // translations in the new one instead of being profiled again.
+  JIT::reuseRecordedRegions();
   // Here is the changing of the guard.
   nextTx64 = n00b;
+  // Queued optimized retranslations name the old space's TransIDs.
+  forgetRetranslateOpts();
   // TxReaper: runs after a translation space becomes unreachable.
   struct TxReaper : public Treadmill::WorkItem {
     Translator* m_tx;
@@ -138,12 +228,22 @@ bool Translator::replace() {
     void operator()() {
       TRACE(1, "Tx: reaping tx at %p\n", m_tx);
       assert(Translator::ReplaceInFlight());
-      // No prologues, old or new, should be active at treadmill
-      // time.
-      verifyFuncReferencesSevered();
-      // Func*'s may have references directly into the old TC. The new one is
-      // visble now, so there may also be new
-      s_replaceInFlight = false;
+      {
+        // Nothing can be running in the old space now, so the new
+        // space's prologues can go where its code looks for them.
+        BlockingLeaseHolder writer(Translator::WriteLease());
+        Lock lock(s_pendingLock);
+        for (auto const& p : s_pendingPrologues) {
+          auto func = const_cast<Func*>(p.first.first);
+          if (p.first.second == kFuncBody) {
+            func->setFuncBody(p.second);
+          } else {
+            func->setPrologue(p.first.second, p.second);
+          }
+        }
+        s_pendingPrologues.clear();
+        s_replaceInFlight = false;
+      }
       delete m_tx;
     }
   };
@@ -153,6 +253,94 @@ bool Translator::replace() {
   return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct TCCollector {
+  TCCollector() : m_requested(nullptr), m_stopping(false) {}
+  void run();
+
+  // Guards m_requested and m_stopping.
+  Synchronizable m_sync;
+  const TranslatorX64* m_requested;
+  bool m_stopping;
+};
+
+TCCollector s_collector;
+std::unique_ptr<AsyncFunc<TCCollector>> s_collectorThread;
+
+void TCCollector::run() {
+  time_t lastReplace = 0;
+  for (;;) {
+    const TranslatorX64* full;
+    {
+      Lock l(&m_sync);
+      while (!m_requested && !m_stopping) {
+        m_sync.wait();
+      }
+      if (m_stopping) return;
+      // A working set too big for one space would otherwise have us
+      // retranslating it back to back; interpreting the overflow for a
+      // while is cheaper.
+      long remaining = lastReplace + RuntimeOption::EvalJitTCCollectInterval -
+        time(nullptr);
+      if (remaining > 0) {
+        m_sync.wait(remaining);
+        continue;
+      }
+      full = m_requested;
+      m_requested = nullptr;
+    }
+    // vm-tcreset may have beaten us to it.
+    if (full != nextTx64) continue;
+
+    Translator::advanceTranslator();
+    bool replaced = tx64->replace();
+    Translator::clearTranslator();
+    if (replaced) {
+      lastReplace = time(nullptr);
+    } else if (Translator::ReplaceInFlight()) {
+      // The space before this one is still in use by some request; we
+      // can't have three.
+      Lock l(&m_sync);
+      if (!m_requested) m_requested = full;
+      if (!m_stopping) m_sync.wait(1);
+    }
+  }
+}
+
+}
+
+void startTCCollector() {
+  if (!RuntimeOption::EvalJit || !RuntimeOption::EvalJitTCCollectPercent ||
+      s_collectorThread) {
+    return;
+  }
+  s_collector.m_stopping = false;
+  s_collectorThread.reset(
+    new AsyncFunc<TCCollector>(&s_collector, &TCCollector::run));
+  s_collectorThread->start();
+}
+
+void stopTCCollector() {
+  if (!s_collectorThread) return;
+  {
+    Lock l(&s_collector.m_sync);
+    s_collector.m_stopping = true;
+    s_collector.m_sync.notify();
+  }
+  s_collectorThread->waitForEnd();
+  s_collectorThread.reset();
+}
+
+void requestTCCollection(const TranslatorX64* tx) {
+  TRACE(0, "Tx64: translation space %p is full\n", tx);
+  Lock l(&s_collector.m_sync);
+  s_collector.m_requested = tx;
+  s_collector.m_sync.notify();
+}
+
 struct Tx64Annihilator {
   ~Tx64Annihilator() {
     if (nextTx64) {
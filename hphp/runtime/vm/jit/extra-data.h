@@ -357,6 +357,12 @@ struct ClsCnsName : IRExtraData {
     , cnsName(cns)
   {}
 
+  bool cseEquals(const ClsCnsName& o) const {
+    return clsName == o.clsName && cnsName == o.cnsName;
+  }
+  size_t cseHash() const {
+    return hash_int64_pair(intptr_t(clsName), intptr_t(cnsName));
+  }
   std::string show() const {
     return folly::to<std::string>(clsName->data(), "::", cnsName->data());
   }
@@ -374,6 +380,12 @@ struct StaticLocName : IRExtraData {
     , name(name)
   {}
 
+  bool cseEquals(const StaticLocName& o) const {
+    return func == o.func && name == o.name;
+  }
+  size_t cseHash() const {
+    return hash_int64_pair(intptr_t(func), intptr_t(name));
+  }
   std::string show() const {
     return folly::to<std::string>(
       func->fullName()->data(), "$", name->data()
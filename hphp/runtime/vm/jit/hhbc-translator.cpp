@@ -2353,7 +2353,7 @@ void HhbcTranslator::emitFPushObjMethodD(int32_t numParams,
       assert(baseClass);  // This assert may be too strong, but be aggressive
       // static function: store base class into this slot instead of obj
       // and decref the obj that was pushed as the this pointer since
-      // the obj won't be in the actrec and thus MethodCache::lookup won't
+      // the obj won't be in the actrec and thus methodCacheSlowPath won't
       // decref it
       gen(DecRef, obj);
       objOrCls = cns(baseClass);
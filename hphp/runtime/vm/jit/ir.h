@@ -328,7 +328,8 @@ O(CheckInitMem,                     ND, S(PtrToGen) C(Int),               NF) \
 O(CheckCold,                        ND, NA,                                E) \
 O(CheckNullptr,                     ND, S(CountedStr,Nullptr),            NF) \
 O(CheckBounds,                      ND, S(Int) S(Int),                E|N|Er) \
-O(LdVectorSize,                 D(Int), S(Obj),                            E) \
+O(LdVectorSize,                 D(Int), S(Obj),                            C) \
+O(CheckPackedArrayBounds,           ND, S(Arr) S(Int),                     E) \
 O(AssertNonNull, DSubtract(0, Nullptr), S(Nullptr,CountedStr),            NF) \
 O(Unbox,                     DUnbox(0), S(Gen),                           NF) \
 O(Box,                         DBox(0), S(Init),             E|N|Mem|CRc|PRc) \
@@ -336,6 +337,7 @@ O(UnboxPtr,               D(PtrToCell), S(PtrToGen),                      NF) \
 O(BoxPtr,            D(PtrToBoxedCell), S(PtrToGen),                   N|Mem) \
 O(LdVectorBase,           D(PtrToCell), S(Obj),                            E) \
 O(LdPairBase,             D(PtrToCell), S(Obj),                            E) \
+O(LdPackedArrayElem,            D(Gen), S(Arr) S(Int),                 E|Mem) \
 O(LdStack,                      DParam, S(StkPtr),                        NF) \
 O(LdLoc,                        DParam, S(FramePtr),                      NF) \
 O(LdStackAddr,                  DParam, S(StkPtr),                         C) \
@@ -356,7 +358,7 @@ O(LdClsCached,                  D(Cls), CStr,              C|E|N|Refs|Er|Mem) \
 O(LdClsCachedSafe,              D(Cls), CStr,                              C) \
 O(LdClsCtx,                     D(Cls), S(Ctx),                            C) \
 O(LdClsCctx,                    D(Cls), S(Cctx),                           C) \
-O(LdClsCns,                     DParam, NA,                               NF) \
+O(LdClsCns,                     DParam, NA,                                C) \
 O(LookupClsCns,                 DParam, NA,                  E|Refs|Er|N|Mem) \
 O(LdCns,                        DParam, CStr,                             NF) \
 O(LookupCns,                    DParam, CStr,                E|Refs|Er|N|Mem) \
@@ -428,7 +430,7 @@ O(StElem,                           ND, S(PtrToCell)                          \
                                           S(Cell),                 E|Mem|CRc) \
 O(IterCopy,                         ND, S(FramePtr) S(Int)                    \
                                         S(PtrToGen) S(Int),            E|Mem) \
-O(LdStaticLocCached,      D(BoxedCell), NA,                               NF) \
+O(LdStaticLocCached,      D(BoxedCell), NA,                                C) \
 O(CheckStaticLocInit,               ND, S(BoxedCell),                     NF) \
 O(ClosureStaticLocInit,   D(BoxedCell), CStr                                  \
                                           S(FramePtr)                         \
@@ -0,0 +1,133 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/vm/jit/jit-workers.h"
+
+#include <exception>
+
+#include "hphp/util/job-queue.h"
+#include "hphp/util/lock.h"
+#include "hphp/util/logger.h"
+#include "hphp/util/trace.h"
+#include "hphp/runtime/base/execution-context.h"
+#include "hphp/runtime/base/program-functions.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/vm/jit/translator-x64.h"
+
+namespace HPHP { namespace Transl {
+
+TRACE_SET_MOD(tx64);
+
+namespace {
+
+struct RetranslateOptJob {
+  TranslatorX64* tx;       // the space transId belongs to
+  TransID transId;
+  JIT::RegionDescPtr region;
+};
+
+struct JitWorker : JobQueueWorker<RetranslateOptJob> {
+  virtual void doJob(RetranslateOptJob job);
+};
+
+typedef JobQueueDispatcher<RetranslateOptJob, JitWorker> JitDispatcher;
+
+JitDispatcher* s_dispatcher;
+// Protects s_dispatcher, s_pending and s_failed.
+Mutex s_dispatchMutex;
+// Translations that are queued or being worked on.
+TransIDSet s_pending;
+// Translations the workers couldn't produce; left to request threads,
+// which can fall back on the live frame.
+TransIDSet s_failed;
+
+void JitWorker::doJob(RetranslateOptJob job) {
+  TransID transId = job.transId;
+  TRACE(1, "JitWorker: retranslateOpt transId = %u\n", transId);
+  // Nothing here runs PHP, but the translator expects the usual
+  // per-request state, and being in a request is what keeps the
+  // treadmill from freeing the Funcs and Units we're translating.
+  hphp_session_init();
+  ExecutionContext* context = hphp_context_init();
+  TCA start = nullptr;
+  try {
+    // If the space was replaced since this was queued, transId means
+    // nothing to the new one.
+    if (tx64 == job.tx) {
+      start = tx64->retranslateOpt(transId, false, job.region);
+    }
+  } catch (const std::exception& e) {
+    Logger::Error("JIT worker failed to retranslate %u: %s",
+                  transId, e.what());
+  } catch (...) {
+    Logger::Error("JIT worker failed to retranslate %u", transId);
+  }
+  hphp_context_exit(context, false);
+  hphp_session_exit();
+
+  Lock lock(s_dispatchMutex);
+  if (job.tx != nextTx64) return;
+  s_pending.erase(transId);
+  if (!start) s_failed.insert(transId);
+}
+
+}
+
+void startJitWorkers() {
+  if (!RuntimeOption::EvalJit || !RuntimeOption::EvalThreadingJit ||
+      RuntimeOption::EvalJitWorkerThreads == 0) {
+    return;
+  }
+  {
+    Lock lock(s_dispatchMutex);
+    if (s_dispatcher) return;
+    s_dispatcher = new JitDispatcher(RuntimeOption::EvalJitWorkerThreads,
+                                     false, 0, false, nullptr);
+  }
+  s_dispatcher->start();
+}
+
+void stopJitWorkers() {
+  JitDispatcher* dispatcher;
+  {
+    Lock lock(s_dispatchMutex);
+    dispatcher = s_dispatcher;
+    s_dispatcher = nullptr;
+  }
+  if (dispatcher) {
+    dispatcher->stop();
+    delete dispatcher;
+  }
+}
+
+bool enqueueRetranslateOpt(TransID transId, JIT::RegionDescPtr region) {
+  Lock lock(s_dispatchMutex);
+  if (!s_dispatcher || tx64 != nextTx64 || s_failed.count(transId)) {
+    return false;
+  }
+  if (s_pending.insert(transId).second) {
+    RetranslateOptJob job = { tx64, transId, region };
+    s_dispatcher->enqueue(job);
+  }
+  return true;
+}
+
+void forgetRetranslateOpts() {
+  Lock lock(s_dispatchMutex);
+  s_pending.clear();
+  s_failed.clear();
+}
+
+} }
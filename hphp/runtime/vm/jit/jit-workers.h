@@ -0,0 +1,58 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_JIT_WORKERS_H_
+#define incl_HPHP_JIT_WORKERS_H_
+
+#include "hphp/runtime/vm/jit/region-selection.h"
+#include "hphp/runtime/vm/jit/types.h"
+
+namespace HPHP { namespace Transl {
+
+/*
+ * Background JIT workers (Eval.ThreadingJit).
+ *
+ * Optimized retranslations requested by PGO profiling translations
+ * (REQ_RETRANSLATE_OPT) are normally produced inline, on whichever
+ * request thread wins the write lease.  With ThreadingJit they are
+ * queued to a pool of Eval.JitWorkerThreads threads instead, with the
+ * hot region already selected.  The requesting thread goes back to its
+ * profiling translation; the worker waits for the write lease,
+ * translates the region and publishes the result through the SrcRec
+ * like any other translation.  If it can't, the profiling translations
+ * stay, and the next request to get here translates inline instead.
+ */
+void startJitWorkers();
+void stopJitWorkers();
+
+/*
+ * Queue an optimized retranslation of the profiling translation
+ * transId, from region.  Returns false if the workers aren't running,
+ * the caller's translation space has been replaced, or the workers have
+ * already failed to translate transId, in which case the caller should
+ * translate inline.  A transId that is already queued is
+ * not queued again.
+ */
+bool enqueueRetranslateOpt(TransID transId, JIT::RegionDescPtr region);
+
+/*
+ * Called by Translator::replace() once nextTx64 is the new space.  Jobs
+ * already queued for the old one are dropped when they come up.
+ */
+void forgetRetranslateOpts();
+
+} }
+
+#endif
@@ -16,6 +16,7 @@
 
 
 #include "hphp/runtime/base/hphp-array-defs.h"
+#include "hphp/runtime/base/shared-array.h"
 #include "hphp/runtime/base/strings.h"
 #include "hphp/runtime/vm/member-operations.h"
 #include "hphp/runtime/vm/jit/hhbc-translator.h"
@@ -1604,6 +1605,31 @@ TypedValue packedArrayGetI(ArrayData* a, TypedValue* key) {
   int64_t ki = keyAsRaw<KeyType::Int>(key);
   return HphpArray::GetCellIntPacked(a, ki);
 }
+
+/*
+ * APC arrays (SharedArray) read elements straight out of shared
+ * memory and never contain refs, so these skip the kind dispatch and
+ * tvToCell of arrayGetImpl.
+ */
+TypedValue sharedArrayGetI(ArrayData* a, TypedValue* key) {
+  int64_t ki = keyAsRaw<KeyType::Int>(key);
+  if (auto ret = SharedArray::NvGetInt(a, ki)) {
+    assert(ret->m_type != KindOfRef);
+    tvRefcountedIncRef(ret);
+    return *ret;
+  }
+  return arrayGetNotFound(ki);
+}
+
+TypedValue sharedArrayGetS(ArrayData* a, TypedValue* key) {
+  StringData* ks = keyAsRaw<KeyType::Str>(key);
+  if (auto ret = SharedArray::NvGetStr(a, ks)) {
+    assert(ret->m_type != KindOfRef);
+    tvRefcountedIncRef(ret);
+    return *ret;
+  }
+  return arrayGetNotFound(ks);
+}
 }
 
 template<KeyType keyType, bool checkForInt>
@@ -1635,6 +1661,10 @@ HELPER_TABLE(ELEM)
 }
 #undef ELEM
 
+// Constant packed array keys at or past this are left to the helper, so
+// LdPackedArrayElem's displacement always fits in 32 bits.
+static const int64_t kMaxInlinePackedIdx = 1 << 24;
+
 void HhbcTranslator::MInstrTranslator::emitArrayGet(SSATmp* key) {
   KeyType keyType;
   bool checkForInt;
@@ -1650,7 +1680,34 @@ void HhbcTranslator::MInstrTranslator::emitArrayGet(SSATmp* key) {
       key->isA(Type::Int)) {
     // DataTypeSpecialized because we care about the array kind
     m_tb.constrainValue(m_base, DataTypeSpecialized);
+    if (!key->isConst() ||
+        (key->getValInt() >= 0 && key->getValInt() < kMaxInlinePackedIdx)) {
+      // Read in-bounds elements inline; only misses call the helper,
+      // which raises the undefined index notice.
+      m_result = m_tb.cond(m_ht.curFunc(),
+        [&] (Block* taken) {
+          gen(CheckPackedArrayBounds, taken, m_base, key);
+        },
+        [&] { // Next: key is in bounds
+          auto elem = gen(LdPackedArrayElem, m_base, key);
+          return gen(IncRef, gen(Unbox, elem));
+        },
+        [&] { // Taken: key is out of bounds
+          m_tb.hint(Block::Hint::Unlikely);
+          return gen(ArrayGet, cns((TCA)VectorHelpers::packedArrayGetI),
+                     m_base, key);
+        }
+      );
+      return;
+    }
     opFunc = VectorHelpers::packedArrayGetI;
+  } else if (baseType.hasArrayKind() &&
+             baseType.getArrayKind() == ArrayData::kSharedKind &&
+             (keyType == KeyType::Int ||
+              (keyType == KeyType::Str && !checkForInt))) {
+    m_tb.constrainValue(m_base, DataTypeSpecialized);
+    opFunc = keyType == KeyType::Int ? VectorHelpers::sharedArrayGetI
+                                     : VectorHelpers::sharedArrayGetS;
   }
   m_result = gen(ArrayGet, cns((TCA)opFunc), m_base, key);
 }
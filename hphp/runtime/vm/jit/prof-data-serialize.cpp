@@ -0,0 +1,537 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/runtime/vm/jit/prof-data-serialize.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include "folly/ScopeGuard.h"
+
+#include "hphp/util/hash.h"
+#include "hphp/util/lock.h"
+#include "hphp/util/logger.h"
+#include "hphp/util/repo-schema.h"
+#include "hphp/util/trace.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/vm/blob-helper.h"
+#include "hphp/runtime/vm/class.h"
+#include "hphp/runtime/vm/func.h"
+#include "hphp/runtime/vm/unit.h"
+
+namespace HPHP { namespace JIT {
+
+TRACE_SET_MOD(pgo);
+
+namespace {
+
+//////////////////////////////////////////////////////////////////////
+
+const char kMagic[8] = { 'H', 'H', 'V', 'M', 'P', 'G', 'O', '\0' };
+const uint32_t kVersion = 1;
+
+/*
+ * Fixed-size prefix of the file.  The body is a BlobEncoder blob of a
+ * ProfileRec; BlobDecoder trusts its input, so the checksum is what
+ * stands between a truncated file and a crash.
+ */
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t pad;
+  uint64_t size;
+  uint64_t checksum;
+};
+
+/*
+ * A Func named so it can be found again in a new process.  The unit md5
+ * and base offset make sure we find the same code, not just the same
+ * name.
+ */
+struct FuncKey {
+  FuncKey() : cls(nullptr), name(nullptr), md5lo(0), md5hi(0), base(0) {}
+
+  const StringData* cls;   // nullptr for non-methods
+  const StringData* name;
+  uint64_t md5lo;
+  uint64_t md5hi;
+  Offset base;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(cls)(name)(md5lo)(md5hi)(base);
+  }
+};
+
+struct TypeRec {
+  TypeRec() : bits(0), cls(nullptr), arrayKind(-1) {}
+
+  uint64_t bits;           // Type::rawBits()
+  const StringData* cls;
+  int32_t arrayKind;       // -1 if none
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(bits)(cls)(arrayKind);
+  }
+};
+
+struct TypePredRec {
+  TypePredRec() : tag(0), id(0), fpOffset(0) {}
+
+  uint32_t tag;
+  uint32_t id;             // local id or stack offset
+  uint32_t fpOffset;
+  TypeRec type;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(tag)(id)(fpOffset)(type);
+  }
+};
+
+struct RefPredRec {
+  RefPredRec() : arSpOffset(0) {}
+
+  // vector<bool> can't be decoded in place, so these are one byte per
+  // parameter.
+  std::vector<uint8_t> mask;
+  std::vector<uint8_t> vals;
+  int64_t arSpOffset;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(mask)(vals)(arSpOffset);
+  }
+};
+
+struct KnownFuncRec {
+  KnownFuncRec() : known(false) {}
+
+  bool known;              // false means "no longer known"
+  FuncKey func;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(known)(func);
+  }
+};
+
+struct BlockRec {
+  BlockRec() : start(0), length(0), initSpOff(0), hasCallee(false) {}
+
+  FuncKey func;
+  Offset start;
+  int32_t length;
+  Offset initSpOff;
+  bool hasCallee;
+  FuncKey callee;
+  std::vector<std::pair<Offset,TypePredRec>> typePreds;
+  std::vector<std::pair<Offset,bool>> byRefs;
+  std::vector<std::pair<Offset,RefPredRec>> refPreds;
+  std::vector<std::pair<Offset,KnownFuncRec>> knownFuncs;
+  std::vector<TypePredRec> postConds;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(func)(start)(length)(initSpOff)(hasCallee)(callee)
+      (typePreds)(byRefs)(refPreds)(knownFuncs)(postConds);
+  }
+};
+
+struct RegionRec {
+  std::vector<BlockRec> blocks;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(blocks);
+  }
+};
+
+struct ProfileRec {
+  ProfileRec() : buildId(nullptr), schemaId(nullptr) {}
+
+  const StringData* buildId;
+  const StringData* schemaId;
+  std::vector<RegionRec> regions;
+
+  template<class SerDe> void serde(SerDe& sd) {
+    sd(buildId)(schemaId)(regions);
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+
+// (unit md5, func base, offset) of a region's entry.
+typedef std::tuple<uint64_t,uint64_t,Offset,Offset> EntryKey;
+
+// Protects s_recorded and s_loaded. Both are keyed by the region's
+// entry; a SrcKey optimized again replaces its recorded region.
+Mutex s_lock;
+std::map<EntryKey,RegionRec> s_recorded;
+std::map<EntryKey,RegionRec> s_loaded;
+
+EntryKey entryKey(const FuncKey& func, Offset off) {
+  return EntryKey { func.md5lo, func.md5hi, func.base, off };
+}
+
+EntryKey entryKey(SrcKey sk) {
+  auto const& md5 = sk.unit()->md5();
+  return EntryKey { md5.q[0], md5.q[1], sk.func()->base(), sk.offset() };
+}
+
+/*
+ * Pseudo-mains have no name to look them up by, and cloned closures
+ * aren't PGO'd to begin with.
+ */
+bool persistable(const Func* func) {
+  return !func->isPseudoMain() && !func->isClonedClosure();
+}
+
+FuncKey funcKey(const Func* func) {
+  FuncKey key;
+  key.cls = func->cls() ? func->cls()->name() : nullptr;
+  key.name = func->name();
+  auto const& md5 = func->unit()->md5();
+  key.md5lo = md5.q[0];
+  key.md5hi = md5.q[1];
+  key.base = func->base();
+  return key;
+}
+
+bool matches(const FuncKey& key, const Func* func) {
+  auto const& md5 = func->unit()->md5();
+  return md5.q[0] == key.md5lo && md5.q[1] == key.md5hi &&
+    func->base() == key.base;
+}
+
+/*
+ * Find a Func named by a region other than the one being translated
+ * (inlined callees and known callees).  These get burned into the TC,
+ * so only Funcs that can't be redefined will do.
+ */
+const Func* resolveFunc(const FuncKey& key) {
+  const Func* func = nullptr;
+  if (key.cls) {
+    Class* cls = Unit::lookupUniqueClass(key.cls);
+    if (!cls || !(cls->attrs() & AttrUnique)) return nullptr;
+    func = cls->lookupMethod(key.name);
+  } else {
+    func = Unit::lookupFunc(key.name);
+    if (func && !(func->attrs() & AttrUnique)) return nullptr;
+  }
+  if (!func || !matches(key, func)) return nullptr;
+  return func;
+}
+
+TypeRec typeRec(Type type) {
+  TypeRec rec;
+  rec.bits = type.rawBits();
+  if (type.isSpecialized()) {
+    if (type.canSpecializeClass()) {
+      rec.cls = type.getClass()->name();
+    } else {
+      rec.arrayKind = type.getArrayKind();
+    }
+  }
+  return rec;
+}
+
+Type resolveType(const TypeRec& rec) {
+  auto type = Type::fromRawBits(rec.bits);
+  if (rec.cls) {
+    // A missing class only costs us the specialization; the type is a
+    // prediction that gets guarded on anyway.
+    if (auto cls = Unit::lookupUniqueClass(rec.cls)) {
+      type = type.specialize(cls);
+    }
+  } else if (rec.arrayKind >= 0) {
+    type = type.specialize(ArrayData::ArrayKind(rec.arrayKind));
+  }
+  return type;
+}
+
+TypePredRec typePredRec(const RegionDesc::TypePred& pred) {
+  TypePredRec rec;
+  rec.tag = uint32_t(pred.location.tag());
+  switch (pred.location.tag()) {
+    case RegionDesc::Location::Tag::Local:
+      rec.id = pred.location.localId();
+      break;
+    case RegionDesc::Location::Tag::Stack:
+      rec.id = pred.location.stackOffset();
+      rec.fpOffset = pred.location.stackOffsetFromFp();
+      break;
+  }
+  rec.type = typeRec(pred.type);
+  return rec;
+}
+
+RegionDesc::TypePred resolveTypePred(const TypePredRec& rec) {
+  typedef RegionDesc::Location Location;
+  auto loc = rec.tag == uint32_t(Location::Tag::Local)
+    ? Location(Location::Local{rec.id})
+    : Location(Location::Stack{rec.id, rec.fpOffset});
+  return RegionDesc::TypePred { loc, resolveType(rec.type) };
+}
+
+/*
+ * Turn a recorded region back into a RegionDesc for root, the Func
+ * whose SrcKey is being translated.  Returns nullptr if any of the
+ * other Funcs it mentions can't be found.
+ */
+RegionDescPtr resolveRegion(const RegionRec& rec, const Func* root) {
+  auto region = std::make_shared<RegionDesc>();
+  for (auto const& brec : rec.blocks) {
+    const Func* func = matches(brec.func, root) ? root
+                                                : resolveFunc(brec.func);
+    if (!func) return nullptr;
+
+    auto block = region->addBlock(func, brec.start, brec.length,
+                                  brec.initSpOff);
+    if (brec.hasCallee) {
+      auto callee = resolveFunc(brec.callee);
+      if (!callee) return nullptr;
+      block->setInlinedCallee(callee);
+    }
+    for (auto const& p : brec.typePreds) {
+      block->addPredicted(SrcKey(func, p.first), resolveTypePred(p.second));
+    }
+    for (auto const& p : brec.byRefs) {
+      block->setParamByRef(SrcKey(func, p.first), p.second);
+    }
+    for (auto const& p : brec.refPreds) {
+      RegionDesc::ReffinessPred pred;
+      pred.mask.assign(p.second.mask.begin(), p.second.mask.end());
+      pred.vals.assign(p.second.vals.begin(), p.second.vals.end());
+      pred.arSpOffset = p.second.arSpOffset;
+      block->addReffinessPred(SrcKey(func, p.first), pred);
+    }
+    for (auto const& p : brec.knownFuncs) {
+      const Func* known = nullptr;
+      if (p.second.known) {
+        known = resolveFunc(p.second.func);
+        if (!known) return nullptr;
+      }
+      block->setKnownFunc(SrcKey(func, p.first), known);
+    }
+    PostConditions pconds;
+    for (auto const& pc : brec.postConds) {
+      pconds.push_back(resolveTypePred(pc));
+    }
+    block->setPostConditions(pconds);
+  }
+  return region;
+}
+
+bool regionRec(const RegionDesc& region, RegionRec& rec) {
+  for (auto const& block : region.blocks) {
+    if (!persistable(block->func())) return false;
+
+    BlockRec brec;
+    brec.func = funcKey(block->func());
+    brec.start = block->start().offset();
+    brec.length = block->length();
+    brec.initSpOff = block->initialSpOffset();
+    if (auto callee = block->inlinedCallee()) {
+      if (!persistable(callee)) return false;
+      brec.hasCallee = true;
+      brec.callee = funcKey(callee);
+    }
+    for (auto const& p : block->typePreds()) {
+      brec.typePreds.emplace_back(p.first.offset(), typePredRec(p.second));
+    }
+    for (auto const& p : block->paramByRefs()) {
+      brec.byRefs.emplace_back(p.first.offset(), p.second);
+    }
+    for (auto const& p : block->reffinessPreds()) {
+      RefPredRec pred;
+      pred.mask.assign(p.second.mask.begin(), p.second.mask.end());
+      pred.vals.assign(p.second.vals.begin(), p.second.vals.end());
+      pred.arSpOffset = p.second.arSpOffset;
+      brec.refPreds.emplace_back(p.first.offset(), pred);
+    }
+    for (auto const& p : block->knownFuncs()) {
+      KnownFuncRec known;
+      if (p.second) {
+        if (!persistable(p.second)) return false;
+        known.known = true;
+        known.func = funcKey(p.second);
+      }
+      brec.knownFuncs.emplace_back(p.first.offset(), known);
+    }
+    for (auto const& pc : block->postConds()) {
+      brec.postConds.push_back(typePredRec(pc));
+    }
+    rec.blocks.push_back(std::move(brec));
+  }
+  return !rec.blocks.empty();
+}
+
+uint64_t checksum(const void* data, size_t size) {
+  return hash_string_cs(static_cast<const char*>(data), size);
+}
+
+//////////////////////////////////////////////////////////////////////
+
+}
+
+bool loadPGOProfile(const std::string& path) {
+  if (!RuntimeOption::RepoAuthoritative) {
+    // Outside of repo mode there's no guarantee a unit with a matching
+    // md5 defines the same Classes and Funcs it did last time.
+    Logger::Warning("Not loading PGO profile %s: requires "
+                    "Repo.Authoritative", path.c_str());
+    return false;
+  }
+
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) {
+    Logger::Info("No PGO profile at %s", path.c_str());
+    return false;
+  }
+  SCOPE_EXIT { fclose(f); };
+
+  FileHeader header;
+  if (fread(&header, sizeof header, 1, f) != 1 ||
+      memcmp(header.magic, kMagic, sizeof kMagic) ||
+      header.version != kVersion) {
+    Logger::Warning("Ignoring PGO profile %s: bad header", path.c_str());
+    return false;
+  }
+  std::vector<char> blob(header.size);
+  if (fread(blob.data(), 1, blob.size(), f) != blob.size() ||
+      checksum(blob.data(), blob.size()) != header.checksum) {
+    Logger::Warning("Ignoring PGO profile %s: truncated or corrupt",
+                    path.c_str());
+    return false;
+  }
+
+  ProfileRec profile;
+  BlobDecoder decoder(blob.data(), blob.size());
+  decoder(profile);
+  if (!profile.buildId || !profile.schemaId ||
+      RuntimeOption::BuildId != profile.buildId->data() ||
+      strcmp(kRepoSchemaId, profile.schemaId->data())) {
+    Logger::Warning("Ignoring PGO profile %s: written by a different build",
+                    path.c_str());
+    return false;
+  }
+
+  Lock lock(s_lock);
+  size_t loaded = 0;
+  size_t empty = 0;
+  for (auto& region : profile.regions) {
+    // the checksum only says the file is intact, not that it's sensible
+    if (region.blocks.empty()) {
+      ++empty;
+      continue;
+    }
+    auto const& entry = region.blocks.front();
+    auto key = entryKey(entry.func, entry.start);
+    if (s_loaded.insert(std::make_pair(key, std::move(region))).second) {
+      ++loaded;
+    }
+  }
+  if (empty) {
+    Logger::Warning("Ignoring %zu PGO regions without blocks in %s",
+                    empty, path.c_str());
+  }
+  Logger::Info("Loaded %zu PGO regions from %s", loaded, path.c_str());
+  return loaded != 0;
+}
+
+bool dumpPGOProfile(const std::string& path) {
+  ProfileRec profile;
+  profile.buildId = makeStaticString(RuntimeOption::BuildId);
+  profile.schemaId = makeStaticString(kRepoSchemaId);
+  {
+    Lock lock(s_lock);
+    for (auto const& p : s_recorded) profile.regions.push_back(p.second);
+    for (auto const& p : s_loaded) {
+      if (!s_recorded.count(p.first)) profile.regions.push_back(p.second);
+    }
+  }
+
+  BlobEncoder encoder;
+  encoder(profile);
+
+  FileHeader header;
+  memcpy(header.magic, kMagic, sizeof kMagic);
+  header.version = kVersion;
+  header.pad = 0;
+  header.size = encoder.size();
+  header.checksum = checksum(encoder.data(), encoder.size());
+
+  // Write to a temporary and rename, so a crash mid-dump doesn't leave
+  // a broken profile for the next startup.
+  auto const tmpPath = path + ".tmp";
+  FILE* f = fopen(tmpPath.c_str(), "w");
+  if (!f) {
+    Logger::Error("Unable to open %s for writing", tmpPath.c_str());
+    return false;
+  }
+  bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+    fwrite(encoder.data(), 1, encoder.size(), f) == encoder.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmpPath.c_str(), path.c_str())) {
+    Logger::Error("Unable to write PGO profile %s", path.c_str());
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  Logger::Info("Wrote %zu PGO regions to %s", profile.regions.size(),
+               path.c_str());
+  return true;
+}
+
+void recordOptimizedRegion(const RegionDesc& region) {
+  if (RuntimeOption::EvalJitPGOProfilePath.empty() &&
+      !RuntimeOption::EvalJitTCCollectPercent) {
+    return;
+  }
+
+  RegionRec rec;
+  if (!regionRec(region, rec)) return;
+  auto const& entry = rec.blocks.front();
+  auto key = entryKey(entry.func, entry.start);
+  Lock lock(s_lock);
+  auto it = s_recorded.find(key);
+  if (it != s_recorded.end()) {
+    it->second = std::move(rec);
+  } else if (s_recorded.size() <
+             RuntimeOption::EvalJitPGOProfileMaxRegions) {
+    s_recorded.emplace(key, std::move(rec));
+  }
+}
+
+void reuseRecordedRegions() {
+  Lock lock(s_lock);
+  for (auto const& p : s_recorded) {
+    s_loaded[p.first] = p.second;
+  }
+}
+
+RegionDescPtr takePersistedRegion(SrcKey sk) {
+  Lock lock(s_lock);
+  if (s_loaded.empty()) return nullptr;
+  auto it = s_loaded.find(entryKey(sk));
+  if (it == s_loaded.end()) return nullptr;
+
+  auto region = resolveRegion(it->second, sk.func());
+  FTRACE(1, "takePersistedRegion: {} for {}\n",
+         region ? "resolved" : "dropped", sk.func()->fullName()->data());
+  s_loaded.erase(it);
+  return region;
+}
+
+} }
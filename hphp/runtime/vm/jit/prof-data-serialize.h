@@ -0,0 +1,76 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_PROF_DATA_SERIALIZE_H_
+#define incl_HPHP_PROF_DATA_SERIALIZE_H_
+
+#include <string>
+
+#include "hphp/runtime/vm/srckey.h"
+#include "hphp/runtime/vm/jit/region-selection.h"
+
+namespace HPHP { namespace JIT {
+
+/*
+ * PGO profiles that survive a restart (Eval.JitPGOProfilePath).
+ *
+ * Every region picked for a TransOptimize translation is recorded, and
+ * the set is written out at shutdown or on the vm-dump-pgo admin
+ * command.  A server started from the same build and repo loads the
+ * file at startup and translates those SrcKeys straight to optimized
+ * code the first time they're reached, skipping the profiling phase.
+ *
+ * Only region descriptions are saved, with Funcs and Classes named
+ * rather than pointed to.  Translation counters and prologue callers
+ * are addresses in the old process' TC and aren't worth keeping.
+ */
+
+/*
+ * Read a profile written by dumpPGOProfile.  Files from a different
+ * build or repo schema are ignored.  Returns false if nothing was
+ * loaded.
+ */
+bool loadPGOProfile(const std::string& path);
+
+/*
+ * Write the regions recorded so far, plus any loaded ones that haven't
+ * been used yet, to path.
+ */
+bool dumpPGOProfile(const std::string& path);
+
+/*
+ * Remember region, which was just translated as a TransOptimize
+ * translation, for the next dumpPGOProfile or reuseRecordedRegions.
+ * Only the latest region for each entry SrcKey is kept, for at most
+ * Eval.JitPGOProfileMaxRegions SrcKeys.
+ */
+void recordOptimizedRegion(const RegionDesc& region);
+
+/*
+ * Make the regions recorded so far available to takePersistedRegion, for
+ * a new translation space to reuse (Translator::replace()).  They are
+ * still written out by dumpPGOProfile.
+ */
+void reuseRecordedRegions();
+
+/*
+ * Return the loaded region starting at sk, if there is one whose Funcs
+ * and Classes all resolve in this process, and forget it.
+ */
+RegionDescPtr takePersistedRegion(SrcKey sk);
+
+} }
+
+#endif
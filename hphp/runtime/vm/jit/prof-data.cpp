@@ -30,6 +30,7 @@ static const Trace::Module TRACEMOD = Trace::pgo;
 
 using Transl::Tracelet;
 using Transl::TransAnchor;
+using Transl::TransOptimize;
 using Transl::TransPrologue;
 using Transl::TransProflogue;
 using Transl::TransProfile;
@@ -344,6 +345,20 @@ TransID ProfData::addTransAnchor(const SrcKey& sk) {
   return transId;
 }
 
+/*
+ * Record an optimized translation made straight from a profiled
+ * region, without a Tracelet (see TranslatorX64::translateWork).
+ */
+TransID ProfData::addTransOptimize(const SrcKey& sk,
+                                   const RegionDesc& region) {
+  assert(!region.blocks.empty());
+  TransID transId = m_numTrans++;
+  Offset lastBcOff = region.blocks.back()->last().offset();
+  m_transRecs.emplace_back(new ProfTransRec(transId, TransOptimize, lastBcOff,
+                                            sk, nullptr));
+  return transId;
+}
+
 PrologueCallersRec* ProfData::findPrologueCallersRec(const Func* func,
                                                      int nArgs) const {
   TransID tid = prologueTransId(func, nArgs);
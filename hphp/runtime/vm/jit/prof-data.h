@@ -207,6 +207,8 @@ public:
   TransID                 addTransPrologue(TransKind kind, const SrcKey& sk,
                                            int nArgs);
   TransID                 addTransAnchor(const SrcKey& sk);
+  TransID                 addTransOptimize(const SrcKey& sk,
+                                           const RegionDesc& region);
   PrologueCallersRec*     findPrologueCallersRec(const Func* func,
                                                  int nArgs) const;
   void                    addPrologueMainCaller(const Func* func, int nArgs,
@@ -151,7 +151,26 @@ RegionDescPtr selectHotTrace(TransID triggerId,
 
   PostConditions accumPostConds;
 
-  while (!setContains(selectedSet, tid)) {
+  // Number of times the trace has come back around to triggerId.  A
+  // trace that loops back to its own entry is a loop body; with
+  // JitPGOLoopUnroll > 1 we lay down that many copies of it, so values
+  // carried from one iteration to the next stay in registers instead of
+  // going through the frame and the translation's guards every time.
+  uint32_t iterations = 1;
+  // The translations in the current copy of the loop body; selectedSet
+  // keeps those of every copy.
+  TransIDSet copySet;
+
+  while (true) {
+    if (setContains(copySet, tid)) {
+      if (tid != triggerId ||
+          iterations >= RuntimeOption::EvalJitPGOLoopUnroll) {
+        break;
+      }
+      FTRACE(5, "selectHotTrace: unrolling loop at Translation {}\n", tid);
+      ++iterations;
+      copySet.clear();
+    }
 
     RegionDescPtr blockRegion = profData->transRegion(tid);
     if (blockRegion == nullptr) break;
@@ -197,9 +216,18 @@ RegionDescPtr selectHotTrace(TransID triggerId,
         break;
       }
     }
-    region->blocks.insert(region->blocks.end(), blockRegion->blocks.begin(),
-                          blockRegion->blocks.end());
+    if (iterations == 1) {
+      region->blocks.insert(region->blocks.end(), blockRegion->blocks.begin(),
+                            blockRegion->blocks.end());
+    } else {
+      // translateRegion tells the entry and the last block apart by
+      // identity, so later copies of the loop body need their own Blocks.
+      for (auto const& b : blockRegion->blocks) {
+        region->blocks.emplace_back(std::make_shared<RegionDesc::Block>(*b));
+      }
+    }
     selectedSet.insert(tid);
+    copySet.insert(tid);
 
     Op lastOp = *(profData->transLastInstr(tid));
     if (breaksRegion(lastOp)) {
@@ -245,6 +273,16 @@ RegionDescPtr selectHotTrace(TransID triggerId,
     }
     assert(maxArc != nullptr);
 
+    // Don't pull a rarely taken successor into the region, where it
+    // would sit in the middle of hot code; it gets its own translation.
+    auto const minPct = RuntimeOption::EvalJitPGOMinArcPercent;
+    if (minPct && maxWeight * 100 < cfg.weight(tid) * int64_t(minPct)) {
+      FTRACE(5, "selectHotTrace: breaking region because the hottest "
+             "successor of Translation {} has weight {} of {}\n",
+             tid, maxWeight, cfg.weight(tid));
+      break;
+    }
+
     // Break after the first block if it corresponds to a DV funclet.
     // This is to avoid generating many large regions including the
     // function body entry.
@@ -483,13 +483,6 @@ const Func* FixedFuncCache::lookupUnknownFunc(StringData* name) {
 //=============================================================================
 // MethodCache
 
-template<>
-inline int
-MethodCache::hashKey(uintptr_t c) {
-  pointer_hash<Class> h;
-  return h(reinterpret_cast<const Class*>(c));
-}
-
 /*
  * This is flagged NEVER_INLINE because if gcc inlines it, it will
  * hoist a bunch of initialization code (callee-saved regs pushes,
@@ -498,28 +491,39 @@ MethodCache::hashKey(uintptr_t c) {
  * call.
  */
 HOT_FUNC_VM NEVER_INLINE
-void methodCacheSlowPath(MethodCache::Pair* mce,
+void methodCacheSlowPath(MethodCache* mc,
                          ActRec* ar,
                          StringData* name,
                          Class* cls) {
   assert(ar->hasThis());
   assert(ar->getThis()->getVMClass() == cls);
-  assert(IMPLIES(mce->m_key, mce->m_value));
 
   try {
-    bool isMagicCall = mce->m_key & 0x1u;
+    bool isMagicCall;
     bool isStatic;
     const Func* func;
 
-    auto* storedClass = reinterpret_cast<Class*>(mce->m_key & ~0x3u);
-    if (storedClass == cls) {
+    // Lines fill up in order, so this stops at cls's line, the first
+    // empty line, or the end if the call site is megamorphic.
+    auto* mce = mc->m_pairs;
+    auto* const end = mc->m_pairs + MethodCache::kNumLines;
+    while (mce != end && mce->m_key &&
+           reinterpret_cast<Class*>(mce->m_key & ~0x3u) != cls) {
+      ++mce;
+    }
+    assert(mce == end || IMPLIES(mce->m_key, mce->m_value));
+
+    if (mce != end && mce->m_key) {
+      // cls is cached, but as a magic or static call; the TC's bitwise
+      // compare never matches those.
+      isMagicCall = mce->m_key & 0x1u;
       isStatic = mce->m_key & 0x2u;
       func = mce->m_value;
     } else {
-      if (LIKELY(storedClass != nullptr &&
-                 ((func = cls->wouldCall(mce->m_value)) != nullptr) &&
-                 !isMagicCall)) {
-        Stats::inc(Stats::TgtCache_MethodHit, func != nullptr);
+      auto const* first = mc->m_pairs;
+      if (LIKELY(first->m_key && !(first->m_key & 0x1u) &&
+                 ((func = cls->wouldCall(first->m_value)) != nullptr))) {
+        Stats::inc(Stats::TgtCache_MethodHit);
         isMagicCall = false;
       } else {
         Class* ctx = arGetContextClass((ActRec*)ar->m_savedRbp);
@@ -543,9 +547,13 @@ void methodCacheSlowPath(MethodCache::Pair* mce,
 
       isStatic = func->attrs() & AttrStatic;
 
-      mce->m_key = uintptr_t(cls) | (uintptr_t(isStatic) << 1) |
-        uintptr_t(isMagicCall);
-      mce->m_value = func;
+      if (mce != end) {
+        mce->m_key = uintptr_t(cls) | (uintptr_t(isStatic) << 1) |
+          uintptr_t(isMagicCall);
+        mce->m_value = func;
+      } else {
+        Stats::inc(Stats::TgtCache_MethodMegamorphic);
+      }
     }
 
     assert(func);
@@ -592,33 +600,6 @@ void methodCacheSlowPath(MethodCache::Pair* mce,
   }
 }
 
-template<>
-HOT_FUNC_VM
-void
-MethodCache::lookup(Handle handle, ActRec* ar, const void* extraKey) {
-  assert(ar->hasThis());
-  auto* cls = ar->getThis()->getVMClass();
-  auto* pair = MethodCache::cacheAtHandle(handle)->keyToPair(uintptr_t(cls));
-
-  /*
-   * The MethodCache line consists of a Class* key (stored as a
-   * uintptr_t) and a Func*.  The low bit of the key is set if the
-   * function call is a magic call (in which case the cached Func* is
-   * the __call function).  The second lowest bit of the key is set if
-   * the cached Func has AttrStatic.
-   *
-   * For this fast path, we just check if the key is bitwise equal to
-   * the Class* on the object.  If either of the special bits are set
-   * in the key we'll bail to the slow path.
-   */
-  if (LIKELY(pair->m_key == reinterpret_cast<uintptr_t>(cls))) {
-    ar->m_func = pair->m_value;
-  } else {
-    auto* name = static_cast<const StringData*>(extraKey);
-    methodCacheSlowPath(pair, ar, const_cast<StringData*>(name), cls);
-  }
-}
-
 static CacheHandle allocFuncOrClass(const unsigned* handlep, bool persistent) {
   if (UNLIKELY(!*handlep)) {
     Lock l(s_handleMutex);
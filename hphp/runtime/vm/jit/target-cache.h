@@ -265,10 +265,38 @@ struct StaticMethodFCache {
 
 typedef Cache<const StringData*, const Func*, StringData*, NSDynFunction>
   FuncCache;
-typedef Cache<uintptr_t, const Func*, ActRec*, NSInvalid, 1, void>
-  MethodCache;
 typedef Cache<StringData*, const Class*, StringData*, NSClass> ClassCache;
 
+/*
+ * Per-call-site polymorphic inline cache for FPushObjMethodD.
+ *
+ * The TC compares the object's Class* against the first line inline and
+ * against the rest, in order, out of line in astubs; see cgLdObjMethod.
+ * methodCacheSlowPath fills lines in order as new classes show up. Once
+ * they're all taken the call site is megamorphic: misses look the method
+ * up (via Class::wouldCall on the first line's Func* when it can) without
+ * evicting anything, so classes sharing a call site can't thrash it.
+ *
+ * A key is a Class* stored as a uintptr_t. Its low bit is set if the call
+ * is magic (the cached Func* is __call) and the second lowest if the
+ * cached Func has AttrStatic; the TC compares keys bitwise, so those
+ * lines always take the slow path.
+ */
+struct MethodCache {
+  static const int kNumLines = 4;
+
+  struct Pair {
+    uintptr_t   m_key;
+    const Func* m_value;
+  } m_pairs[kNumLines];
+
+  static CacheHandle alloc() {
+    // Keep all the lines together; a miss on one probes the next.
+    return namedAlloc<NSInvalid>(nullptr, sizeof(MethodCache),
+                                 sizeof(MethodCache));
+  }
+};
+
 /*
  * Classes.
  *
@@ -355,7 +383,7 @@ public:
                                  Class* ctx);
 };
 
-void methodCacheSlowPath(MethodCache::Pair* mce,
+void methodCacheSlowPath(MethodCache* mc,
                          ActRec* ar,
                          StringData* name,
                          Class* cls);
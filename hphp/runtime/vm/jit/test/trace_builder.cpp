@@ -0,0 +1,88 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include <gtest/gtest.h>
+
+#include "hphp/util/base.h"
+#include "hphp/runtime/vm/jit/ir.h"
+#include "hphp/runtime/vm/jit/ir-unit.h"
+#include "hphp/runtime/vm/jit/trace-builder.h"
+// for a real Func with locals to build traces in
+#include "hphp/system/systemlib.h"
+
+namespace HPHP {  namespace JIT {
+
+namespace {
+
+int countOps(const IRTrace* trace, Opcode op) {
+  int n = 0;
+  for (auto const block : *trace) {
+    for (auto const& inst : *block) {
+      if (inst.op() == op) ++n;
+    }
+  }
+  return n;
+}
+
+struct VectorTrace {
+  VectorTrace()
+    : func(SystemLib::s_ExceptionClass->getCtor())
+    , tb(0, 0, unit, func)
+  {
+    tb.setMarker(BCMarker{ func, 0, 0 });
+    auto const fp = tb.gen(DefFP);
+    tb.gen(DefSP, StackOffset(0), fp);
+    vec = tb.gen(LdLoc, Type::Obj, LdLocData(0, nullptr), fp);
+    other = tb.gen(LdLoc, Type::Obj, LdLocData(1, nullptr), fp);
+    idx = tb.gen(LdLoc, Type::Int, LdLocData(2, nullptr), fp);
+  }
+
+  // what MInstrTranslator emits ahead of every Vector element access
+  void checkedAccess() {
+    auto const size = tb.gen(LdVectorSize, vec);
+    tb.gen(CheckBounds, idx, size);
+  }
+
+  IRUnit unit;
+  const Func* func;
+  TraceBuilder tb;
+  SSATmp* vec;
+  SSATmp* other;
+  SSATmp* idx;
+};
+
+}
+
+TEST(TraceBuilder, DominatedBoundsCheck) {
+  VectorTrace t;
+  t.checkedAccess();
+  t.checkedAccess();
+  EXPECT_EQ(1, countOps(t.tb.trace(), LdVectorSize));
+  EXPECT_EQ(1, countOps(t.tb.trace(), CheckBounds));
+}
+
+TEST(TraceBuilder, BoundsCheckAfterCallOut) {
+  // Releasing another object could run a destructor that resizes the
+  // Vector, so the size has to be loaded and checked again.
+  VectorTrace t;
+  t.checkedAccess();
+  t.tb.gen(DecRef, t.other);
+  t.checkedAccess();
+  EXPECT_EQ(2, countOps(t.tb.trace(), LdVectorSize));
+  EXPECT_EQ(2, countOps(t.tb.trace(), CheckBounds));
+}
+
+} }
@@ -372,9 +372,22 @@ void TraceBuilder::updateTrackedState(IRInstruction* inst) {
     m_spValue = inst->modifiedStkPtr();
   }
 
+  // A Vector's size only changes in C++ (a method, or a destructor that
+  // reaches one), so LdVectorSize stays valid until the next call out of
+  // the translation.  CheckBounds only calls out to throw.
+  if (!m_vectorSizes.empty() && inst->op() != CheckBounds &&
+      (inst->isNative() || inst->mayReenterHelper())) {
+    for (auto const size : m_vectorSizes) cseKill(size);
+    m_vectorSizes.clear();
+  }
+
   // update the CSE table
   if (m_enableCse && inst->canCSE()) {
     cseInsert(inst);
+    if (inst->op() == LdVectorSize) m_vectorSizes.push_back(inst->dst());
+  }
+  if (m_enableCse && inst->op() == CheckBounds) {
+    m_boundsChecks.push_back(inst);
   }
 
   // if the instruction kills any of its sources, remove them from the
@@ -914,6 +927,12 @@ SSATmp* TraceBuilder::optimizeWork(IRInstruction* inst,
   // copy propagation on inst source operands
   copyProp(inst);
 
+  if (m_enableCse && inst->op() == CheckBounds && boundsChecked(inst, idoms)) {
+    FTRACE(1, "  {}redundant bounds check\n", indent());
+    inst->convertToNop();
+    return nullptr;
+  }
+
   SSATmp* result = nullptr;
   if (m_enableCse && inst->canCSE()) {
     result = cseLookup(inst, idoms);
@@ -1064,6 +1083,30 @@ void TraceBuilder::reoptimize() {
 
 void TraceBuilder::killCse() {
   m_cseHash.clear();
+  m_boundsChecks.clear();
+  m_vectorSizes.clear();
+}
+
+/*
+ * A CheckBounds is redundant if an earlier one with the same index and
+ * size dominates it: both are SSA values, so they can't have changed in
+ * between.  For Vectors the size is an LdVectorSize, which is only the
+ * same SSA value for both checks if nothing that could resize the Vector
+ * ran in between (see updateTrackedState).  This matters most for the
+ * same element accessed in several places, and for the copies of a loop
+ * body in an unrolled region.
+ */
+bool TraceBuilder::boundsChecked(IRInstruction* inst,
+                                 const folly::Optional<IdomVector>& idoms)
+  const {
+  assert(inst->op() == CheckBounds);
+  for (auto const prev : m_boundsChecks) {
+    if (prev->src(0) == inst->src(0) && prev->src(1) == inst->src(1) &&
+        (!idoms || dominates(prev->block(), inst->block(), *idoms))) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void TraceBuilder::clearLocals() {
@@ -377,6 +377,8 @@ private:
   void      cseKill(SSATmp* src);
   CSEHash*  cseHashTable(IRInstruction* inst);
   void      killCse();
+  bool      boundsChecked(IRInstruction* inst,
+                          const folly::Optional<IdomVector>& idoms) const;
   void      killLocalsForCall();
   void      killLocalValue(uint32_t id);
   void      setLocalType(uint32_t id, Type type);
@@ -467,6 +469,13 @@ private:
   int32_t    m_spOffset;     // offset of physical sp from physical fp
   SSATmp*    m_curFunc;      // current function context
   CSEHash    m_cseHash;
+  // CheckBounds instructions already on the trace; a later one with the
+  // same index and size is redundant.  Has the same lifetime as
+  // m_cseHash.
+  smart::vector<IRInstruction*> m_boundsChecks;
+  // LdVectorSize results in m_cseHash, dropped from it by anything that
+  // could resize a Vector.
+  smart::vector<SSATmp*> m_vectorSizes;
   bool       m_thisIsAvailable; // true only if current ActRec has non-null this
   bool       m_frameSpansCall;  // does the inlined frame span a function call
   bool       m_needsFPAnchor;
@@ -57,6 +57,7 @@
 #include "hphp/util/bitops.h"
 #include "hphp/util/debug.h"
 #include "hphp/util/disasm.h"
+#include "hphp/util/lock.h"
 #include "hphp/util/maphuge.h"
 #include "hphp/util/rank.h"
 #include "hphp/util/ringbuffer.h"
@@ -94,6 +95,8 @@
 #include "hphp/runtime/vm/jit/code-gen.h"
 #include "hphp/runtime/vm/jit/hhbc-translator.h"
 #include "hphp/runtime/vm/jit/ir-translator.h"
+#include "hphp/runtime/vm/jit/jit-workers.h"
+#include "hphp/runtime/vm/jit/prof-data-serialize.h"
 #include "hphp/runtime/vm/jit/normalized-instruction.h"
 #include "hphp/runtime/vm/jit/opt.h"
 #include "hphp/runtime/vm/jit/print.h"
@@ -229,6 +232,15 @@ TCA TranslatorX64::retranslate(const TranslArgs& args) {
   SKTRACE(1, args.m_sk, "retranslate\n");
   if (m_mode == TransInvalid) {
     m_mode = profileSrcKey(args.m_sk) ? TransProfile : TransLive;
+    if (m_mode == TransProfile) {
+      // A previous run of this build already profiled sk; go straight
+      // to the region it settled on.
+      if (auto region = JIT::takePersistedRegion(args.m_sk)) {
+        m_profData->setOptimized(args.m_sk);
+        m_mode = TransOptimize;
+        return translate(TranslArgs(args).region(region));
+      }
+    }
   }
   return translate(args);
 }
@@ -254,11 +266,19 @@ bool TranslatorX64::prologuesWereRegenerated(const Func* func) {
   return false;
 }
 
-TCA TranslatorX64::retranslateOpt(TransID transId, bool align) {
-  LeaseHolder writer(s_writeLease);
+TCA TranslatorX64::retranslateOpt(TransID transId, bool align,
+                                  JIT::RegionDescPtr region /* = nullptr */) {
+  bool const background = region != nullptr;
+  // JIT workers have nothing better to do than wait for the lease.
+  LeaseHolder writer(s_writeLease,
+                     background || RuntimeOption::EvalJitRequireWriteLease ?
+                     LeaseAcquire::BLOCKING : LeaseAcquire::ACQUIRE);
   if (!writer) return nullptr;
+  // A replaced translator makes no more code; see Translator::replace().
+  if (this != nextTx64) return nullptr;
 
-  TRACE(1, "retranslateOpt: transId = %u\n", transId);
+  TRACE(1, "retranslateOpt: transId = %u%s\n", transId,
+        background ? " (background)" : "");
 
   always_assert(m_profData->transRegion(transId) != nullptr);
 
@@ -266,22 +286,28 @@ TCA TranslatorX64::retranslateOpt(TransID transId, bool align) {
   const SrcKey& sk = m_profData->transSrcKey(transId);
 
   if (func->isEntry(sk.offset()) && !prologuesWereRegenerated(func)) {
-    regeneratePrologues(func);
+    regeneratePrologues(func, background);
   }
 
   // We may get here multiple times because different translations of
   // the same SrcKey hit the optimization threshold.  Only the first
   // time around we want to invalidate the existing translations.
   bool alreadyOptimized = m_profData->optimized(sk);
-  m_profData->setOptimized(sk);
 
   bool setFuncBody = (!alreadyOptimized &&
                       func->base() == sk.offset() &&
                       func->getDVFunclets().size() == 0);
 
   if (!alreadyOptimized) {
-    if (setFuncBody) func->setFuncBody(uniqueStubs.funcBodyHelperThunk);
-    invalidateSrcKey(sk);
+    // In the background, translateWork() only replaces the profiling
+    // translations once the optimized one is done.
+    if (!background) {
+      m_profData->setOptimized(sk);
+      if (setFuncBody) {
+        Translator::setFuncBody(func, uniqueStubs.funcBodyHelperThunk);
+      }
+      invalidateSrcKey(sk);
+    }
   } else {
     // Bail if we already reached the maximum number of translations per SrcKey.
     // Note that this can only happen with multi-threading.
@@ -292,10 +318,40 @@ TCA TranslatorX64::retranslateOpt(TransID transId, bool align) {
   }
 
   m_mode = TransOptimize;
-  auto translArgs = TranslArgs(sk, align).transId(transId);
+  auto translArgs = TranslArgs(sk, align).transId(transId)
+                                         .background(background);
+  if (background) translArgs.region(region);
   if (setFuncBody) translArgs.setFuncBody();
 
-  return retranslate(translArgs);
+  TCA start = retranslate(translArgs);
+  if (background && start && !alreadyOptimized) {
+    m_profData->setOptimized(sk);
+  }
+  return start;
+}
+
+/*
+ * EvalThreadingJit version of retranslateOpt: hand the work to the JIT
+ * workers and keep running the existing profiling translation until
+ * the optimized one is published.
+ *
+ * The region is selected here rather than on the worker: TransCFG
+ * weighs each translation by how far its counter has counted down, and
+ * the counter is rewound afterwards so the translation doesn't keep
+ * coming back here in the meantime.
+ */
+TCA TranslatorX64::queueRetranslateOpt(TransID transId) {
+  LeaseHolder writer(s_writeLease);
+  if (!writer) return nullptr;
+
+  JIT::RegionDescPtr region = JIT::selectHotRegion(transId, this);
+  if (!region || region->blocks.empty() ||
+      !enqueueRetranslateOpt(transId, region)) {
+    return retranslateOpt(transId, false);
+  }
+  TRACE(1, "queueRetranslateOpt: transId = %u\n", transId);
+  *m_profData->transCounterAddr(transId) = RuntimeOption::EvalJitPGOThreshold;
+  return getTopTranslation(m_profData->transSrcKey(transId));
 }
 
 
@@ -438,6 +494,24 @@ TranslatorX64::createTranslation(const TranslArgs& args) {
   return retransl();
 }
 
+/*
+ * Stale translations (retranslations past EvalJitMaxTranslations, code for
+ * invalidated units, abandoned profiling translations) are never freed
+ * from the bump-allocated code regions. Rather than filling up and
+ * leaving new code to the interpreter, a space that is
+ * EvalJitTCCollectPercent full is replaced wholesale: see
+ * Translator::replace().
+ */
+bool TranslatorX64::tcNeedsCollection() const {
+  auto const pct = RuntimeOption::EvalJitTCCollectPercent;
+  if (!pct) return false;
+  auto full = [&] (const CodeBlock& cb) {
+    return cb.capacity() && cb.used() * 100 >= cb.capacity() * pct;
+  };
+  return full(mainCode) || full(stubsCode) || full(profCode) ||
+    m_globalData.used() * 100 >= m_globalData.capacity() * pct;
+}
+
 TCA
 TranslatorX64::lookupTranslation(SrcKey sk) const {
   if (SrcRec* sr = m_srcDB.find(sk)) {
@@ -449,8 +523,11 @@ TranslatorX64::lookupTranslation(SrcKey sk) const {
 TCA
 TranslatorX64::translate(const TranslArgs& args) {
   INC_TPC(translate);
-  assert(((uintptr_t)vmsp() & (sizeof(Cell) - 1)) == 0);
-  assert(((uintptr_t)vmfp() & (sizeof(Cell) - 1)) == 0);
+  // JIT workers have no VM frame.
+  assert(args.m_background ||
+         ((uintptr_t)vmsp() & (sizeof(Cell) - 1)) == 0);
+  assert(args.m_background ||
+         ((uintptr_t)vmfp() & (sizeof(Cell) - 1)) == 0);
   assert(m_mode != TransInvalid);
   SCOPE_EXIT{ m_mode = TransInvalid; };
 
@@ -462,10 +539,28 @@ TranslatorX64::translate(const TranslArgs& args) {
     }
   }
 
+  if (UNLIKELY(this != nextTx64)) {
+    // Replaced; requests still running here interpret anything new.
+    return nullptr;
+  }
+  if (UNLIKELY(m_collectRequested) || tcNeedsCollection()) {
+    // This space is about to be replaced; don't add code it'll throw away.
+    if (!m_collectRequested) {
+      m_collectRequested = true;
+      requestTCCollection(this);
+    }
+    return nullptr;
+  }
+
   Func* func = const_cast<Func*>(args.m_sk.func());
+  // Optimized translations are the ones whose profiling counters crossed
+  // JitPGOThreshold, so they go with the AttrHot code; what stays in a is
+  // code nobody has shown to be hot.
+  bool const isHot = (func->attrs() & AttrHot) ||
+    (m_mode == TransOptimize && RuntimeOption::EvalJitPGOHotLayout);
   CodeBlockSelector asmSel(CodeBlockSelector::Args(this)
                            .profile(m_mode == TransProfile)
-                           .hot(func->attrs() & AttrHot));
+                           .hot(isHot));
 
   if (args.m_align) {
     Asm a { mainCode };
@@ -474,10 +569,10 @@ TranslatorX64::translate(const TranslArgs& args) {
 
   TCA start = mainCode.frontier();
 
-  translateWork(args);
+  if (!translateWork(args)) return nullptr;
 
   if (args.m_setFuncBody) {
-    func->setFuncBody(start);
+    setFuncBody(func, start);
   }
   SKTRACE(1, args.m_sk, "translate moved head from %p to %p\n",
           getTopTranslation(args.m_sk), start);
@@ -679,18 +774,21 @@ TranslatorX64::emitCallArrayPrologue(const Func* func,
 
 TCA
 TranslatorX64::getCallArrayPrologue(Func* func) {
-  TCA tca = func->getFuncBody();
-  if (tca != uniqueStubs.funcBodyHelperThunk) return tca;
+  // Once this translator has been replaced, func bodies belong to the new
+  // space.
+  bool const current = this == nextTx64;
+  TCA tca = getFuncBody(func);
+  if (current && tca != uniqueStubs.funcBodyHelperThunk) return tca;
 
   DVFuncletsVec dvs = func->getDVFunclets();
 
   if (dvs.size()) {
     LeaseHolder writer(s_writeLease);
-    if (!writer) return nullptr;
-    tca = func->getFuncBody();
+    if (!writer || !current) return nullptr;
+    tca = getFuncBody(func);
     if (tca != uniqueStubs.funcBodyHelperThunk) return tca;
     tca = emitCallArrayPrologue(func, dvs);
-    func->setFuncBody(tca);
+    setFuncBody(func, tca);
   } else {
     SrcKey sk(func, func->base());
     tca = tx64->getTranslation(TranslArgs(sk, false).setFuncBody());
@@ -754,28 +852,41 @@ void
 TranslatorX64::smashPrologueGuards(TCA* prologues, int numPrologues,
                                    const Func* func) {
   DEBUG_ONLY std::unique_ptr<LeaseHolder> writer;
-  for (int i = 0; i < numPrologues; i++) {
-    if (prologues[i] != uniqueStubs.fcallHelperThunk
-        && funcPrologueHasGuard(prologues[i], func)) {
-      if (debug) {
-        /*
-         * Unit's are sometimes created racily, in which case all
-         * but the first are destroyed immediately. In that case,
-         * the Funcs of the destroyed Units never need their
-         * prologues smashing, and it would be a lock rank violation
-         * to take the write lease here.
-         * In all other cases, Funcs are destroyed via a delayed path
-         * (treadmill) and the rank violation isn't an issue.
-         *
-         * Also note that we only need the write lease because we
-         * mprotect the translation cache in debug builds.
-         */
-        if (!writer) {
-          writer.reset(new LeaseHolder(s_writeLease, LeaseAcquire::BLOCKING));
-        }
+  auto smash = [&] (TCA prologue) {
+    // While a replace() is in flight, the table points at the new space's
+    // fcallHelperThunk, whichever translator this is.
+    if (prologue == uniqueStubs.fcallHelperThunk ||
+        prologue == nextTx64->uniqueStubs.fcallHelperThunk ||
+        !funcPrologueHasGuard(prologue, func)) {
+      return;
+    }
+    if (debug) {
+      /*
+       * Unit's are sometimes created racily, in which case all
+       * but the first are destroyed immediately. In that case,
+       * the Funcs of the destroyed Units never need their
+       * prologues smashing, and it would be a lock rank violation
+       * to take the write lease here.
+       * In all other cases, Funcs are destroyed via a delayed path
+       * (treadmill) and the rank violation isn't an issue.
+       *
+       * Also note that we only need the write lease because we
+       * mprotect the translation cache in debug builds.
+       */
+      if (!writer) {
+        writer.reset(new LeaseHolder(s_writeLease, LeaseAcquire::BLOCKING));
       }
-      funcPrologueSmashGuard(prologues[i], func);
     }
+    funcPrologueSmashGuard(prologue, func);
+  };
+  for (int i = 0; i < numPrologues; i++) {
+    smash(prologues[i]);
+  }
+  // Prologues made during a replace() that aren't in the table yet.
+  std::vector<TCA> pending;
+  forgetPendingPrologues(func, pending);
+  for (TCA prologue : pending) {
+    smash(prologue);
   }
 }
 
@@ -866,9 +977,11 @@ TranslatorX64::emitFuncGuard(X64Assembler& a, const Func* func) {
 bool
 TranslatorX64::checkCachedPrologue(const Func* func, int paramIdx,
                                    TCA& prologue) const {
-  prologue = (TCA)func->getPrologue(paramIdx);
-  if (prologue != uniqueStubs.fcallHelperThunk &&
-      !s_replaceInFlight) {
+  // A replaced translator's requests don't get prologues: the ones in
+  // Funcs belong to the new space.
+  if (this != nextTx64) return false;
+  prologue = getPrologue(func, paramIdx);
+  if (prologue != uniqueStubs.fcallHelperThunk) {
     TRACE(1, "cached prologue %s(%d) -> cached %p\n",
           func->fullName()->data(), paramIdx, prologue);
     assert(isValidCodeAddress(prologue));
@@ -912,18 +1025,18 @@ TranslatorX64::funcPrologue(Func* func, int nPassed, ActRec* ar) {
     SrcKey funcBody(func, entry);
     TCA tca = getTranslation(TranslArgs(funcBody, false));
     tl_regState = VMRegState::DIRTY;
-    if (tca) {
+    if (tca && this == nextTx64 && !s_replaceInFlight) {
       // racy, but ok...
       func->setPrologue(paramIndex, tca);
     }
     return tca;
   }
 
-  // If the translator is getting replaced out from under us, refuse to
-  // provide a prologue; we don't know whether this request is running on the
-  // old or new context.
+  // If this translator has been replaced, refuse to provide a prologue;
+  // this request interprets the callee instead. The new translator keeps
+  // making prologues while the replace is in flight: see setPrologue().
   LeaseHolder writer(s_writeLease);
-  if (!writer || s_replaceInFlight) return nullptr;
+  if (!writer || this != nextTx64) return nullptr;
   // Double check the prologue array now that we have the write lease
   // in case another thread snuck in and set the prologue already.
   if (checkCachedPrologue(func, paramIndex, prologue)) return prologue;
@@ -1039,7 +1152,7 @@ TranslatorX64::funcPrologue(Func* func, int nPassed, ActRec* ar) {
   TRACE(2, "funcPrologue tx64 %p %s(%d) setting prologue %p\n",
         this, func->fullName()->data(), nPassed, start);
   assert(isValidCodeAddress(start));
-  func->setPrologue(paramIndex, start);
+  setPrologue(func, paramIndex, start);
 
   assert(m_mode == TransPrologue || m_mode == TransProflogue);
   addTranslation(TransRec(skFuncBody, func->unit()->md5(),
@@ -1062,15 +1175,16 @@ TranslatorX64::funcPrologue(Func* func, int nPassed, ActRec* ar) {
  * Given the proflogueTransId for a TransProflogue translation,
  * regenerate the prologue (as a TransPrologue).
  */
-void TranslatorX64::regeneratePrologue(TransID prologueTransId) {
+void TranslatorX64::regeneratePrologue(TransID prologueTransId,
+                                       bool background) {
   Func* func = m_profData->transFunc(prologueTransId);
   int  nArgs = m_profData->prologueArgs(prologueTransId);
 
   // Regenerate the prologue.
-  func->resetPrologue(nArgs);
+  setPrologue(func, nArgs, uniqueStubs.fcallHelperThunk);
   m_mode = TransPrologue;
   TCA start = funcPrologue(func, nArgs);
-  func->setPrologue(nArgs, start);
+  setPrologue(func, nArgs, start);
 
   // Smash callers of the old prologue with the address of the new one.
   JIT::PrologueCallersRec* pcr = m_profData->prologueCallers(prologueTransId);
@@ -1097,8 +1211,10 @@ void TranslatorX64::regeneratePrologue(TransID prologueTransId) {
       SrcKey  funcletSK(func, paramInfo.funcletOff());
       TransID funcletTransId = m_profData->dvFuncletTransId(func, nArgs);
       if (funcletTransId != InvalidID) {
-        invalidateSrcKey(funcletSK);
-        retranslate(TranslArgs(funcletSK, false).transId(funcletTransId));
+        // in the background, translateWork() does this on success
+        if (!background) invalidateSrcKey(funcletSK);
+        retranslate(TranslArgs(funcletSK, false).transId(funcletTransId)
+                                                .background(background));
       }
     }
   }
@@ -1113,12 +1229,12 @@ void TranslatorX64::regeneratePrologue(TransID prologueTransId) {
  * that all prologues are placed right before it, and with the hottest
  * prologues closer to it.
  */
-void TranslatorX64::regeneratePrologues(Func* func) {
+void TranslatorX64::regeneratePrologues(Func* func, bool background) {
   std::vector<TransID> prologTransIDs;
 
   for (int nArgs = 0; nArgs <= func->numParams() + 1; nArgs++) {
     TransID tid = profData()->prologueTransId(func, nArgs);
-    assert(IMPLIES(func->getPrologue(nArgs) != uniqueStubs.fcallHelperThunk,
+    assert(IMPLIES(getPrologue(func, nArgs) != uniqueStubs.fcallHelperThunk,
                    tid != InvalidID));
     if (tid != InvalidID) {
       prologTransIDs.push_back(tid);
@@ -1133,7 +1249,7 @@ void TranslatorX64::regeneratePrologues(Func* func) {
           });
 
   for (TransID tid : prologTransIDs) {
-    regeneratePrologue(tid);
+    regeneratePrologue(tid, background);
   }
 }
 
@@ -1816,7 +1932,8 @@ bool TranslatorX64::handleServiceRequest(TReqInfo& info,
     Offset  offset  = (Offset) args[1];
     TransID transId = (TransID)args[2];
     sk = SrcKey(funcId, offset);
-    start = retranslateOpt(transId, false);
+    start = RuntimeOption::EvalThreadingJit ? queueRetranslateOpt(transId)
+                                            : retranslateOpt(transId, false);
     SKTRACE(2, sk, "retranslated-OPT: transId = %d  start: @%p\n", transId,
             start);
     break;
@@ -2277,14 +2394,24 @@ void dumpTranslationInfo(const Tracelet& t, TCA postGuards) {
   }
 }
 
-void
+/*
+ * Translate args.m_sk and make the translation reachable through its
+ * SrcRec.  Returns false if nothing was published, which only happens
+ * in the background: a JIT worker has no live frame to analyze a
+ * Tracelet from, so it can't fall back on one, or on an interp request
+ * for its instructions, if the region fails.  The profiling
+ * translations it's replacing are only invalidated once the region has
+ * been translated, so sk is left as it was.
+ */
+bool
 TranslatorX64::translateWork(const TranslArgs& args) {
   auto sk = args.m_sk;
-  std::unique_ptr<Tracelet> tp = analyze(sk);
-  Tracelet& t = *tp;
+  std::unique_ptr<Tracelet> tp;
+  if (!args.m_background) tp = analyze(sk);
 
   SKTRACE(1, sk, "translateWork\n");
   assert(m_srcDB.find(sk));
+  assert(!args.m_background || m_mode == TransOptimize);
 
   TCA        start = mainCode.frontier();
   TCA        stubStart = stubsCode.frontier();
@@ -2312,15 +2439,23 @@ TranslatorX64::translateWork(const TranslArgs& args) {
   };
 
   JIT::PostConditions pconds;
+  JIT::RegionDescPtr region;
+  // The old translations don't count towards the limit if they're about
+  // to be thrown away.
+  bool const replace = args.m_background && !m_profData->optimized(sk);
 
-  if (!args.m_interp && !reachedTranslationLimit(sk, srcRec)) {
+  if (!args.m_interp &&
+      (replace || !reachedTranslationLimit(sk, srcRec))) {
     // Attempt to create a region at this SrcKey
-    JIT::RegionDescPtr region;
     if (RuntimeOption::EvalJitPGO) {
       if (m_mode == TransOptimize) {
-        TransID transId = args.m_transId;
-        assert(transId != InvalidID);
-        region = JIT::selectHotRegion(transId, this);
+        if (args.m_region) {
+          region = args.m_region;
+        } else {
+          TransID transId = args.m_transId;
+          assert(transId != InvalidID);
+          region = JIT::selectHotRegion(transId, this);
+        }
         if (region && region->blocks.size() == 0) region = nullptr;
       } else {
         // We always go through the tracelet translator in this case
@@ -2329,15 +2464,16 @@ TranslatorX64::translateWork(const TranslArgs& args) {
       JIT::RegionContext rContext { sk.func(), sk.offset(), liveSpOff() };
       FTRACE(2, "populating live context for region\n");
       populateLiveContext(rContext);
-      region = JIT::selectRegion(rContext, &t);
+      region = JIT::selectRegion(rContext, tp.get());
     }
+    if (args.m_background && !region) return false;
 
     TranslateResult result = Retry;
     RegionBlacklist regionInterps;
     Offset initSpOffset = region ? region->blocks[0]->initialSpOffset()
                                  : liveSpOff();
     while (result == Retry) {
-      traceStart(sk.offset(), initSpOffset);
+      traceStart(sk.offset(), initSpOffset, sk.func());
 
       // Try translating a region if we have one, then fall back to using the
       // Tracelet.
@@ -2353,7 +2489,11 @@ TranslatorX64::translateWork(const TranslArgs& args) {
         }
         if (result == Failure) {
           traceFree();
-          traceStart(sk.offset(), liveSpOff());
+          if (args.m_background) {
+            resetState();
+            break;
+          }
+          traceStart(sk.offset(), liveSpOff(), sk.func());
           resetState();
         }
       }
@@ -2363,7 +2503,7 @@ TranslatorX64::translateWork(const TranslArgs& args) {
         if (m_mode == TransOptimize) {
           m_mode = TransLive;
         }
-        result = translateTracelet(t);
+        result = translateTracelet(*tp);
 
         // If we're profiling, grab the postconditions so we can
         // use them in region selection whenever we decide to
@@ -2389,11 +2529,14 @@ TranslatorX64::translateWork(const TranslArgs& args) {
              m_mode == TransProfile ||
              m_mode == TransOptimize);
       transKind = m_mode;
+      if (transKind == TransOptimize) JIT::recordOptimizedRegion(*region);
     }
   }
 
   if (transKind == TransInterp) {
     assertCleanState();
+    if (args.m_background) return false;
+    Tracelet& t = *tp;
     TRACE(1,
           "emitting %d-instr interp request for failed translation\n",
           int(t.m_numOpcodes));
@@ -2410,22 +2553,33 @@ TranslatorX64::translateWork(const TranslArgs& args) {
 
   m_fixupMap.processPendingFixups();
 
-  addTranslation(TransRec(sk, sk.unit()->md5(), transKind, t, start,
-                          mainCode.frontier() - start, stubStart,
-                          stubsCode.frontier() - stubStart,
-                          counterStart, counterLen,
-                          m_bcMap));
+  if (tp) {
+    addTranslation(TransRec(sk, sk.unit()->md5(), transKind, *tp, start,
+                            mainCode.frontier() - start, stubStart,
+                            stubsCode.frontier() - stubStart,
+                            counterStart, counterLen,
+                            m_bcMap));
+  } else {
+    TransRec tr(sk, sk.unit()->md5(), transKind,
+                start, mainCode.frontier() - start,
+                stubStart, stubsCode.frontier() - stubStart);
+    tr.bcMapping = m_bcMap;
+    addTranslation(tr);
+  }
   m_bcMap.clear();
 
   recordGdbTranslation(sk, sk.func(), mainCode, start,
                        false, false);
   recordGdbTranslation(sk, sk.func(), stubsCode, stubStart,
                        false, false);
-  if (RuntimeOption::EvalJitPGO) {
+  if (!tp) {
+    m_profData->addTransOptimize(sk, *region);
+  } else if (RuntimeOption::EvalJitPGO) {
     JIT::RegionContext rContext { sk.func(), sk.offset(), liveSpOff() };
     populateLiveContext(rContext);
-    m_profData->addTrans(t, rContext, transKind, pconds);
+    m_profData->addTrans(*tp, rContext, transKind, pconds);
   }
+  if (replace) invalidateSrcKey(sk);
   // SrcRec::newTranslation() makes this code reachable. Do this last;
   // otherwise there's some chance of hitting in the reader threads whose
   // metadata is not yet visible.
@@ -2436,6 +2590,7 @@ TranslatorX64::translateWork(const TranslArgs& args) {
   if (Trace::moduleEnabledRelease(Trace::tcspace, 1)) {
     Trace::traceRelease("%s", getUsage().c_str());
   }
+  return true;
 }
 
 TranslatorX64::TranslateResult
@@ -2604,9 +2759,39 @@ void TranslatorX64::traceCodeGen() {
   m_numHHIRTrans++;
 }
 
+/*
+ * A translation space's slab outlives its translator, so replace() can
+ * take turns between two address ranges rather than growing the heap past
+ * 2GiB.
+ */
+static Mutex s_spareSlabLock;
+static uint8_t* s_spareSlab;
+
+static uint8_t* takeSpareSlab() {
+  Lock lock(s_spareSlabLock);
+  uint8_t* slab = s_spareSlab;
+  s_spareSlab = nullptr;
+  return slab;
+}
+
+static void giveSpareSlab(uint8_t* slab, size_t size) {
+  {
+    Lock lock(s_spareSlabLock);
+    if (!s_spareSlab) {
+      s_spareSlab = slab;
+      return;
+    }
+  }
+  // Only at exit, with the reserved slab never used.
+  if (munmap(slab, size) != 0) {
+    perror("freeSlab: munmap");
+  }
+}
+
 TranslatorX64::TranslatorX64()
   : m_numNativeTrampolines(0)
   , m_numHHIRTrans(0)
+  , m_collectRequested(false)
   , m_catchTraceMap(128)
 {
   static const size_t kRoundUp = 2 << 20;
@@ -2659,32 +2844,55 @@ TranslatorX64::TranslatorX64()
   // Using sbrk to ensure its in the bottom 2G, so we avoid
   // the need for trampolines, and get to use shorter
   // instructions for tc addresses.
+  //
+  // Translator::replace() makes a new space while the old one is still in
+  // use, so with Eval.JitTCCollectPercent room for a second slab is
+  // reserved next to the first, and the two take turns; see
+  // ~TranslatorX64().
   size_t allocationSize = m_totalSize;
-  uint8_t* base = (uint8_t*)sbrk(0);
-  if (base != (uint8_t*)-1) {
-    assert(!(allocationSize & (kRoundUp - 1)));
-    // Make sure that we have space to round up to the start
-    // of a huge page
-    allocationSize += -(uint64_t)base & (kRoundUp - 1);
-    base = (uint8_t*)sbrk(allocationSize);
-  }
-  if (base == (uint8_t*)-1) {
-    allocationSize = m_totalSize + kRoundUp - 1;
-    base = (uint8_t*)low_malloc(allocationSize);
-    if (!base) {
-      base = (uint8_t*)malloc(allocationSize);
-    }
-    if (!base) {
-      fprintf(stderr, "could not allocate %zd bytes for translation cache\n",
-              allocationSize);
-      exit(1);
-    }
+  uint8_t* base = takeSpareSlab();
+  if (base) {
+    tcStart = base;
   } else {
-    low_malloc_skip_huge(base, base + allocationSize - 1);
+    size_t numSlabs = RuntimeOption::EvalJitTCCollectPercent ? 2 : 1;
+    base = (uint8_t*)sbrk(0);
+    if (base != (uint8_t*)-1) {
+      if (numSlabs > 1 &&
+          uintptr_t(base) + 2 * m_totalSize + kRoundUp > (2ul << 30)) {
+        fprintf(stderr, "No room below 2GiB for a second translation "
+                        "space; ignoring Eval.JitTCCollectPercent\n");
+        RuntimeOption::EvalJitTCCollectPercent = 0;
+        numSlabs = 1;
+      }
+      allocationSize = numSlabs * m_totalSize;
+      assert(!(allocationSize & (kRoundUp - 1)));
+      // Make sure that we have space to round up to the start
+      // of a huge page
+      allocationSize += -(uint64_t)base & (kRoundUp - 1);
+      base = (uint8_t*)sbrk(allocationSize);
+    }
+    if (base == (uint8_t*)-1) {
+      allocationSize = numSlabs * m_totalSize + kRoundUp - 1;
+      base = (uint8_t*)low_malloc(allocationSize);
+      if (!base) {
+        base = (uint8_t*)malloc(allocationSize);
+      }
+      if (!base) {
+        fprintf(stderr, "could not allocate %zd bytes for translation cache\n",
+                allocationSize);
+        exit(1);
+      }
+    } else {
+      low_malloc_skip_huge(base, base + allocationSize - 1);
+    }
+    assert(base);
+    tcStart = base;
+    base += -(uint64_t)base & (kRoundUp - 1);
+    if (numSlabs > 1) {
+      giveSpareSlab(base + m_totalSize, m_totalSize);
+      allocationSize -= m_totalSize;
+    }
   }
-  assert(base);
-  tcStart = base;
-  base += -(uint64_t)base & (kRoundUp - 1);
 
   m_unwindRegistrar = register_unwind_region(base, m_totalSize - kGDataSize);
 
@@ -2783,7 +2991,8 @@ TranslatorX64::requestExit() {
             Process::GetThreadIdForTrace(), s_writeLease.m_hintKept,
             s_writeLease.m_hintGrabbed);
   PendQ::drain();
-  Treadmill::finishRequest(g_vmContext->m_currentThreadIdx);
+  // Treadmill::finishRequest() waits for hphp_session_exit(): the heap
+  // teardown still reads pinned APC values (SharedVariant::toLocal).
   TRACE(1, "done requestExit(%" PRId64 ")\n", g_vmContext->m_currentThreadIdx);
   Stats::dump();
   Stats::clear();
@@ -2837,10 +3046,12 @@ TranslatorX64::getPerfCounters(Array& ret) {
 }
 
 TranslatorX64::~TranslatorX64() {
-  int result = munmap(trampolinesCode.base(), m_totalSize);
-  if (result != 0) {
-    perror("freeSlab: munmap");
+  // Keep the address range, below 2GiB, for the next replace(); just give
+  // the memory back.
+  if (madvise(trampolinesCode.base(), m_totalSize, MADV_DONTNEED) != 0) {
+    perror("freeSlab: madvise");
   }
+  giveSpareSlab(trampolinesCode.base(), m_totalSize);
 }
 
 static Debug::TCRange rangeFrom(const CodeBlock& cb, const TCA addr,
@@ -2918,7 +3129,8 @@ std::string TranslatorX64::getUsage() {
     "tx64: %9zd bytes (%zd%%) in astubs.code\n"
     "tx64: %9zd bytes (%zd%%) in m_globalData\n"
     "tx64: %9zd bytes (%zd%%) in targetCache\n"
-    "tx64: %9zd bytes (%zd%%) in persistentCache\n",
+    "tx64: %9zd bytes (%zd%%) in persistentCache\n"
+    "tx64: %9u translation space replacements\n",
     aHotUsage,  100 * aHotUsage / hotCode.capacity(),
     aUsage,     100 * aUsage / mainCode.capacity(),
     aProfUsage, (profCode.capacity() != 0
@@ -2928,7 +3140,8 @@ std::string TranslatorX64::getUsage() {
     tcUsage,
     400 * tcUsage / RuntimeOption::EvalJitTargetCacheSize / 3,
     persistentUsage,
-    400 * persistentUsage / RuntimeOption::EvalJitTargetCacheSize);
+    400 * persistentUsage / RuntimeOption::EvalJitTargetCacheSize,
+    Translator::NumReplaces());
   return usage;
 }
 
@@ -162,6 +162,12 @@ private:
   // Data structures for HHIR-based translation
   uint64_t               m_numHHIRTrans;
 
+  // Set once a code region crosses EvalJitTCCollectPercent. No more
+  // translations are made in this space, and the collector thread
+  // replaces it; see requestTCCollection().
+  bool                   m_collectRequested;
+  bool tcNeedsCollection() const;
+
   virtual void traceCodeGen();
 
   FixupMap                   m_fixupMap;
@@ -317,17 +323,28 @@ public:
   bool reachedTranslationLimit(SrcKey, const SrcRec&) const;
   TranslateResult translateTracelet(Tracelet& t);
 
+  /*
+   * Produce the optimized translation for the profiling translation
+   * transId. A JIT worker thread (see jit-workers.h) passes in the
+   * region selected when the work was queued: it waits for the write
+   * lease and doesn't look at any live VM state, and returns nullptr
+   * with the profiling translations untouched if the region can't be
+   * translated.
+   */
+  TCA retranslateOpt(TransID transId, bool align,
+                     JIT::RegionDescPtr region = nullptr);
+
 private:
   TCA getTranslation(const TranslArgs& args);
   TCA createTranslation(const TranslArgs& args);
   TCA retranslate(const TranslArgs& args);
   TCA translate(const TranslArgs& args);
-  void translateWork(const TranslArgs& args);
+  bool translateWork(const TranslArgs& args);
 
   TCA lookupTranslation(SrcKey sk) const;
-  TCA retranslateOpt(TransID transId, bool align);
-  void regeneratePrologues(Func* func);
-  void regeneratePrologue(TransID prologueTransId);
+  TCA queueRetranslateOpt(TransID transId);
+  void regeneratePrologues(Func* func, bool background);
+  void regeneratePrologue(TransID prologueTransId, bool background);
   bool prologuesWereRegenerated(const Func* func);
 
   void recordGdbTranslation(SrcKey sk, const Func* f,
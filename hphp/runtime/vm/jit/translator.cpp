@@ -3703,7 +3703,12 @@ bool instrMustInterp(const NormalizedInstruction& inst) {
   }
 }
 
-void Translator::traceStart(Offset initBcOffset, Offset initSpOffset) {
+/*
+ * func is passed in rather than read off the live frame: optimized
+ * retranslations can run on a JIT worker, which has no VM frame.
+ */
+void Translator::traceStart(Offset initBcOffset, Offset initSpOffset,
+                            const Func* func) {
   assert(!m_irTrans);
 
   FTRACE(1, "{}{:-^40}{}\n",
@@ -3711,8 +3716,7 @@ void Translator::traceStart(Offset initBcOffset, Offset initSpOffset) {
          " HHIR during translation ",
          color(ANSI_COLOR_END));
 
-  m_irTrans.reset(new JIT::IRTranslator(initBcOffset, initSpOffset,
-                                        liveFunc()));
+  m_irTrans.reset(new JIT::IRTranslator(initBcOffset, initSpOffset, func));
 }
 
 void Translator::traceEnd() {
@@ -314,6 +314,7 @@ struct TranslArgs {
       , m_align(align)
       , m_interp(false)
       , m_setFuncBody(false)
+      , m_background(false)
       , m_transId(InvalidID)
     {}
 
@@ -341,13 +342,28 @@ struct TranslArgs {
     m_transId = transId;
     return *this;
   }
+  // Translating on a JIT worker thread: there is no live VM frame to
+  // inspect, so only profiled regions can be translated, and the
+  // translations being replaced stay in place until that succeeds.
+  TranslArgs& background(bool background) {
+    m_background = background;
+    return *this;
+  }
+  // Translate this region instead of selecting one; used for regions
+  // loaded from a persisted PGO profile.
+  TranslArgs& region(JIT::RegionDescPtr region) {
+    m_region = region;
+    return *this;
+  }
 
   SrcKey m_sk;
   TCA m_src;
   bool m_align;
   bool m_interp;
   bool m_setFuncBody;
+  bool m_background;
   TransID m_transId;
+  JIT::RegionDescPtr m_region;
 };
 
 /*
@@ -409,7 +425,8 @@ protected:
     Success
   };
   static const char* translateResultName(TranslateResult r);
-  void traceStart(Offset initBcOffset, Offset initSpOffset);
+  void traceStart(Offset initBcOffset, Offset initSpOffset,
+                  const Func* func);
   virtual void traceCodeGen() = 0;
   void traceEnd();
   void traceFree();
@@ -437,6 +454,7 @@ protected:
 
   static Lease s_writeLease;
   static volatile bool s_replaceInFlight;
+  static uint32_t s_numReplaces;
 
 public:
 
@@ -455,6 +473,9 @@ public:
   static bool ReplaceInFlight() {
     return s_replaceInFlight;
   }
+  static uint32_t NumReplaces() {
+    return s_numReplaces;
+  }
   static RuntimeType outThisObjectType();
 
   /*
@@ -587,8 +608,31 @@ public:
   // Start a new translation space. Returns true IFF this thread created
   // a new space.
   bool replace();
+
+  /*
+   * Func prologue tables and func bodies are read directly by translated
+   * code, so while a replace() is in flight, the ones made in the new
+   * space are kept here instead, out of reach of requests still running
+   * in the old one.  The TxReaper installs them in their Funcs.
+   */
+  static TCA getPrologue(const Func* func, int paramIdx);
+  static void setPrologue(Func* func, int paramIdx, TCA prologue);
+  static TCA getFuncBody(const Func* func);
+  static void setFuncBody(Func* func, TCA funcBody);
+  static void forgetPendingPrologues(const Func* func,
+                                     std::vector<TCA>& prologues);
 };
 
+/*
+ * The thread that replaces a translation space once it is
+ * Eval.JitTCCollectPercent full, at most once every
+ * Eval.JitTCCollectInterval seconds.  requestTCCollection() is called by
+ * the full translator, which stops translating until it is replaced.
+ */
+void startTCCollector();
+void stopTCCollector();
+void requestTCCollection(const TranslatorX64* tx);
+
 int getStackDelta(const NormalizedInstruction& ni);
 int64_t getStackPopped(const NormalizedInstruction&);
 int64_t getStackPushed(const NormalizedInstruction&);
@@ -238,6 +238,15 @@ public:
   static std::string debugString(Type t);
   static Type fromString(const std::string& str);
 
+  /*
+   * The unspecialized type bits, for saving Types outside of the
+   * process (see prof-data-serialize.h).  Bit assignments are only
+   * stable within a single build, so fromRawBits must not be fed
+   * values written by a different binary.
+   */
+  bits_t rawBits() const { return m_bits; }
+  static Type fromRawBits(bits_t bits) { return Type(bits); }
+
   bool isBoxed() const {
     return subtypeOf(BoxedCell);
   }
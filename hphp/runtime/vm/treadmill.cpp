@@ -70,6 +70,8 @@ static GenCount* idToCount(int threadID) {
   return s_inflightRequests + threadID;
 }
 
+static __thread bool tl_inRequest;
+
 typedef std::list<WorkItem*> PendingTriggers;
 static PendingTriggers s_tq;
 
@@ -90,6 +92,7 @@ void startRequest(int threadId) {
   assert(*idToCount(threadId) == kIdleGenCount);
   TRACE(1, "tid %d start @gen %d\n", threadId, int(s_gen));
   *idToCount(threadId) = s_gen;
+  tl_inRequest = true;
 }
 
 void finishRequest(int threadId) {
@@ -99,6 +102,7 @@ void finishRequest(int threadId) {
     GenCountGuard g;
     assert(*idToCount(threadId) != kIdleGenCount);
     *idToCount(threadId) = kIdleGenCount;
+    tl_inRequest = false;
 
     // After finishing a request, check to see if we've allowed any triggers
     // to fire.
@@ -131,6 +135,10 @@ void finishRequest(int threadId) {
   }
 }
 
+bool inRequest() {
+  return tl_inRequest;
+}
+
 FreeMemoryTrigger::FreeMemoryTrigger(void* ptr) : m_ptr(ptr) {
   TRACE(3, "FreeMemoryTrigger @ %p, m_f %p\n", this, m_ptr);
 }
@@ -36,6 +36,13 @@ namespace Treadmill {
 void startRequest(int threadId);
 void finishRequest(int threadId);
 
+/*
+ * Whether the calling thread is between startRequest and finishRequest,
+ * i.e. whether anything it reads now is safe from deferred frees until
+ * it's done.
+ */
+bool inRequest();
+
 /*
  * Ask for memory to be freed (as in free, not delete) by the next
  * appropriate treadmill round.
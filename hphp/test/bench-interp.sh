@@ -0,0 +1,105 @@
+#!/bin/bash
+#
+# Times the interpreter with and without superinstructions
+# (Eval.InterpSuperInstrs) on a test suite, test/quick by default.
+#
+# Example:
+#
+#   ./test/bench-interp.sh
+#   RUNS=5 REPEAT=50 ./test/bench-interp.sh test/vm-perf
+#
+# Each test runs with the JIT off, once per process and REPEAT times per
+# process (--count, default 20), RUNS times each (default 3) in each mode.
+# The fastest of each counts, and the difference between them divided by
+# REPEAT - 1 is the time of one run of the script without process startup.
+# Tests with .in, .opts or .hhas files are skipped. A test whose output
+# differs between the two modes is reported and fails the script. Prints
+# the tests that changed by more than 5% and the total time in each mode.
+
+TEST_DIR=$(dirname $0)
+HHVM=${HHVM_BIN:-$TEST_DIR/../hhvm/hhvm}
+CONFIG=$TEST_DIR/config.hdf
+RUNS=${RUNS:-3}
+REPEAT=${REPEAT:-20}
+SUITE=${1:-$TEST_DIR/quick}
+
+if [ ! -x "$HHVM" ]; then
+  echo "$HHVM doesn't exist. Did you forget to build first?" >&2
+  exit 1
+fi
+if [ $REPEAT -lt 2 ]; then
+  echo "REPEAT must be at least 2" >&2
+  exit 1
+fi
+
+# Runs $1 $3 times in one process with superinstructions set to $2.
+run() {
+  $HHVM --config $CONFIG -vEval.Jit=false \
+    -vEval.InterpSuperInstrs=$2 --count $3 --file "$1"
+}
+
+# Prints the fastest of $RUNS runs of $1 $3 times in one process, with
+# superinstructions set to $2, in microseconds.
+best_process_time() {
+  local best=
+  for i in $(seq $RUNS); do
+    local start=$(date +%s%N)
+    run "$1" $2 $3 > /dev/null 2>&1
+    local t=$(( ($(date +%s%N) - start) / 1000 ))
+    if [ -z "$best" ] || [ $t -lt $best ]; then
+      best=$t
+    fi
+  done
+  echo $best
+}
+
+# Prints the time of one run of $1 with superinstructions set to $2, in
+# microseconds, leaving out process startup.
+script_time() {
+  local once=$(best_process_time "$1" $2 1)
+  local many=$(best_process_time "$1" $2 $REPEAT)
+  local t=$(( (many - once) / (REPEAT - 1) ))
+  [ $t -lt 1 ] && t=1
+  echo $t
+}
+
+total_off=0
+total_on=0
+count=0
+mismatches=0
+for test in $(find $SUITE -name '*.php' | sort); do
+  if [ -e "$test.in" ] || [ -e "$test.opts" ] || [ -e "${test%.php}.hhas" ]
+  then
+    continue
+  fi
+  out_off=$(run "$test" false 1 2>&1)
+  out_on=$(run "$test" true 1 2>&1)
+  if [ "$out_off" != "$out_on" ]; then
+    echo "$test: FAILED, output differs with superinstructions" >&2
+    mismatches=$((mismatches + 1))
+    continue
+  fi
+
+  off=$(script_time "$test" false)
+  on=$(script_time "$test" true)
+  total_off=$((total_off + off))
+  total_on=$((total_on + on))
+  count=$((count + 1))
+  if [ $((on * 100)) -lt $((off * 95)) ] ||
+     [ $((on * 100)) -gt $((off * 105)) ]; then
+    printf "%-60s %8d us %8d us\n" "$test" $off $on
+  fi
+done
+
+if [ $count -gt 0 ]; then
+  printf "%d tests: %d us without superinstructions, %d us with (%d%%)\n" \
+    $count $total_off $total_on $((total_on * 100 / total_off))
+fi
+if [ $mismatches -gt 0 ]; then
+  echo "$mismatches tests had different output with superinstructions" >&2
+  exit 1
+fi
+if [ $count -eq 0 ]; then
+  echo "no tests run"
+  exit 1
+fi
@@ -22,6 +22,9 @@
 #include "hphp/test/ext/test_util.h"
 #include "hphp/test/ext/test_ext.h"
 #include "hphp/test/ext/test_server.h"
+#include "hphp/test/ext/test_apc_store.h"
+#include "hphp/test/ext/test_string_scan.h"
+#include "hphp/test/ext/test_upload.h"
 #include "hphp/compiler/option.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -35,6 +38,18 @@ void Test::RunTestsImpl(bool &allPassed, std::string &suite,
     RUN_TESTSUITE(TestServer);
     return;
   }
+  if (suite == "TestApcStore") {
+    RUN_TESTSUITE(TestApcStore);
+    return;
+  }
+  if (suite == "TestStringScan") {
+    RUN_TESTSUITE(TestStringScan);
+    return;
+  }
+  if (suite == "TestUpload") {
+    RUN_TESTSUITE(TestUpload);
+    return;
+  }
 
   // set based tests with many suites
   if (set == "TestUnit") {
@@ -43,6 +58,9 @@ void Test::RunTestsImpl(bool &allPassed, std::string &suite,
     RUN_TESTSUITE(TestCodeError);
     RUN_TESTSUITE(TestUtil);
     RUN_TESTSUITE(TestCppBase);
+    RUN_TESTSUITE(TestApcStore);
+    RUN_TESTSUITE(TestStringScan);
+    RUN_TESTSUITE(TestUpload);
     return;
   }
   if (set == "TestExt") {
@@ -0,0 +1,329 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/test/ext/test_apc_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "hphp/runtime/base/concurrent-shared-store.h"
+#include "hphp/runtime/base/externals.h"
+#include "hphp/runtime/base/program-functions.h"
+#include "hphp/runtime/ext/ext_apc.h"
+#include "hphp/util/timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int kKeys = 8;
+const int kFetchesPerThread = 1000000;
+
+struct StoreConfig {
+  const char* name;
+  int shardCount;
+  bool lockFreeReads;
+};
+
+const StoreConfig kConfigs[] = {
+  { "single table, locked reads", 1, false },
+  { "16 shards, lock-free reads", 16, true },
+};
+
+void inRequest(std::function<void()> body) {
+  hphp_session_init();
+  ExecutionContext* context = hphp_context_init();
+  body();
+  hphp_context_exit(context, false);
+  hphp_session_exit();
+  hphp_thread_exit();
+}
+
+int benchThreads() {
+  int n = std::thread::hardware_concurrency();
+  return std::max(2, std::min(n, 64));
+}
+
+/*
+ * Each reader thread fetches the kKeys keys round robin; key k always
+ * holds k.  If withWriter, another thread keeps storing the same values
+ * until the readers are done, so every fetch races with replacement of
+ * the value it's reading.  Returns fetches per second, or a negative
+ * number if any fetch returned the wrong thing.
+ */
+double runFetches(const StoreConfig& config, bool withWriter) {
+  apcExtension::ShardCount = config.shardCount;
+  apcExtension::LockFreeReads = config.lockFreeReads;
+  ConcurrentTableSharedStore store(0);
+
+  std::vector<String> keys;
+  for (int k = 0; k < kKeys; ++k) {
+    keys.push_back(String(makeStaticString(
+      "apc_bench_key_" + std::to_string(k))));
+    keys.back()->hash(); // so readers don't race to cache it
+    store.store(keys.back(), Variant(k), 0);
+  }
+
+  std::atomic<int> errors(0);
+  std::atomic<bool> done(false);
+  auto reader = [&] {
+    inRequest([&] {
+      for (int i = 0; i < kFetchesPerThread; ++i) {
+        int k = i % kKeys;
+        Variant v;
+        if (!store.get(keys[k], v) || v.toInt64() != k) {
+          errors.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  };
+  auto writer = [&] {
+    inRequest([&] {
+      for (int i = 0; !done.load(std::memory_order_relaxed); ++i) {
+        int k = i % kKeys;
+        store.store(keys[k], Variant(k), 0);
+      }
+    });
+  };
+
+  int nthreads = benchThreads();
+  std::vector<std::thread> threads;
+  int64_t start = Timer::GetCurrentTimeMicros();
+  for (int i = 0; i < nthreads; ++i) threads.emplace_back(reader);
+  std::thread writerThread;
+  if (withWriter) writerThread = std::thread(writer);
+  for (auto& t : threads) t.join();
+  int64_t elapsed = Timer::GetCurrentTimeMicros() - start;
+  done = true;
+  if (withWriter) writerThread.join();
+
+  if (errors.load()) return -1;
+  double fetches = double(kFetchesPerThread) * nthreads;
+  return fetches * 1000000 / std::max(elapsed, int64_t(1));
+}
+
+bool runBench(const char* name, bool withWriter) {
+  int savedShards = apcExtension::ShardCount;
+  bool savedLockFree = apcExtension::LockFreeReads;
+  bool ok = true;
+  for (auto const& config : kConfigs) {
+    double rate = runFetches(config, withWriter);
+    if (rate < 0) {
+      printf("%s [%s]: wrong values fetched\n", name, config.name);
+      ok = false;
+      continue;
+    }
+    printf("%s [%s]: %d threads, %.2fM fetches/sec\n",
+           name, config.name, benchThreads(), rate / 1000000);
+  }
+  apcExtension::ShardCount = savedShards;
+  apcExtension::LockFreeReads = savedLockFree;
+  return ok;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TestApcStore::TestApcStore() {
+}
+
+bool TestApcStore::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestHotFetch);
+  RUN_TEST(TestHotFetchWithWriter);
+  RUN_TEST(TestMemoryBudget);
+  RUN_TEST(TestShardedMemoryBudget);
+  RUN_TEST(TestPinnedFetch);
+  RUN_TEST(TestPinnedGlobal);
+  return ret;
+}
+
+bool TestApcStore::TestHotFetch() {
+  VERIFY(runBench("hot fetch", false));
+  return Count(true);
+}
+
+bool TestApcStore::TestHotFetchWithWriter() {
+  VERIFY(runBench("hot fetch with writer", true));
+  return Count(true);
+}
+
+bool TestApcStore::TestMemoryBudget() {
+  int savedShards = apcExtension::ShardCount;
+  int64_t savedBudget = apcExtension::MemoryBudget;
+  apcExtension::ShardCount = 1;
+  apcExtension::MemoryBudget = 64 * 1024;
+  bool ok = true;
+  {
+    ConcurrentTableSharedStore store(0);
+    String hot("apc_budget_hot");
+    String filler(std::string(1024, 'x'));
+    store.store(hot, filler, 0);
+    for (int i = 0; i < 1000; ++i) {
+      store.store(String("apc_budget_" + std::to_string(i)), filler, 0);
+      Variant v;
+      // the key fetched between every store must survive the sweeps
+      if (!store.get(hot, v)) ok = false;
+    }
+    if (store.memoryUsed() > apcExtension::MemoryBudget ||
+        store.evictionCount() < 900 ||
+        store.size() != 1000 + 1 - store.evictionCount()) {
+      ok = false;
+    }
+  }
+  apcExtension::ShardCount = savedShards;
+  apcExtension::MemoryBudget = savedBudget;
+  VERIFY(ok);
+  return Count(true);
+}
+
+bool TestApcStore::TestShardedMemoryBudget() {
+  int savedShards = apcExtension::ShardCount;
+  int64_t savedBudget = apcExtension::MemoryBudget;
+  apcExtension::ShardCount = 16;
+  apcExtension::MemoryBudget = 64 * 1024;
+  bool ok = true;
+  {
+    ConcurrentTableSharedStore store(0);
+    String filler(std::string(1024, 'x'));
+    for (int i = 0; i < 2000; ++i) {
+      String key("apc_sharded_" + std::to_string(i));
+      Variant v;
+      if (!store.store(key, filler, 0) || !store.get(key, v)) ok = false;
+    }
+    if (store.memoryUsed() > apcExtension::MemoryBudget ||
+        store.evictionCount() == 0 ||
+        store.size() != 2000 - store.evictionCount()) {
+      ok = false;
+    }
+
+    // bigger than a shard's whole share: everything else in the shard
+    // goes, but the value itself is still there to fetch
+    String big("apc_sharded_big");
+    Variant v;
+    if (!store.store(big, String(std::string(8 * 1024, 'y')), 0) ||
+        !store.get(big, v) || v.toString().size() != 8 * 1024) {
+      ok = false;
+    }
+    store.erase(big);
+    if (store.size() != 2000 - store.evictionCount()) ok = false;
+  }
+  apcExtension::ShardCount = savedShards;
+  apcExtension::MemoryBudget = savedBudget;
+  VERIFY(ok);
+  return Count(true);
+}
+
+bool TestApcStore::TestPinnedFetch() {
+  bool savedLockFree = apcExtension::LockFreeReads;
+  apcExtension::LockFreeReads = true;
+  bool ok = true;
+  {
+    ConcurrentTableSharedStore store(0);
+    String key("apc_pinned");
+    std::string big(1000, 'y');
+    inRequest([&] {
+      Array inner = Array::Create();
+      for (int i = 0; i < 100; ++i) {
+        inner.append(String(big + std::to_string(i)));
+      }
+      Array outer = Array::Create();
+      outer.set(String("list"), inner);
+      outer.set(String("str"), String(big));
+      store.store(key, outer, 0);
+
+      Variant v;
+      if (!store.get(key, v) || !v.isArray() ||
+          !v.getArrayData()->isSharedArray()) {
+        ok = false;
+        return;
+      }
+      // Replacing and erasing the key must not free what this request
+      // is still looking at.
+      store.store(key, Variant(1), 0);
+      store.erase(key);
+      Array list = v[String("list")].toArray();
+      for (int i = 0; i < 100; ++i) {
+        if (!list[i].toString().equal(String(big + std::to_string(i)))) {
+          ok = false;
+        }
+      }
+      if (!v[String("str")].toString().equal(String(big))) ok = false;
+      // copy on write still works on a pinned array
+      list.set(0, 42);
+      if (list[0].toInt64() != 42) ok = false;
+    });
+  }
+  apcExtension::LockFreeReads = savedLockFree;
+  VERIFY(ok);
+  return Count(true);
+}
+
+
+bool TestApcStore::TestPinnedGlobal() {
+  bool savedLockFree = apcExtension::LockFreeReads;
+  apcExtension::LockFreeReads = true;
+  bool ok = true;
+  {
+    ConcurrentTableSharedStore store(0);
+    String key("apc_pinned_global");
+    std::string big(1000, 'z');
+    inRequest([&] {
+      Array arr = Array::Create();
+      for (int i = 0; i < 100; ++i) {
+        arr.append(String(big + std::to_string(i)));
+      }
+      store.store(key, arr, 0);
+    });
+    inRequest([&] {
+      Variant v;
+      if (!store.get(key, v) || !v.isArray() ||
+          !v.getArrayData()->isSharedArray()) {
+        ok = false;
+        return;
+      }
+      // read an element, so the teardown has a local cache to walk
+      if (!v[0].toString().equal(String(big + "0"))) ok = false;
+      get_global_variables()->set(String("apc_pinned"), v, false);
+      v.unset();
+
+      // Another request replaces the key and finishes while this one
+      // still holds the array in a global, which is only released when
+      // this request's globals are torn down.
+      std::thread writer([&] {
+        inRequest([&] {
+          store.store(key, Variant(1), 0);
+          store.erase(key);
+        });
+      });
+      writer.join();
+      Variant held = get_global_variables()->get(String("apc_pinned"));
+      if (!held[99].toString().equal(String(big + "99"))) ok = false;
+    });
+    // a request after it, to run whatever the treadmill freed
+    inRequest([&] {
+      Variant v;
+      if (store.get(key, v)) ok = false;
+    });
+  }
+  apcExtension::LockFreeReads = savedLockFree;
+  VERIFY(ok);
+  return Count(true);
+}
@@ -0,0 +1,54 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_TEST_APC_STORE_H_
+#define incl_HPHP_TEST_APC_STORE_H_
+
+#include "hphp/test/ext/test_base.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Multithreaded microbenchmarks for ConcurrentTableSharedStore. Each one
+ * runs against the single-table, locked-read configuration and the
+ * sharded, lock-free-read one, and prints fetches per second for both.
+ * TestMemoryBudget, TestPinnedFetch and TestPinnedGlobal check
+ * eviction and lifetime rules rather than speed.
+ * Runs in the TestUnit set; "-s TestApcStore" runs it on its own.
+ */
+class TestApcStore : public TestBase {
+ public:
+  TestApcStore();
+
+  virtual bool RunTests(const std::string &which);
+
+  // every thread fetches the same handful of keys
+  bool TestHotFetch();
+  // hot fetches with one thread rewriting the keys
+  bool TestHotFetchWithWriter();
+  // stores past MemoryBudget evict cold keys and keep fetched ones
+  bool TestMemoryBudget();
+  // each shard keeps to its share, and never evicts the key just stored
+  bool TestShardedMemoryBudget();
+  // lock-free fetches wrap the stored value without a reference
+  bool TestPinnedFetch();
+  // a pinned array held in a global outlives a replace by another request
+  bool TestPinnedGlobal();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // incl_HPHP_TEST_APC_STORE_H_
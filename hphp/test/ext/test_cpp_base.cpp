@@ -44,6 +44,8 @@ bool TestCppBase::RunTests(const std::string &which) {
   RUN_TEST(TestObject);
   RUN_TEST(TestVariant);
   RUN_TEST(TestIpBlockMap);
+  RUN_TEST(TestSmartSizeClass);
+  RUN_TEST(TestRequestArena);
   return ret;
 }
 
@@ -827,3 +829,59 @@ bool TestCppBase::TestIpBlockMap() {
 
   return Count(true);
 }
+
+bool TestCppBase::TestSmartSizeClass() {
+  VERIFY(MemoryManager::smartSizeClass(1) == 16);
+  VERIFY(MemoryManager::smartSizeClass(2048) == 2048);
+  VERIFY(MemoryManager::smartSizeClass(2049) == 2560);
+  VERIFY(MemoryManager::smartSizeClass(4097) == 5120);
+  VERIFY(MemoryManager::smartSizeClass(MemoryManager::kMaxSmartSize) ==
+         MemoryManager::kMaxSmartSize);
+
+  // Every size shares a free list exactly with the sizes that round up
+  // to the same class, and the indices are dense.
+  uint32_t prevClass = 0;
+  uint32_t prevIndex = 0;
+  for (uint32_t bytes = 1; bytes <= MemoryManager::kMaxSmartSize; ++bytes) {
+    auto const cls = MemoryManager::smartSizeClass(bytes);
+    auto const idx = MemoryManager::smartSizeIndex(bytes);
+    VERIFY(cls >= bytes && cls % 16 == 0);
+    VERIFY(idx == MemoryManager::smartSizeIndex(cls));
+    if (cls == prevClass) {
+      VERIFY(idx == prevIndex);
+    } else {
+      VERIFY(bytes == 1 || idx == prevIndex + 1);
+      VERIFY(bytes == prevClass + 1);
+    }
+    prevClass = cls;
+    prevIndex = idx;
+  }
+  VERIFY(MemoryManager::smartSizeIndex(1) == 0);
+  VERIFY(prevIndex ==
+         MemoryManager::smartSizeIndex(MemoryManager::kMaxSmartSize));
+  return Count(true);
+}
+
+bool TestCppBase::TestRequestArena() {
+  auto& mm = MM();
+  auto const frees = mm.getArenaFrees();
+  mm.beginArena(1024);
+  VERIFY(mm.inArena());
+
+  // freed blocks aren't handed out again while the arena is open
+  void* p = mm.smartMallocSize(64);
+  mm.smartFreeSize(p, 64);
+  void* q = mm.smartMallocSize(64);
+  VERIFY(q != p);
+  VERIFY(mm.getArenaFrees() == frees + 1);
+
+  // past the dead byte budget, frees recycle memory again
+  for (int i = 0; i < 16; ++i) {
+    mm.smartFreeSize(mm.smartMallocSize(64), 64);
+  }
+  VERIFY(!mm.inArena());
+  mm.smartFreeSize(q, 64);
+  VERIFY(mm.smartMallocSize(64) == q);
+  mm.smartFreeSize(q, 64);
+  return Count(true);
+}
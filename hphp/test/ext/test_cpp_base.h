@@ -39,6 +39,8 @@ class TestCppBase : public TestBase {
 
   // building blocks
   bool TestIpBlockMap();
+  bool TestSmartSizeClass();
+  bool TestRequestArena();
 
   /**
    * Date types. This in turn tests StringData, ArrayData, String,
@@ -29,6 +29,7 @@
 #include "hphp/runtime/base/http-client.h"
 #include "hphp/runtime/base/runtime-option.h"
 #include "hphp/runtime/server/libevent-server.h"
+#include "hphp/runtime/server/access-log.h"
 
 #include <memory>
 
@@ -225,6 +226,8 @@ bool TestServer::RunTests(const std::string &which) {
   RUN_TEST(TestCookie);
   RUN_TEST(TestResponseHeader);
   RUN_TEST(TestSetCookie);
+  RUN_TEST(TestStaticContent);
+  RUN_TEST(TestAccessLog);
   //RUN_TEST(TestRequestHandling);
   RUN_TEST(TestHttpClient);
   RUN_TEST(TestRPCServer);
@@ -392,6 +395,65 @@ bool TestServer::TestSetCookie() {
   return true;
 }
 
+bool TestServer::TestStaticContent() {
+  // The first request writes the files the others fetch; the same url
+  // is fetched once per part of the response it checks.
+  const char *input =
+    "<?php file_put_contents(__DIR__.'/static.txt', '0123456789');"
+    " file_put_contents(__DIR__.'/static.txt.gz', gzencode('0123456789'));"
+    " echo 'ok';";
+  const char *urls[4] = { "string", "static.txt", "static.txt", "static.txt" };
+  bool passed = true;
+
+  const char *whole[4] = {
+    "ok", "HTTP/1.1 200", "Vary: Accept-Encoding", "\r\n\r\n0123456789"
+  };
+  passed = passed && Count(VerifyServerResponse(input, whole, urls, 4, "GET",
+                                                nullptr, nullptr, true,
+                                                __FILE__, __LINE__));
+
+  const char *range[4] = {
+    "ok", "HTTP/1.1 206", "Content-Range: bytes 2-5/10", "\r\n\r\n2345"
+  };
+  passed = passed && Count(VerifyServerResponse(input, range, urls, 4, "GET",
+                                                "Range: bytes=2-5", nullptr,
+                                                true, __FILE__, __LINE__));
+
+  const char *suffix[4] = {
+    "ok", "HTTP/1.1 206", "Content-Range: bytes 7-9/10", "\r\n\r\n789"
+  };
+  passed = passed && Count(VerifyServerResponse(input, suffix, urls, 4, "GET",
+                                                "Range: bytes=-3", nullptr,
+                                                true, __FILE__, __LINE__));
+
+  const char *unsatisfiable[3] = {
+    "ok", "HTTP/1.1 416", "Content-Range: bytes */10"
+  };
+  passed = passed && Count(VerifyServerResponse(input, unsatisfiable, urls, 3,
+                                                "GET", "Range: bytes=20-",
+                                                nullptr, true,
+                                                __FILE__, __LINE__));
+
+  const char *notModified[3] = { "ok", "HTTP/1.1 304", "ETag: " };
+  passed = passed && Count(VerifyServerResponse(input, notModified, urls, 3,
+                                                "GET", "If-None-Match: *",
+                                                nullptr, true,
+                                                __FILE__, __LINE__));
+
+  // Server.StaticContentGzipSidecar is on in config-server.hdf
+  const char *gzip[4] = {
+    "ok", "HTTP/1.1 200", "Content-Encoding: gzip", "-gzip\"\r\n"
+  };
+  passed = passed && Count(VerifyServerResponse(input, gzip, urls, 4, "GET",
+                                                "Accept-Encoding: gzip",
+                                                nullptr, true,
+                                                __FILE__, __LINE__));
+
+  unlink("runtime/tmp/static.txt");
+  unlink("runtime/tmp/static.txt.gz");
+  return passed;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 
 class TestTransport : public Transport {
@@ -465,6 +527,77 @@ bool TestServer::TestRequestHandling() {
   return Count(true);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+
+class AccessLogTransport : public TestTransport {
+public:
+  virtual std::string getHeader(const char *name) {
+    return strcasecmp(name, "X-Test") == 0 ? "hdr" : "";
+  }
+};
+
+static AccessLog::ThreadData s_accessLogData;
+static AccessLog::ThreadData *get_access_log_data() {
+  return &s_accessLogData;
+}
+
+/**
+ * The line an access log with the given format writes for a request
+ * answered with code and a 5 byte body, without its newline.
+ */
+static std::string render_access_log(const char *format, int code) {
+  const char *path = "runtime/tmp/access.log";
+  unlink(path);
+
+  AccessLogTransport transport;
+  transport.disableCompression();
+  transport.sendRaw((void*)"hello", 5, code);
+
+  AccessLog log(get_access_log_data);
+  log.init(format, "", "", "");
+  if (!log.setThreadLog(path)) return "<unable to open access log>";
+  log.log(&transport, nullptr);
+  log.clearThreadLog();
+
+  std::ifstream f(path);
+  std::string line;
+  std::getline(f, line);
+  unlink(path);
+  return line;
+}
+
+bool TestServer::TestAccessLog() {
+  // %200,304x only logs x for those codes, "-" otherwise
+  VS(String(render_access_log("%200,304{X-Test}i %{X-Test}i", 200)),
+     "hdr hdr");
+  VS(String(render_access_log("%200,304{X-Test}i %{X-Test}i", 304)),
+     "hdr hdr");
+  VS(String(render_access_log("%200,304{X-Test}i %{X-Test}i", 404)),
+     "- hdr");
+  VS(String(render_access_log("%{X-Missing}i", 200)), "-");
+
+  // %!404b logs b for every code but 404
+  VS(String(render_access_log("%!404b %b %B", 200)), "5 5 5");
+  VS(String(render_access_log("%!404b %b %B", 404)), "- 5 5");
+
+  VS(String(render_access_log("100%% %s%%", 200)), "100% 200%");
+  VS(String(render_access_log("%s%", 200)), "200-");
+
+  char year[8];
+  time_t now = time(nullptr);
+  struct tm tm;
+  strftime(year, sizeof(year), "%Y", localtime_r(&now, &tm));
+  VS(String(render_access_log("%{%Y}t", 200)), year);
+
+  // [16/Oct/2013:12:00:00 -0700]
+  std::string t = render_access_log("%t", 200);
+  VS((int)t.size(), 28);
+  VERIFY(t[0] == '[' && t[27] == ']');
+  VERIFY(t.find(std::string("/") + year + ":") == 7);
+
+  return Count(true);
+}
+
 bool TestServer::TestLibeventServer() {
   s_server_port = find_server_port(PORT_MIN, PORT_MAX);
   return Count(true);
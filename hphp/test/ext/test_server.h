@@ -46,6 +46,12 @@ public:
   bool TestResponseHeader();
   bool TestSetCookie();
 
+  // test static files served from disk
+  bool TestStaticContent();
+
+  // test rendering access log formats
+  bool TestAccessLog();
+
   // test multithreaded request processing
   bool TestRequestHandling();
   bool TestLibeventServer();
@@ -0,0 +1,215 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/test/ext/test_string_scan.h"
+
+#include <algorithm>
+#include <clocale>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "hphp/runtime/ext/ext_string.h"
+#include "hphp/util/string-scan.h"
+#include "hphp/util/timer.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int kPasses = 2000;
+
+/*
+ * Strings shaped like what templates hand to htmlspecialchars: mostly
+ * short, mostly plain text, with the odd tag, quote or non-ASCII byte.
+ */
+std::vector<std::string> makeCorpus() {
+  static const char* const kPieces[] = {
+    "Hello world", "profile_name", " and ", "<b>", "&amp;", "\"quoted\"",
+    "it's", "Caf\xc3\xa9", "http://www.example.com/path?x=1", "MixedCase",
+    "\\", "lorem ipsum dolor sit amet consectetur adipiscing elit",
+  };
+  const int kNumPieces = sizeof(kPieces) / sizeof(kPieces[0]);
+  std::vector<std::string> corpus;
+  unsigned seed = 1;
+  for (int i = 0; i < 1000; ++i) {
+    std::string s;
+    int pieces = 1 + i % 16;
+    for (int j = 0; j < pieces; ++j) {
+      seed = seed * 1103515245 + 12345;
+      // three times out of four, stick to plain lower-case text
+      int k = (seed >> 16) % (kNumPieces * 4);
+      s += kPieces[k < kNumPieces ? k : (k % 2 ? 2 : kNumPieces - 1)];
+    }
+    corpus.push_back(s);
+  }
+  return corpus;
+}
+
+size_t corpusBytes(const std::vector<std::string>& corpus) {
+  size_t n = 0;
+  for (auto const& s : corpus) n += s.size();
+  return n;
+}
+
+/*
+ * Run fn over the corpus kPasses times and print its throughput.
+ */
+void bench(const char* name, const char* impl,
+           const std::vector<std::string>& corpus,
+           std::function<size_t(const std::string&)> fn) {
+  size_t sink = 0;
+  int64_t start = Timer::GetCurrentTimeMicros();
+  for (int pass = 0; pass < kPasses; ++pass) {
+    for (auto const& s : corpus) sink += fn(s);
+  }
+  int64_t elapsed = std::max(Timer::GetCurrentTimeMicros() - start,
+                             int64_t(1));
+  double bytes = double(corpusBytes(corpus)) * kPasses;
+  printf("%s [%s]: %.1f MB/sec (%zu)\n",
+         name, impl, bytes / elapsed, sink);
+}
+
+const char kHtmlSet[] = { '<', '>', '&', '"', '\'' };
+const char kSlashesSet[] = { '\0', '\\', '"', '\'' };
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TestStringScan::TestStringScan() {
+}
+
+bool TestStringScan::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestScanAny);
+  RUN_TEST(TestCase);
+  RUN_TEST(TestCaseLocale);
+  RUN_TEST(TestUnchangedInput);
+  return ret;
+}
+
+bool TestStringScan::TestScanAny() {
+  auto const corpus = makeCorpus();
+  bool ok = true;
+  for (auto const& s : corpus) {
+    // every suffix, so the tail handling sees every length
+    for (size_t i = 0; i <= s.size(); ++i) {
+      for (auto set : { std::make_pair(kHtmlSet, sizeof kHtmlSet),
+                        std::make_pair(kSlashesSet, sizeof kSlashesSet) }) {
+        if (string_scan_any(s.data() + i, s.size() - i,
+                            set.first, set.second) !=
+            string_scan_scalar::string_scan_any(s.data() + i, s.size() - i,
+                                                set.first, set.second)) {
+          ok = false;
+        }
+      }
+    }
+  }
+  VERIFY(ok);
+
+  bench("scan html", "scalar", corpus, [] (const std::string& s) {
+    return string_scan_scalar::string_scan_any(s.data(), s.size(),
+                                               kHtmlSet, sizeof kHtmlSet);
+  });
+  bench("scan html", "vector", corpus, [] (const std::string& s) {
+    return string_scan_any(s.data(), s.size(), kHtmlSet, sizeof kHtmlSet);
+  });
+  bench("htmlspecialchars", "scan+copy", corpus, [] (const std::string& s) {
+    return f_htmlspecialchars(String(s)).size();
+  });
+  return Count(true);
+}
+
+bool TestStringScan::TestCase() {
+  auto const corpus = makeCorpus();
+  bool ok = true;
+  for (auto const& s : corpus) {
+    for (auto conv : { CaseConv::Lower, CaseConv::Upper }) {
+      for (size_t i = 0; i <= s.size(); ++i) {
+        if (string_scan_case(s.data() + i, s.size() - i, conv) !=
+            string_scan_scalar::string_scan_case(s.data() + i, s.size() - i,
+                                                 conv)) {
+          ok = false;
+        }
+      }
+      std::string vec(s), scalar(s);
+      string_convert_case(&vec[0], vec.data(), vec.size(), conv);
+      string_scan_scalar::string_convert_case(&scalar[0], scalar.data(),
+                                              scalar.size(), conv);
+      if (vec != scalar) ok = false;
+    }
+  }
+  VERIFY(ok);
+
+  std::vector<char> buf(std::max_element(
+    corpus.begin(), corpus.end(),
+    [] (const std::string& a, const std::string& b) {
+      return a.size() < b.size();
+    })->size());
+  bench("strtolower", "scalar", corpus, [&] (const std::string& s) {
+    string_scan_scalar::string_convert_case(&buf[0], s.data(), s.size(),
+                                            CaseConv::Lower);
+    return size_t(buf[0]);
+  });
+  bench("strtolower", "vector", corpus, [&] (const std::string& s) {
+    string_convert_case(&buf[0], s.data(), s.size(), CaseConv::Lower);
+    return size_t(buf[0]);
+  });
+  return Count(true);
+}
+
+bool TestStringScan::TestCaseLocale() {
+  // Locales that map ASCII or Latin-1 letters differently from C; any
+  // that aren't installed are skipped.
+  static const char* const kLocales[] = {
+    "tr_TR.ISO-8859-9", "de_DE.ISO-8859-1",
+  };
+  std::string const s =
+    "TITLE IN THE CAPITAL OF \xc4\xd6\xdc, istanbul in the east \xe4";
+  bool ok = true;
+  for (auto const locale : kLocales) {
+    if (!setlocale(LC_CTYPE, locale)) continue;
+    for (auto conv : { CaseConv::Lower, CaseConv::Upper }) {
+      std::string vec(s), scalar(s);
+      string_convert_case(&vec[0], vec.data(), vec.size(), conv);
+      string_scan_scalar::string_convert_case(&scalar[0], scalar.data(),
+                                              scalar.size(), conv);
+      if (vec != scalar) ok = false;
+      if (string_scan_case(s.data(), s.size(), conv) !=
+          string_scan_scalar::string_scan_case(s.data(), s.size(), conv)) {
+        ok = false;
+      }
+    }
+  }
+  setlocale(LC_CTYPE, "C");
+  VERIFY(ok);
+  return Count(true);
+}
+
+bool TestStringScan::TestUnchangedInput() {
+  String plain("nothing to see here, move along");
+  String padded("  padded  ");
+  VERIFY(f_htmlspecialchars(plain).get() == plain.get());
+  VERIFY(f_addslashes(plain).get() == plain.get());
+  VERIFY(f_strtolower(plain).get() == plain.get());
+  VERIFY(f_trim(plain).get() == plain.get());
+  VS(f_htmlspecialchars("a<b & \"c\""), "a&lt;b &amp; &quot;c&quot;");
+  VS(f_addslashes(String("a'b\\c\0d", 7, CopyString)), "a\\'b\\\\c\\0d");
+  VS(f_strtolower("MiXeD \xc3\x89 CaSe"), "mixed \xc3\x89 case");
+  VS(f_trim(padded), "padded");
+  return Count(true);
+}
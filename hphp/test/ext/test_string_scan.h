@@ -0,0 +1,50 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_TEST_STRING_SCAN_H_
+#define incl_HPHP_TEST_STRING_SCAN_H_
+
+#include "hphp/test/ext/test_base.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Microbenchmarks for the vectorized string kernels in
+ * hphp/util/string-scan.h. Each one checks that the vector and scalar
+ * versions agree on a corpus of HTML-ish text, then prints MB/sec for
+ * both. TestUnchangedInput checks that functions with nothing to do hand
+ * back their input rather than a copy.
+ * Runs in the TestUnit set; "-s TestStringScan" runs it on its own.
+ */
+class TestStringScan : public TestBase {
+ public:
+  TestStringScan();
+
+  virtual bool RunTests(const std::string &which);
+
+  // the htmlspecialchars / addslashes scan
+  bool TestScanAny();
+  // strtolower's scan and conversion
+  bool TestCase();
+  // strtolower follows the locale's case mapping, not just ASCII's
+  bool TestCaseLocale();
+  // htmlspecialchars, addslashes, strtolower and trim return their input
+  bool TestUnchangedInput();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // incl_HPHP_TEST_STRING_SCAN_H_
@@ -0,0 +1,297 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/test/ext/test_upload.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "hphp/runtime/base/program-functions.h"
+#include "hphp/runtime/base/runtime-option.h"
+#include "hphp/runtime/server/transport.h"
+#include "hphp/runtime/server/upload.h"
+#include "hphp/util/util.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const char *kBoundary = "----b0undary";
+
+/*
+ * Hands out a request body in the chunks it was given: the first from
+ * getPostData(), the rest from getMorePostData(). Like LibEventTransport,
+ * a chunk stays valid only until the next one is asked for.
+ */
+class ChunkedTransport : public Transport {
+public:
+  explicit ChunkedTransport(const std::vector<std::string> &chunks)
+    : m_chunks(chunks), m_next(1) {}
+
+  virtual const char *getUrl() { return "/upload.php"; }
+  virtual const char *getRemoteHost() { return "127.0.0.1"; }
+  virtual uint16_t getRemotePort() { return 0; }
+  virtual const void *getPostData(int &size) {
+    size = m_chunks[0].size();
+    return m_chunks[0].data();
+  }
+  virtual bool hasMorePostData() { return m_next < m_chunks.size(); }
+  virtual const void *getMorePostData(int &size) {
+    if (m_next == m_chunks.size()) {
+      size = 0;
+      return nullptr;
+    }
+    // overwrite the previous chunk, so anything still pointing at it
+    // reads garbage
+    std::fill(m_current.begin(), m_current.end(), '#');
+    m_current = m_chunks[m_next++];
+    size = m_current.size();
+    return m_current.data();
+  }
+  virtual Method getMethod() { return Transport::Method::POST; }
+  virtual std::string getHeader(const char *name) { return ""; }
+  virtual void getHeaders(HeaderMap &headers) {}
+  virtual void addHeaderImpl(const char *name, const char *value) {}
+  virtual void removeHeaderImpl(const char *name) {}
+  virtual void sendImpl(const void *data, int size, int code,
+                        bool chunked) {}
+
+private:
+  std::vector<std::string> m_chunks;
+  size_t m_next;
+  std::string m_current;
+};
+
+std::string makeBody(const std::string &field, const std::string &file) {
+  std::string b = std::string("--") + kBoundary;
+  return b + "\r\n"
+    "Content-Disposition: form-data; name=\"field\"\r\n\r\n" +
+    field + "\r\n" +
+    b + "\r\n"
+    "Content-Disposition: form-data; name=\"f\"; filename=\"a.bin\"\r\n"
+    "Content-Type: application/octet-stream\r\n\r\n" +
+    file + "\r\n" +
+    b + "--\r\n";
+}
+
+std::vector<std::string> splitAt(const std::string &body,
+                                 const std::vector<size_t> &cuts) {
+  std::vector<std::string> chunks;
+  size_t pos = 0;
+  for (size_t cut : cuts) {
+    if (cut <= pos || cut >= body.size()) continue;
+    chunks.push_back(body.substr(pos, cut - pos));
+    pos = cut;
+  }
+  chunks.push_back(body.substr(pos));
+  return chunks;
+}
+
+struct UploadResult {
+  std::string field;
+  std::string file;
+  int error;
+  std::string raw;      // what came back as raw post data
+  bool rawBorrowed;     // whether that was a fresh, empty buffer
+};
+
+/*
+ * Runs rfc1867PostHandler on the chunks the way HttpProtocol does, and
+ * reads back what it produced before the request ends and deletes the
+ * uploaded file.
+ */
+UploadResult runUpload(const std::vector<std::string> &chunks) {
+  UploadResult result;
+  result.error = -1;
+  result.rawBorrowed = false;
+
+  hphp_session_init();
+  ExecutionContext* context = hphp_context_init();
+  {
+    ChunkedTransport transport(chunks);
+    int size = 0;
+    const void *data = transport.getPostData(size);
+    const void *original = data;
+    bool needDelete = false;
+    if (transport.hasMorePostData()) {
+      needDelete = true;
+      data = Util::buffer_duplicate(data, size);
+      original = data;
+    }
+    int contentLength = 0;
+    for (auto const& c : chunks) contentLength += c.size();
+
+    Variant post, files;
+    rfc1867PostHandler(&transport, post, files, contentLength,
+                       data, size, kBoundary);
+
+    result.raw = std::string((const char *)data, size);
+    result.rawBorrowed = needDelete && data != original;
+    if (needDelete) free((void *)data);
+
+    result.field = post[String("field")].toString().data();
+    Variant f = files[String("f")];
+    result.error = f[String("error")].toInt32();
+    std::ifstream in(f[String("tmp_name")].toString().data(),
+                     std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    result.file = ss.str();
+  }
+  hphp_context_exit(context, false);
+  hphp_session_exit();
+  return result;
+}
+
+struct OptionSaver {
+  OptionSaver()
+    : m_populate(RuntimeOption::AlwaysPopulateRawPostData)
+    , m_keep(RuntimeOption::UploadKeepRawPostData)
+    , m_enable(RuntimeOption::EnableFileUploads)
+    , m_tmpDir(RuntimeOption::UploadTmpDir) {
+    RuntimeOption::EnableFileUploads = true;
+    RuntimeOption::UploadTmpDir = "/tmp";
+  }
+  ~OptionSaver() {
+    RuntimeOption::AlwaysPopulateRawPostData = m_populate;
+    RuntimeOption::UploadKeepRawPostData = m_keep;
+    RuntimeOption::EnableFileUploads = m_enable;
+    RuntimeOption::UploadTmpDir = m_tmpDir;
+  }
+
+private:
+  bool m_populate;
+  bool m_keep;
+  bool m_enable;
+  std::string m_tmpDir;
+};
+
+/*
+ * Splits the body in two at every position from begin to end, and in
+ * three with the second chunk one byte long, and checks every upload.
+ */
+bool checkSplits(const std::string &field, const std::string &file,
+                 size_t begin, size_t end) {
+  std::string body = makeBody(field, file);
+  if (end > body.size()) end = body.size();
+  for (size_t cut = begin; cut < end; ++cut) {
+    for (int shape = 0; shape < 2; ++shape) {
+      std::vector<size_t> cuts = { cut };
+      if (shape) cuts.push_back(cut + 1);
+      UploadResult r = runUpload(splitAt(body, cuts));
+      if (r.field != field || r.file != file || r.error != 0) {
+        printf("split at %zu%s: field [%s] error %d, file of %zu bytes "
+               "(expected %zu)\n", cut, shape ? " (1 byte chunk)" : "",
+               r.field.c_str(), r.error, r.file.size(), file.size());
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TestUpload::TestUpload() {
+}
+
+bool TestUpload::RunTests(const std::string &which) {
+  bool ret = true;
+  RUN_TEST(TestBoundarySplit);
+  RUN_TEST(TestFileDataSplit);
+  RUN_TEST(TestSingleChunk);
+  RUN_TEST(TestRawPostData);
+  return ret;
+}
+
+bool TestUpload::TestBoundarySplit() {
+  OptionSaver saver;
+  RuntimeOption::UploadKeepRawPostData = false;
+  std::string file(3000, 'x');
+  std::string body = makeBody("value", file);
+  // everything from the end of the file data to the end of the body
+  size_t fileEnd = body.find(file) + file.size();
+  VERIFY(checkSplits("value", file, fileEnd - 2, body.size()));
+  return Count(true);
+}
+
+bool TestUpload::TestFileDataSplit() {
+  OptionSaver saver;
+  RuntimeOption::UploadKeepRawPostData = false;
+  // things that look like the start of a boundary but aren't
+  std::string file = std::string("ab\r\rcd\r\n\ref\r\n-gh\r\n--ij\r\n--") +
+    (kBoundary + 1) + "x\r\n" + std::string(100, 'k') + "\r";
+  std::string body = makeBody("value", file);
+  size_t fileStart = body.find(file);
+  VERIFY(checkSplits("value", file, fileStart, fileStart + file.size()));
+
+  RuntimeOption::UploadKeepRawPostData = true;
+  VERIFY(checkSplits("value", file, fileStart, fileStart + file.size()));
+  return Count(true);
+}
+
+bool TestUpload::TestSingleChunk() {
+  OptionSaver saver;
+  RuntimeOption::AlwaysPopulateRawPostData = true;
+  RuntimeOption::UploadKeepRawPostData = false;
+  std::string body = makeBody("value", "contents");
+  UploadResult r = runUpload(std::vector<std::string>(1, body));
+  VS(r.field, "value");
+  VS(r.file, "contents");
+  VS(r.error, 0);
+  // nothing was streamed, so the body is still there as it came
+  VS(r.raw, body);
+  VERIFY(!r.rawBorrowed);
+  return Count(true);
+}
+
+bool TestUpload::TestRawPostData() {
+  OptionSaver saver;
+  std::string file(10000, 'z');
+  std::string body = makeBody("value", file);
+  std::vector<size_t> cuts;
+  for (size_t cut = 1000; cut < body.size(); cut += 1000) {
+    cuts.push_back(cut);
+  }
+  auto chunks = splitAt(body, cuts);
+
+  // the whole body is kept for $HTTP_RAW_POST_DATA
+  RuntimeOption::AlwaysPopulateRawPostData = true;
+  RuntimeOption::UploadKeepRawPostData = true;
+  UploadResult kept = runUpload(chunks);
+  VS(kept.file, file);
+  VS(kept.raw, body);
+
+  // only the chunk being parsed is held; the caller gets back an empty
+  // buffer of its own to free
+  RuntimeOption::UploadKeepRawPostData = false;
+  UploadResult dropped = runUpload(chunks);
+  VS(dropped.file, file);
+  VS(dropped.field, "value");
+  VS(dropped.raw, "");
+  VERIFY(dropped.rawBorrowed);
+
+  RuntimeOption::AlwaysPopulateRawPostData = false;
+  UploadResult notPopulated = runUpload(chunks);
+  VS(notPopulated.file, file);
+  VS(notPopulated.raw, "");
+  return Count(true);
+}
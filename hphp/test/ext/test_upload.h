@@ -0,0 +1,47 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_TEST_UPLOAD_H_
+#define incl_HPHP_TEST_UPLOAD_H_
+
+#include "hphp/test/ext/test_base.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Feeds multipart/form-data bodies to rfc1867PostHandler in chunks, the
+ * way a transport with RequestBodyReadLimit set hands them over, and checks
+ * what ends up in $_POST, $_FILES and the uploaded files.
+ */
+class TestUpload : public TestBase {
+ public:
+  TestUpload();
+
+  virtual bool RunTests(const std::string &which);
+
+  // the CRLF and boundary after a file part split at every position
+  bool TestBoundarySplit();
+  // CRs, LFs and dashes in file data, with a chunk ending on each of them
+  bool TestFileDataSplit();
+  // the whole body in one chunk, which is never handed back borrowed
+  bool TestSingleChunk();
+  // what comes back as raw post data with and without KeepRawPostData
+  bool TestRawPostData();
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif // incl_HPHP_TEST_UPLOAD_H_
@@ -0,0 +1,43 @@
+<?php
+
+// With JitPGOLoopUnroll=3 the optimized translation of a hot loop holds
+// three copies of its body. The trip counts below aren't all multiples
+// of three, so the loop has to leave from each copy, and every result
+// depends on each iteration running exactly once.
+
+function count_up($n) {
+  $s = 0;
+  $i = 0;
+  while ($i < $n) {
+    $s = ($s * 31 + $i) % 1000003;
+    $i++;
+  }
+  return $s;
+}
+
+// $x turns into a double partway through, so the guards in the later
+// copies of the body fail for some trip counts and not others.
+function widen($n) {
+  $x = 1;
+  for ($i = 0; $i < $n; $i++) {
+    $x *= 1000;
+  }
+  return $x;
+}
+
+$total = 0;
+for ($round = 0; $round < 200; $round++) {
+  $total += count_up($round % 11);
+  widen($round % 5);
+}
+var_dump($total);
+
+for ($n = 0; $n < 10; $n++) {
+  var_dump(count_up($n));
+}
+
+$kinds = '';
+for ($n = 0; $n < 10; $n++) {
+  $kinds .= is_int(widen($n)) ? 'i' : 'f';
+}
+var_dump($kinds);
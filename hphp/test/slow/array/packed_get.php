@@ -0,0 +1,61 @@
+<?php
+
+// Reads of packed arrays with int keys: in-bounds keys are loaded inline
+// by the JIT, everything else goes to the helper and raises a notice.
+
+function get($a, $i) {
+  return $a[$i];
+}
+
+function get_consts($a) {
+  var_dump($a[0]);
+  var_dump($a[2]);
+  var_dump($a[3]);
+  var_dump($a[-1]);
+  // past the largest key the JIT will inline
+  var_dump($a[16777216]);
+  var_dump($a[PHP_INT_MAX]);
+}
+
+function mixed_copy($a) {
+  $m = array('x' => 0);
+  foreach ($a as $k => $v) $m[$k] = $v;
+  unset($m['x']);
+  return $m;
+}
+
+function main() {
+  $a = array(10, 2.5, 'str');
+  $keys = array(0, 1, 2, 3, -1, 100, PHP_INT_MAX, -PHP_INT_MAX - 1);
+
+  // twice, so the second round runs the translated code
+  for ($n = 0; $n < 2; $n++) {
+    echo "-- packed $n\n";
+    foreach ($keys as $i) var_dump(get($a, $i));
+    get_consts($a);
+  }
+
+  echo "-- mixed\n";
+  $m = mixed_copy($a);
+  foreach ($keys as $i) var_dump(get($m, $i));
+
+  echo "-- empty\n";
+  var_dump(get(array(), 0));
+
+  echo "-- ref\n";
+  $r = array(1, 2);
+  $x =& $r[1];
+  $x = 20;
+  var_dump(get($r, 1));
+  $y = get($r, 1);
+  $y = 30;
+  var_dump($r[1]);
+
+  echo "-- loop\n";
+  $sum = 0;
+  $v = range(1, 100);
+  for ($i = 0; $i < count($v); $i++) $sum += $v[$i];
+  var_dump($sum);
+}
+
+main();
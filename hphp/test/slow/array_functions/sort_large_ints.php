@@ -0,0 +1,54 @@
+<?php
+
+// Large int arrays take the radix sort paths; check them against usort().
+
+function check($name, $got, $want) {
+  echo $name, ': ', ($got === $want ? 'ok' : 'FAILED'), "\n";
+}
+
+mt_srand(42);
+$vals = array();
+for ($i = 0; $i < 5000; $i++) {
+  $vals[] = mt_rand(-1000000, 1000000);
+}
+$vals[] = PHP_INT_MAX;
+$vals[] = -PHP_INT_MAX - 1;
+$vals[] = 0;
+
+$a = $vals;
+sort($a);
+$want = $vals;
+usort($want, function ($x, $y) { return $x < $y ? -1 : ($x > $y ? 1 : 0); });
+check('sort', $a, $want);
+
+$a = $vals;
+rsort($a);
+check('rsort', $a, array_reverse($want));
+
+$a[] = 'appended';
+check('append after sort', $a[count($vals)], 'appended');
+
+$h = array();
+foreach ($vals as $i => $v) {
+  $h[$v] = $i;
+}
+$a = $h;
+ksort($a);
+$want = $h;
+uksort($want, function ($x, $y) { return $x < $y ? -1 : ($x > $y ? 1 : 0); });
+check('ksort', $a, $want);
+
+$a = $h;
+krsort($a);
+check('krsort', $a, array_reverse($want, true));
+
+$a = array();
+for ($i = 0; $i < 3000; $i++) {
+  $a[$i * 7919 % 3001 - 1500] = $i;
+}
+ksort($a, SORT_STRING);
+$want = array_keys($a);
+$strs = array_map('strval', $want);
+$sorted = $strs;
+sort($sorted, SORT_STRING);
+check('ksort SORT_STRING', $strs, $sorted);
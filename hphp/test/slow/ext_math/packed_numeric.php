@@ -0,0 +1,39 @@
+<?php
+
+// array_sum(), array_product(), min() and max() walk packed arrays of
+// ints and doubles in place; anything else takes the generic loop.  Each
+// case is run on the packed array and on a mixed copy of it, and the two
+// results have to agree.
+
+function mixed_copy($a) {
+  $m = array('x' => 0);
+  foreach ($a as $k => $v) $m[$k] = $v;
+  unset($m['x']);
+  return $m;
+}
+
+function check($name, $a) {
+  $m = mixed_copy($a);
+  echo "-- $name\n";
+  var_dump(array_sum($a), array_sum($m));
+  var_dump(array_product($a), array_product($m));
+  var_dump(min($a), min($m));
+  var_dump(max($a), max($m));
+}
+
+$int_min = -PHP_INT_MAX - 1;
+
+check('ints', array(3, -1, 7, 2));
+check('doubles', array(1.5, -2.5, 4.0));
+check('ints then double', array(2, 3, 0.5));
+check('double then ints', array(0.5, 2, 3));
+check('int min', array($int_min, 1));
+check('int max', array(PHP_INT_MAX, -1, 0));
+check('nan first', array(NAN, 1.0, 2.0));
+check('nan later', array(1.0, NAN, 2.0));
+check('numeric string', array(1, '2', 3));
+check('single', array(42));
+
+$r = array(1, 2, 3);
+$x =& $r[1];
+check('ref', $r);
@@ -0,0 +1,41 @@
+<?php
+
+// Run with a translation space small enough that it fills up part way
+// through, so the collector thread replaces it while this request is
+// still running in it. Everything has to keep producing the same results,
+// whether it's running in the old space, interpreted, or in the new one.
+
+function make($i) {
+  $name = "f$i";
+  eval("function $name(\$n) {
+    \$a = array();
+    for (\$j = 0; \$j < \$n; \$j++) {
+      \$a[] = \$j * $i + strlen('$name');
+    }
+    \$s = 0;
+    foreach (\$a as \$k => \$v) {
+      if (\$k % 3 == 0) \$s += \$v; else \$s -= \$v >> 1;
+    }
+    return \$s;
+  }");
+  return $name;
+}
+
+function caller($f, $n) {
+  return $f($n);
+}
+
+$total = 0;
+$names = array();
+for ($i = 0; $i < 400; $i++) {
+  $names[] = make($i);
+}
+for ($round = 0; $round < 20; $round++) {
+  foreach ($names as $i => $f) {
+    $total += caller($f, $i % 17 + $round);
+    $total += call_user_func_array($f, array($round));
+  }
+  // give the collector thread a chance to run
+  usleep(1000);
+}
+var_dump($total);
@@ -0,0 +1,38 @@
+<?php
+
+// With ThreadingJit, optimized retranslations are made on a JIT worker
+// thread, which has no VM frame of its own. Run a function entry with a
+// DV funclet, a method and a loop past the PGO threshold so they get
+// queued, give the worker time to publish, and check the results don't
+// change along the way.
+
+class Acc {
+  private $n = 0;
+  function add($v) {
+    $this->n += $v;
+    return $this->n;
+  }
+}
+
+function step($i, $mul = 3) {
+  return ($i * $mul) % 7;
+}
+
+function loop($n) {
+  $s = 0;
+  for ($i = 0; $i < $n; $i++) {
+    $s += step($i) - step($i, 2);
+  }
+  return $s;
+}
+
+$acc = new Acc;
+$total = 0;
+for ($round = 0; $round < 50; $round++) {
+  $total += loop($round);
+  $acc->add(step($round));
+  // give the worker a chance to run
+  usleep(1000);
+}
+var_dump($total);
+var_dump($acc->add(0));
@@ -17,15 +17,118 @@
 #include "hphp/util/hash.h"
 #include "hphp/util/util.h"
 
+#ifdef __x86_64__
+#include "folly/CpuId.h"
+#endif
+
 namespace HPHP {
 
+namespace {
+
+// a-z => A-Z, eight bytes at a time, as in MurmurHash3::getblock64
+const uint64_t kFoldCase = 0xdfdfdfdfdfdfdfdfULL;
+
+ALWAYS_INLINE uint64_t load_block(const char *p) {
+  uint64_t block;
+  memcpy(&block, p, sizeof block);
+  return block & kFoldCase;
+}
+
+// The last n < 8 bytes, zero-padded; the length is mixed in separately.
+ALWAYS_INLINE uint64_t load_tail(const char *p, size_t n) {
+  uint64_t block = 0;
+  memcpy(&block, p, n);
+  return block & kFoldCase;
+}
+
+struct CRC32CTable {
+  CRC32CTable() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+      }
+      entries[i] = c;
+    }
+  }
+  uint32_t entries[256];
+};
+
+// Same result as the crc32q instruction: no pre- or post-inversion.
+ALWAYS_INLINE uint32_t crc_sw(uint32_t crc, uint64_t block) {
+  static const CRC32CTable table;
+  for (int i = 0; i < 8; ++i) {
+    crc = table.entries[(crc ^ block) & 0xff] ^ (crc >> 8);
+    block >>= 8;
+  }
+  return crc;
+}
+
+#ifdef __x86_64__
+// Inline asm, since we don't build with -msse4.2.
+ALWAYS_INLINE uint32_t crc_hw(uint32_t crc, uint64_t block) {
+  uint64_t c = crc;
+  asm("crc32q %1, %0" : "+r"(c) : "rm"(block));
+  return c;
+}
+#endif
+
+template <uint32_t (*crc)(uint32_t, uint64_t)>
+ALWAYS_INLINE strhash_t crc_hash_i(const char *arKey, size_t len) {
+  // Different seeds, so identical blocks in the two chains don't cancel.
+  uint32_t h1 = 0;
+  uint32_t h2 = 0x9e3779b9;
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    h1 = crc(h1, load_block(arKey + i));
+    h2 = crc(h2, load_block(arKey + i + 8));
+  }
+  if (i + 8 <= len) {
+    h1 = crc(h1, load_block(arKey + i));
+    i += 8;
+  }
+  if (i < len) {
+    h2 = crc(h2, load_tail(arKey + i, len - i));
+  }
+  uint64_t h = ((uint64_t(h1) << 32) | h2) ^ len;
+  return strhash_t(MurmurHash3::fmix64(h) & STRHASH_MASK);
+}
+
+}
+
+strhash_t hash_string_i_crc_sw(const char *arKey, int nKeyLength) {
+  return crc_hash_i<crc_sw>(arKey, nKeyLength);
+}
+
+#ifdef __x86_64__
+
+strhash_t hash_string_i_crc_hw(const char *arKey, int nKeyLength) {
+  return crc_hash_i<crc_hw>(arKey, nKeyLength);
+}
+
+HOT_FUNC
+strhash_t hash_string_i(const char *arKey, int nKeyLength) {
+  // Function-local, since static strings are hashed during static init.
+  static bool const sse42 = folly::CpuId().sse42();
+  return sse42 ? crc_hash_i<crc_hw>(arKey, nKeyLength)
+               : crc_hash_i<crc_sw>(arKey, nKeyLength);
+}
+
+#else
+
+strhash_t hash_string_i_crc_hw(const char *arKey, int nKeyLength) {
+  return crc_hash_i<crc_sw>(arKey, nKeyLength);
+}
+
 HOT_FUNC
 strhash_t hash_string_i(const char *arKey, int nKeyLength) {
-  return hash_string_i_inline(arKey, nKeyLength);
+  return crc_hash_i<crc_sw>(arKey, nKeyLength);
 }
 
+#endif
+
 strhash_t hash_string(const char *arKey, int nKeyLength) {
-  return hash_string_i_inline(arKey, nKeyLength);
+  return hash_string_i(arKey, nKeyLength);
 }
 
 }
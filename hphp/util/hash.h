@@ -247,19 +247,20 @@ inline strhash_t hash_string_cs(const char *arKey, int nKeyLength) {
   }
 }
 
+/*
+ * The case-insensitive hash behind StringData::hash(), and so behind every
+ * string-keyed array lookup.  It is CRC32C over 8-byte blocks, run as two
+ * interleaved chains so their latencies overlap, then put through fmix64
+ * because a CRC on its own doesn't avalanche.  CPUs with SSE4.2 compute
+ * the CRC with the crc32 instruction; the table-driven version gives the
+ * same values, so hashes are the same on every machine.
+ */
 strhash_t hash_string_i(const char *arKey, int nKeyLength);
 strhash_t hash_string(const char *arKey, int nKeyLength);
 
-inline strhash_t hash_string_i_inline(const char *arKey, int nKeyLength) {
-  if (MurmurHash3::useHash128) {
-    uint64_t h[2];
-    MurmurHash3::hash128<false>(arKey, nKeyLength, 0, h);
-    return strhash_t(h[0] & STRHASH_MASK);
-  } else {
-    uint32_t h = MurmurHash3::hash32<false>(arKey, nKeyLength, 0);
-    return strhash_t(h & STRHASH_MASK);
-  }
-}
+// The two implementations of hash_string_i(); the first needs SSE4.2.
+strhash_t hash_string_i_crc_hw(const char *arKey, int nKeyLength);
+strhash_t hash_string_i_crc_sw(const char *arKey, int nKeyLength);
 
 inline strhash_t hash_string_inline(const char *arKey, int nKeyLength) {
   return hash_string_i(arKey, nKeyLength);
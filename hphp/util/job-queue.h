@@ -18,6 +18,7 @@
 #define incl_HPHP_UTIL_JOB_QUEUE_H_
 
 #include <time.h>
+#include <atomic>
 #include <vector>
 #include <set>
 #include "hphp/util/alloc.h"
@@ -28,6 +29,7 @@
 #include "hphp/util/exception.h"
 #include "hphp/util/lock.h"
 #include "hphp/util/logger.h"
+#include "hphp/util/numa.h"
 #include "hphp/util/synchronizable-multi.h"
 #include "hphp/util/timer.h"
 
@@ -84,6 +86,19 @@ namespace HPHP {
  * want to prioritize the newest requests.
  *
  * You can configure a LIFO ordered queue by setting lifoSwitchThreshold to 0.
+ *
+ * Load shedding
+ * =============
+ * Besides dropping jobs that waited longer than maxJobQueuingMs, a queue can
+ * shed load adaptively with CoDel (setCoDel()). It watches how long the
+ * oldest lowest-priority job has been waiting. If that wait never dropped
+ * below 'target' during a whole 'interval', the queue is overloaded: a
+ * standing queue has formed that workers aren't draining. While overloaded,
+ * lowest-priority jobs that have waited more than twice the target are
+ * handed to workers as expired, so they get a quick rejection instead of
+ * service nobody is waiting for anymore, and the rest are served newest
+ * first. Higher priorities are never shed. The queue recovers as soon as
+ * the wait stays under target for an interval again, or when it runs empty.
  */
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -115,10 +130,22 @@ public:
         m_dropCacheTimeout(dropCacheTimeout), m_dropStack(dropStack),
         m_lifoSwitchThreshold(lifoSwitchThreshold),
         m_maxJobQueuingMs(maxJobQueuingMs),
-        m_jobReaperId(-1) {
+        m_jobReaperId(-1),
+        m_codelTargetUs(0), m_codelIntervalUs(0), m_codelIntervalEnd(0),
+        m_codelMinDelayUs(0), m_codelOverloaded(false), m_shedJobs(0) {
     m_jobQueues.resize(numPriorities);
   }
 
+  /**
+   * Turn on CoDel load shedding (see above); targetMs <= 0 turns it off.
+   * Call it before any jobs are queued.
+   */
+  void setCoDel(int targetMs, int intervalMs) {
+    Lock lock(this);
+    m_codelTargetUs = targetMs > 0 ? targetMs * 1000LL : 0;
+    m_codelIntervalUs = (intervalMs > 0 ? intervalMs : 100) * 1000LL;
+  }
+
   /**
    * Put a job into the queue and notify a worker to pick it up.
    */
@@ -128,6 +155,10 @@ public:
     timespec enqueueTime;
     Timer::GetMonotonicTime(enqueueTime);
     Lock lock(this);
+    if (priority == 0 && m_codelTargetUs && m_jobQueues[0].empty()) {
+      // nothing was waiting, so there's no standing queue right now
+      codelOverloaded(0, enqueueTime);
+    }
     m_jobQueues[priority].emplace_back(job, enqueueTime);
     ++m_jobCount;
     notify();
@@ -180,6 +211,17 @@ public:
     return m_jobCount;
   }
 
+  /**
+   * Whether CoDel currently considers the queue overloaded, and how many
+   * jobs it has shed.
+   */
+  bool isOverloaded() const {
+    return m_codelOverloaded.load(std::memory_order_relaxed);
+  }
+  int64_t getShedJobs() const {
+    return m_shedJobs.load(std::memory_order_relaxed);
+  }
+
   /**
    * One worker can be designated as the job reaper. The job reaper's job is to
    * check if the oldest job on the queue has expired and if so, terminate that
@@ -198,12 +240,15 @@ public:
 
  private:
   friend class JobQueue_Expiration_Test;
-  TJob dequeueMaybeExpiredImpl(int id, bool inc, const timespec& now,
+  friend class JobQueue_CoDel_Test;
+  TJob dequeueMaybeExpiredImpl(int id, bool inc, timespec now,
                                bool* expired) {
     *expired = false;
     Lock lock(this);
     bool flushed = false;
+    bool waited = false;
     while (m_jobCount == 0) {
+      waited = true;
       if (m_stopped) {
         throw StopSignal();
       }
@@ -222,6 +267,8 @@ public:
         }
       }
     }
+    // the job we get was queued after the caller looked at the clock
+    if (waited) Timer::GetMonotonicTime(now);
     if (inc) incActiveWorker();
     --m_jobCount;
 
@@ -237,20 +284,25 @@ public:
           gettime_diff_us(jobs.front().second, now) >
           m_maxJobQueuingMs * 1000) {
         *expired = true;
-        TJob job = jobs.front().first;
-        jobs.pop_front();
-        return job;
+        return takeJob(jobs, true);
       }
 
+      if (m_codelTargetUs && &jobs == &m_jobQueues[0]) {
+        int64_t delayUs = gettime_diff_us(jobs.front().second, now);
+        if (codelOverloaded(delayUs, now)) {
+          if (delayUs > 2 * m_codelTargetUs) {
+            *expired = true;
+            m_shedJobs.fetch_add(1, std::memory_order_relaxed);
+            return takeJob(jobs, true);
+          }
+          return takeJob(jobs, false);
+        }
+      }
 
       if (m_jobCount >= m_lifoSwitchThreshold) {
-        TJob job = jobs.back().first;
-        jobs.pop_back();
-        return job;
+        return takeJob(jobs, false);
       }
-      TJob job = jobs.front().first;
-      jobs.pop_front();
-      return job;
+      return takeJob(jobs, true);
     }
     assert(false);
     return TJob();  // make compiler happy.
@@ -271,9 +323,7 @@ public:
             if (inc) incActiveWorker();
             --m_jobCount;
 
-            TJob job = jobs.front().first;
-            jobs.pop_front();
-            return job;
+            return takeJob(jobs, true);
           }
           // oldest job hasn't expired yet. wake us up when it will.
           long waitTimeForQueue = m_maxJobQueuingMs * 1000 - queuedTimeUs;
@@ -292,6 +342,45 @@ public:
     throw StopSignal();
   }
 
+  /*
+   * Takes the job at the front or the back of jobs. Once the lowest
+   * priority is drained there's no standing queue, whatever the current
+   * interval has seen so far, so CoDel stops shedding and an idle queue
+   * doesn't stay overloaded until the next job comes along. Called with
+   * the lock held.
+   */
+  TJob takeJob(std::deque<std::pair<TJob, timespec>>& jobs, bool front) {
+    TJob job = front ? jobs.front().first : jobs.back().first;
+    if (front) {
+      jobs.pop_front();
+    } else {
+      jobs.pop_back();
+    }
+    if (m_codelTargetUs && jobs.empty() && &jobs == &m_jobQueues[0]) {
+      m_codelMinDelayUs = 0;
+      m_codelOverloaded.store(false, std::memory_order_relaxed);
+    }
+    return job;
+  }
+
+  /*
+   * Feeds CoDel the current wait of the oldest lowest-priority job; at the
+   * end of each interval, the queue is overloaded if the smallest wait seen
+   * during it was above target. Called with the lock held.
+   */
+  bool codelOverloaded(int64_t delayUs, const timespec& now) {
+    int64_t nowUs = now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+    if (nowUs >= m_codelIntervalEnd) {
+      m_codelOverloaded.store(m_codelMinDelayUs > m_codelTargetUs,
+                              std::memory_order_relaxed);
+      m_codelMinDelayUs = delayUs;
+      m_codelIntervalEnd = nowUs + m_codelIntervalUs;
+    } else if (delayUs < m_codelMinDelayUs) {
+      m_codelMinDelayUs = delayUs;
+    }
+    return m_codelOverloaded.load(std::memory_order_relaxed);
+  }
+
   int m_jobCount;
   std::vector<std::deque<std::pair<TJob, timespec>>> m_jobQueues;
   bool m_stopped;
@@ -301,6 +390,14 @@ public:
   const int m_lifoSwitchThreshold;
   const int m_maxJobQueuingMs;
   std::atomic<int> m_jobReaperId;
+
+  // CoDel state, guarded by the queue's lock
+  int64_t m_codelTargetUs;
+  int64_t m_codelIntervalUs;
+  int64_t m_codelIntervalEnd;
+  int64_t m_codelMinDelayUs;
+  std::atomic<bool> m_codelOverloaded;
+  std::atomic<int64_t> m_shedJobs;
 };
 
 template<class TJob, class Policy>
@@ -361,7 +458,8 @@ public:
    * Default constructor.
    */
   JobQueueWorker()
-      : m_func(nullptr), m_opaque(nullptr), m_stopped(false), m_queue(nullptr) {
+      : m_func(nullptr), m_opaque(nullptr), m_stopped(false),
+        m_numaNode(-1), m_queue(nullptr) {
   }
 
   virtual ~JobQueueWorker() {
@@ -379,6 +477,13 @@ public:
     m_opaque = opaque;
   }
 
+  int getId() const { return m_id; }
+
+  /**
+   * Bind the worker thread to a NUMA node when it starts; -1 for no binding.
+   */
+  void setNumaNode(int node) { m_numaNode = node; }
+
   /**
    * The only functions a subclass needs to implement.
    */
@@ -394,6 +499,10 @@ public:
    */
   void start() {
     assert(m_queue);
+    if (m_numaNode >= 0) {
+      // before onThreadEnter() so thread-local state is allocated locally
+      bind_thread_to_numa_node(m_numaNode);
+    }
     onThreadEnter();
     while (!m_stopped) {
       try {
@@ -432,6 +541,7 @@ protected:
   void *m_func;
   void *m_opaque;
   bool m_stopped;
+  int m_numaNode;
 
 private:
   QueueType* m_queue;
@@ -445,6 +555,13 @@ private:
 template<class TJob, class TWorker>
 class JobQueueDispatcher {
 public:
+  /**
+   * NUMA placement policies for setNumaPolicy(); any other non-negative
+   * value binds every worker to that node.
+   */
+  static const int kNumaNone = -1;   // leave workers wherever they land
+  static const int kNumaSpread = -2; // worker i goes to node i % #nodes
+
   /**
    * Constructor.
    */
@@ -453,7 +570,7 @@ public:
                      int lifoSwitchThreshold = INT_MAX,
                      int maxJobQueuingMs = -1, int numPriorities = 1)
       : m_stopped(true), m_id(0), m_opaque(opaque),
-        m_maxThreadCount(threadCount),
+        m_maxThreadCount(threadCount), m_numaPolicy(kNumaNone),
         m_queue(threadCount, threadRoundRobin, dropCacheTimeout, dropStack,
                 lifoSwitchThreshold, maxJobQueuingMs, numPriorities),
         m_startReaperThread(maxJobQueuingMs > 0) {
@@ -489,6 +606,33 @@ public:
     return m_queue.getQueuedJobs();
   }
 
+  /**
+   * CoDel load shedding, see JobQueue. Call before start().
+   */
+  void setCoDel(int targetMs, int intervalMs) {
+    m_queue.setCoDel(targetMs, intervalMs);
+  }
+
+  bool isOverloaded() const {
+    return m_queue.isOverloaded();
+  }
+
+  int64_t getShedJobs() const {
+    return m_queue.getShedJobs();
+  }
+
+  /**
+   * Where worker threads run and allocate memory. Applies to workers
+   * that haven't started yet, so call it before start().
+   */
+  void setNumaPolicy(int policy) {
+    Lock lock(m_mutex);
+    m_numaPolicy = policy;
+    for (auto worker : m_workers) {
+      worker->setNumaNode(getNumaNode(worker->getId()));
+    }
+  }
+
   int getTargetNumWorkers() {
     if (TWorker::CountActive) {
       int target = getActiveWorker() + getQueuedJobs();
@@ -621,6 +765,7 @@ private:
   int m_id;
   void *m_opaque;
   int m_maxThreadCount;
+  int m_numaPolicy;
   JobQueue<TJob,
            TWorker::Waitable,
            typename TWorker::DropCachePolicy> m_queue;
@@ -630,6 +775,11 @@ private:
   std::set<AsyncFunc<TWorker> *> m_funcs;
   const bool m_startReaperThread;
 
+  int getNumaNode(int id) const {
+    if (m_numaPolicy == kNumaSpread) return id % num_numa_nodes();
+    return m_numaPolicy;
+  }
+
   // return the id for the worker.
   int addWorkerImpl(bool start) {
     TWorker *worker = new TWorker();
@@ -638,6 +788,7 @@ private:
     m_funcs.insert(func);
     int id = m_id++;
     worker->create(id, &m_queue, func, m_opaque);
+    worker->setNumaNode(getNumaNode(id));
 
     if (start) {
       func->start();
@@ -0,0 +1,133 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_LOG_HISTOGRAM_H_
+#define incl_HPHP_LOG_HISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * A histogram of non-negative values with log-linear buckets, as in
+ * HdrHistogram: values below 2^kSubBits get a bucket each, and every power
+ * of two above that is split into 2^kSubBits equal buckets. Percentiles are
+ * therefore within 1/2^kSubBits (about 6%) of the real value whatever the
+ * magnitude, using a few KB per histogram. Values of 2^kMaxBits or more are
+ * counted in the last bucket.
+ *
+ * Only one thread may add() to a histogram. Any thread can read it at any
+ * time through Snapshot::add(), without locking: counts are relaxed atomics
+ * the writer updates with plain loads and stores, so the reader sees each
+ * bucket as of some recent moment and the writer never waits. clear() from
+ * another thread can lose a concurrent add(), which is fine for statistics.
+ */
+struct LogHistogram {
+  static const int kSubBits = 4;
+  static const int kMaxBits = 40;
+  static const int kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+
+  LogHistogram() { clear(); }
+
+  void add(int64_t value) {
+    if (value < 0) value = 0;
+    bump(m_counts[bucketOf(value)], 1);
+    bump(m_sum, value);
+  }
+
+  void clear() {
+    for (auto& c : m_counts) c.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+  }
+
+  static int bucketOf(uint64_t value) {
+    if (value < (1u << kSubBits)) return value;
+    int msb = 63 - __builtin_clzll(value);
+    if (msb >= kMaxBits) return kBuckets - 1;
+    int shift = msb - kSubBits;
+    return ((shift + 1) << kSubBits) + ((value >> shift) & kSubMask);
+  }
+
+  // The largest value counted in bucket b.
+  static int64_t bucketMax(int b) {
+    if (b < (1 << kSubBits)) return b;
+    int shift = (b >> kSubBits) - 1;
+    int64_t lo = int64_t((b & kSubMask) | (1 << kSubBits)) << shift;
+    return lo + (int64_t(1) << shift) - 1;
+  }
+
+  /*
+   * Totals of any number of histograms, for reporting.
+   */
+  struct Snapshot {
+    Snapshot() : counts(kBuckets), total(0), sum(0) {}
+
+    void add(const LogHistogram& h) {
+      for (int b = 0; b < kBuckets; ++b) {
+        uint64_t c = h.m_counts[b].load(std::memory_order_relaxed);
+        counts[b] += c;
+        total += c;
+      }
+      sum += h.m_sum.load(std::memory_order_relaxed);
+    }
+
+    void add(const Snapshot& s) {
+      for (int b = 0; b < kBuckets; ++b) counts[b] += s.counts[b];
+      total += s.total;
+      sum += s.sum;
+    }
+
+    // The value at fraction p (0 to 1) of the counts, rounded up to the
+    // top of its bucket; 0 for an empty histogram.
+    int64_t percentile(double p) const {
+      if (!total) return 0;
+      uint64_t rank = p * total;
+      if (rank >= total) rank = total - 1;
+      uint64_t seen = 0;
+      for (int b = 0; b < kBuckets; ++b) {
+        seen += counts[b];
+        if (seen > rank) return bucketMax(b);
+      }
+      return bucketMax(kBuckets - 1);
+    }
+
+    int64_t mean() const { return total ? sum / int64_t(total) : 0; }
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    int64_t sum;
+  };
+
+private:
+  static const int kSubMask = (1 << kSubBits) - 1;
+
+  template<class T, class D>
+  static void bump(std::atomic<T>& a, D delta) {
+    a.store(a.load(std::memory_order_relaxed) + delta,
+            std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> m_counts[kBuckets];
+  std::atomic<int64_t> m_sum;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_LOG_HISTOGRAM_H_
@@ -0,0 +1,158 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/util/numa.h"
+
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cerrno>
+#include <fstream>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "folly/Conv.h"
+#include "folly/String.h"
+
+#include "hphp/util/logger.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+const char kNodeDir[] = "/sys/devices/system/node/";
+
+// from linux/mempolicy.h
+const int kMpolPreferred = 1;
+
+// So a failure is logged once, not once per thread.
+std::atomic<bool> s_affinityWarned(false);
+std::atomic<bool> s_mempolicyFailed(false);
+
+struct NumaTopology {
+  NumaTopology() {
+    auto nodes = parse_cpu_list(read(kNodeDir + std::string("online")));
+    for (auto node : nodes) {
+      auto cpus = parse_cpu_list(read(kNodeDir + std::string("node") +
+                                      std::to_string(node) + "/cpulist"));
+      if (cpus.empty()) continue;
+      if (node >= (int)nodeCpus.size()) nodeCpus.resize(node + 1);
+      nodeCpus[node] = cpus;
+      for (auto cpu : cpus) {
+        if (cpu >= (int)cpuNode.size()) cpuNode.resize(cpu + 1, 0);
+        cpuNode[cpu] = node;
+      }
+    }
+    if (nodeCpus.empty()) {
+      int n = sysconf(_SC_NPROCESSORS_ONLN);
+      nodeCpus.resize(1);
+      for (int i = 0; i < n; i++) nodeCpus[0].push_back(i);
+    }
+  }
+
+  static std::string read(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+  }
+
+  std::vector<std::vector<int>> nodeCpus;
+  std::vector<int> cpuNode;
+};
+
+const NumaTopology& topology() {
+  static NumaTopology s_topology;
+  return s_topology;
+}
+
+}
+
+std::vector<int> parse_cpu_list(const std::string& list) {
+  std::vector<int> ret;
+  folly::StringPiece trimmed(list);
+  while (!trimmed.empty() && isspace(trimmed.front())) trimmed.pop_front();
+  while (!trimmed.empty() && isspace(trimmed.back())) trimmed.pop_back();
+  std::vector<folly::StringPiece> ranges;
+  folly::split(',', trimmed, ranges);
+  for (auto range : ranges) {
+    if (range.empty()) continue;
+    auto dash = range.find('-');
+    try {
+      int lo = folly::to<int>(range.subpiece(0, dash));
+      int hi = dash == folly::StringPiece::npos ? lo :
+        folly::to<int>(range.subpiece(dash + 1));
+      for (int i = lo; i <= hi; i++) ret.push_back(i);
+    } catch (const std::range_error&) {
+      return std::vector<int>();
+    }
+  }
+  return ret;
+}
+
+int num_numa_nodes() {
+  return topology().nodeCpus.size();
+}
+
+int cpu_numa_node(int cpu) {
+  auto const& cpuNode = topology().cpuNode;
+  return cpu >= 0 && cpu < (int)cpuNode.size() ? cpuNode[cpu] : 0;
+}
+
+const std::vector<int>& numa_node_cpus(int node) {
+  assert(node >= 0 && node < num_numa_nodes());
+  return topology().nodeCpus[node];
+}
+
+bool bind_thread_to_numa_node(int node) {
+  if (node < 0 || node >= num_numa_nodes()) return false;
+  auto const& cpus = numa_node_cpus(node);
+  if (cpus.empty()) return false;
+#ifndef __APPLE__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto cpu : cpus) CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    // e.g. a cpuset that doesn't include the node's CPUs; the thread keeps
+    // running wherever the scheduler puts it
+    if (!s_affinityWarned.exchange(true)) {
+      Logger::Warning("Unable to bind threads to NUMA node %d: %s",
+                      node, folly::errnoStr(errno).c_str());
+    }
+    return false;
+  }
+#ifdef SYS_set_mempolicy
+  if (num_numa_nodes() > 1 && node < 64 && !s_mempolicyFailed.load()) {
+    unsigned long mask = 1UL << node;
+    if (syscall(SYS_set_mempolicy, kMpolPreferred, &mask,
+                sizeof(mask) * 8) != 0) {
+      // Not allowed in some containers; pages come from the default
+      // policy, and we stop asking.
+      if (!s_mempolicyFailed.exchange(true)) {
+        Logger::Warning("Unable to prefer NUMA node %d for memory: %s",
+                        node, folly::errnoStr(errno).c_str());
+      }
+    }
+  }
+#endif
+#endif
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
@@ -0,0 +1,52 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#ifndef incl_HPHP_UTIL_NUMA_H_
+#define incl_HPHP_UTIL_NUMA_H_
+
+#include <string>
+#include <vector>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * NUMA topology, read once from /sys/devices/system/node.  Machines
+ * without that directory look like a single node holding every CPU.
+ */
+int num_numa_nodes();
+int cpu_numa_node(int cpu);
+const std::vector<int>& numa_node_cpus(int node);
+
+/*
+ * Restrict the calling thread to the CPUs of the given node, and make
+ * the node's memory its preferred source for new pages.  Since the
+ * smart allocator's slabs and the VM stack are first touched by the
+ * thread that uses them, both end up on the local node.  Returns false,
+ * leaving the thread alone, if the node doesn't exist or the thread can't
+ * be bound to it.  If only the memory policy can't be set, the thread
+ * stays bound and allocates as usual.  Failures are logged once.
+ */
+bool bind_thread_to_numa_node(int node);
+
+/*
+ * Parse a kernel cpu/node list such as "0-3,8,10-11".
+ */
+std::vector<int> parse_cpu_list(const std::string& list);
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif
@@ -0,0 +1,235 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/util/string-scan.h"
+
+#include <cctype>
+#include <clocale>
+#include <cstring>
+
+#ifdef __x86_64__
+#include <emmintrin.h>
+#include "folly/CpuId.h"
+#endif
+
+#include "hphp/util/assertions.h"
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+namespace string_scan_scalar {
+
+size_t string_scan_any(const char* s, size_t len,
+                       const char* set, size_t setLen) {
+  assert(setLen >= 1 && setLen <= 16);
+  for (size_t i = 0; i < len; ++i) {
+    if (memchr(set, s[i], setLen)) return i;
+  }
+  return len;
+}
+
+static inline char to_case(char c, CaseConv conv) {
+  auto const uc = (unsigned char)c;
+  return conv == CaseConv::Lower ? tolower(uc) : toupper(uc);
+}
+
+size_t string_scan_case(const char* s, size_t len, CaseConv conv) {
+  for (size_t i = 0; i < len; ++i) {
+    if (to_case(s[i], conv) != s[i]) return i;
+  }
+  return len;
+}
+
+void string_convert_case(char* dst, const char* s, size_t len,
+                         CaseConv conv) {
+  for (size_t i = 0; i < len; ++i) {
+    dst[i] = to_case(s[i], conv);
+  }
+}
+
+}
+
+#ifdef __x86_64__
+
+namespace {
+
+const size_t kBlock = sizeof(__m128i);
+
+inline __m128i load(const char* p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+}
+
+/*
+ * 0xff in the bytes of v that are ASCII letters of the case conv would
+ * change.  Adding 0x80 - lo moves [lo, lo + 25] to the bottom of the
+ * signed byte range, so a single signed compare checks both ends.
+ */
+inline __m128i case_mask(__m128i v, CaseConv conv) {
+  char const lo = conv == CaseConv::Lower ? 'A' : 'a';
+  auto const shifted = _mm_add_epi8(v, _mm_set1_epi8(char(0x80 - lo)));
+  return _mm_cmplt_epi8(shifted, _mm_set1_epi8(char(0x80 + 26)));
+}
+
+size_t scan_case_sse2(const char* s, size_t len, CaseConv conv) {
+  size_t i = 0;
+  for (; i + kBlock <= len; i += kBlock) {
+    auto const v = load(s + i);
+    if (_mm_movemask_epi8(v)) {
+      // What happens to non-ASCII bytes depends on the locale.
+      auto const n = string_scan_scalar::string_scan_case(s + i, kBlock, conv);
+      if (n < kBlock) return i + n;
+      continue;
+    }
+    if (auto const m = _mm_movemask_epi8(case_mask(v, conv))) {
+      return i + __builtin_ctz(m);
+    }
+  }
+  return i + string_scan_scalar::string_scan_case(s + i, len - i, conv);
+}
+
+void convert_case_sse2(char* dst, const char* s, size_t len, CaseConv conv) {
+  auto const flip = _mm_set1_epi8(0x20);
+  size_t i = 0;
+  for (; i + kBlock <= len; i += kBlock) {
+    auto const v = load(s + i);
+    if (_mm_movemask_epi8(v)) {
+      string_scan_scalar::string_convert_case(dst + i, s + i, kBlock, conv);
+      continue;
+    }
+    auto const conv_v = _mm_xor_si128(v, _mm_and_si128(case_mask(v, conv),
+                                                       flip));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), conv_v);
+  }
+  string_scan_scalar::string_convert_case(dst + i, s + i, len - i, conv);
+}
+
+size_t scan_any_sse2(const char* s, size_t len,
+                     const char* set, size_t setLen) {
+  __m128i needles[16];
+  for (size_t j = 0; j < setLen; ++j) {
+    needles[j] = _mm_set1_epi8(set[j]);
+  }
+  size_t i = 0;
+  for (; i + kBlock <= len; i += kBlock) {
+    auto const v = load(s + i);
+    auto hits = _mm_cmpeq_epi8(v, needles[0]);
+    for (size_t j = 1; j < setLen; ++j) {
+      hits = _mm_or_si128(hits, _mm_cmpeq_epi8(v, needles[j]));
+    }
+    if (auto const m = _mm_movemask_epi8(hits)) {
+      return i + __builtin_ctz(m);
+    }
+  }
+  return i + string_scan_scalar::string_scan_any(s + i, len - i,
+                                                 set, setLen);
+}
+
+/*
+ * pcmpestri in "equal any" mode (imm8 0: unsigned bytes, index of the
+ * first match): the index of the first of the n bytes at p that is one of
+ * the setLen bytes in needles, or 16 if there is none.  This is inline
+ * asm rather than an intrinsic because we don't build with -msse4.2.
+ */
+inline size_t pcmpestri(__m128i needles, size_t setLen,
+                        const char* p, size_t n) {
+  size_t idx;
+  asm("pcmpestri $0, %1, %2"
+      : "=c"(idx)
+      : "m"(*reinterpret_cast<const char(*)[16]>(p)), "x"(needles),
+        "a"(setLen), "d"(n)
+      : "cc");
+  return idx & 0x1f;
+}
+
+size_t scan_any_sse42(const char* s, size_t len,
+                      const char* set, size_t setLen) {
+  char setBuf[kBlock] = {};
+  memcpy(setBuf, set, setLen);
+  auto const needles = load(setBuf);
+  size_t i = 0;
+  for (; i + kBlock <= len; i += kBlock) {
+    auto const idx = pcmpestri(needles, setLen, s + i, kBlock);
+    if (idx < kBlock) return i + idx;
+  }
+  if (i == len) return len;
+  // Reading a whole block here could run off the end of the last page.
+  char tail[kBlock];
+  memcpy(tail, s + i, len - i);
+  auto const idx = pcmpestri(needles, setLen, tail, len - i);
+  return idx < len - i ? i + idx : len;
+}
+
+bool have_sse42() {
+  static bool const sse42 = folly::CpuId().sse42();
+  return sse42;
+}
+
+/*
+ * The case kernels map ASCII letters the way the C locale does.  Other
+ * locales can map them differently (in tr_TR.ISO-8859-9, toupper('i')
+ * is 0xdd), so the kernels only run while LC_CTYPE is C (or C.<codeset>)
+ * or POSIX.  In glibc, querying setlocale() doesn't take its lock.
+ */
+bool c_ctype() {
+  auto const name = setlocale(LC_CTYPE, nullptr);
+  if (!name) return false;
+  if (name[0] == 'C' && (name[1] == '\0' || name[1] == '.')) return true;
+  return !strcmp(name, "POSIX");
+}
+
+}
+
+size_t string_scan_any(const char* s, size_t len,
+                       const char* set, size_t setLen) {
+  assert(setLen >= 1 && setLen <= 16);
+  return have_sse42() ? scan_any_sse42(s, len, set, setLen)
+                      : scan_any_sse2(s, len, set, setLen);
+}
+
+size_t string_scan_case(const char* s, size_t len, CaseConv conv) {
+  return c_ctype() ? scan_case_sse2(s, len, conv)
+                   : string_scan_scalar::string_scan_case(s, len, conv);
+}
+
+void string_convert_case(char* dst, const char* s, size_t len,
+                         CaseConv conv) {
+  if (c_ctype()) {
+    convert_case_sse2(dst, s, len, conv);
+  } else {
+    string_scan_scalar::string_convert_case(dst, s, len, conv);
+  }
+}
+
+#else
+
+size_t string_scan_any(const char* s, size_t len,
+                       const char* set, size_t setLen) {
+  return string_scan_scalar::string_scan_any(s, len, set, setLen);
+}
+
+size_t string_scan_case(const char* s, size_t len, CaseConv conv) {
+  return string_scan_scalar::string_scan_case(s, len, conv);
+}
+
+void string_convert_case(char* dst, const char* s, size_t len,
+                         CaseConv conv) {
+  string_scan_scalar::string_convert_case(dst, s, len, conv);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+}
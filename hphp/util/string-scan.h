@@ -0,0 +1,72 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#ifndef incl_HPHP_STRING_SCAN_H_
+#define incl_HPHP_STRING_SCAN_H_
+
+#include <cstddef>
+
+namespace HPHP {
+///////////////////////////////////////////////////////////////////////////////
+
+/*
+ * Vectorized kernels for the string functions that look at every byte
+ * (htmlspecialchars, addslashes, strtolower, ...).  Most of their input
+ * has nothing to escape or convert, so the usual pattern is to scan for
+ * the first interesting byte, hand the input back untouched if there is
+ * none, and otherwise copy runs of boring bytes wholesale.
+ *
+ * The kernels use SSE4.2 string instructions when the CPU has them, and
+ * SSE2 (always there on x86-64) otherwise; the choice is made once, at
+ * startup.  The scalar versions in string_scan_scalar are the reference
+ * implementations, and are what runs on other architectures.
+ */
+
+/*
+ * Index of the first byte of s[0, len) that is one of the setLen bytes
+ * of set, or len if there is none.  set may contain '\0'; setLen must be
+ * between 1 and 16.
+ */
+size_t string_scan_any(const char* s, size_t len,
+                       const char* set, size_t setLen);
+
+enum class CaseConv { Lower, Upper };
+
+/*
+ * Index of the first byte of s[0, len) that tolower() (or toupper())
+ * would change, or len if there is none.
+ */
+size_t string_scan_case(const char* s, size_t len, CaseConv conv);
+
+/*
+ * dst[i] = tolower(s[i]) (or toupper) for i in [0, len).  dst and s may
+ * be the same buffer, but must not otherwise overlap.  The vector
+ * kernels only handle ASCII under the C or POSIX LC_CTYPE; other bytes,
+ * and everything under any other locale, go through the C library.
+ */
+void string_convert_case(char* dst, const char* s, size_t len, CaseConv conv);
+
+namespace string_scan_scalar {
+size_t string_scan_any(const char* s, size_t len,
+                       const char* set, size_t setLen);
+size_t string_scan_case(const char* s, size_t len, CaseConv conv);
+void string_convert_case(char* dst, const char* s, size_t len, CaseConv conv);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+}
+
+#endif // incl_HPHP_STRING_SCAN_H_
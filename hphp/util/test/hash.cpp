@@ -0,0 +1,69 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+
+#include "hphp/util/hash.h"
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "folly/CpuId.h"
+
+namespace HPHP {
+
+namespace {
+
+std::string testKey(size_t len) {
+  std::string s;
+  for (size_t i = 0; i < len; ++i) {
+    s.push_back(char(i * 131 + len));
+  }
+  return s;
+}
+
+}
+
+TEST(HashTest, HardwareMatchesTable) {
+  if (!folly::CpuId().sse42()) return;
+  for (size_t len = 0; len < 100; ++len) {
+    auto const s = testKey(len);
+    EXPECT_EQ(hash_string_i_crc_sw(s.data(), len),
+              hash_string_i_crc_hw(s.data(), len));
+  }
+}
+
+TEST(HashTest, CaseInsensitive) {
+  const char* upper = "ARRAY_KEY_THAT_IS_LONGER_THAN_A_BLOCK";
+  const char* lower = "array_key_that_is_longer_than_a_block";
+  for (int len = 0; len <= int(strlen(upper)); ++len) {
+    EXPECT_EQ(hash_string_i(upper, len), hash_string_i(lower, len));
+  }
+}
+
+TEST(HashTest, LengthMatters) {
+  // The tail block is zero-padded, so the length has to tell these apart.
+  const char key[] = { 'k', 'e', 'y', '\0', '\0' };
+  EXPECT_NE(hash_string_i(key, 3), hash_string_i(key, 4));
+  EXPECT_NE(hash_string_i(key, 4), hash_string_i(key, 5));
+}
+
+TEST(HashTest, NonNegative) {
+  for (size_t len = 0; len < 100; ++len) {
+    auto const s = testKey(len);
+    EXPECT_GE(hash_string_i(s.data(), len), 0);
+  }
+}
+
+}
@@ -188,4 +188,80 @@ TEST(JobQueue, Priority) {
   EXPECT_EQ(4, fifo_queue.dequeueMaybeExpired(0, true, &expired));
 }
 
+TEST(JobQueue, CoDel) {
+  auto after = [](timespec t, int ms) {
+    t.tv_sec += ms / 1000;
+    t.tv_nsec += (ms % 1000) * 1000000L;
+    if (t.tv_nsec >= 1000000000L) {
+      ++t.tv_sec;
+      t.tv_nsec -= 1000000000L;
+    }
+    return t;
+  };
+
+  JobQueue<int> queue(1, false, 0, false, INT_MAX, -1, 2);
+  queue.setCoDel(10, 100);
+  timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 1; i <= 6; ++i) {
+    queue.enqueue(i);
+  }
+  for (auto& job : queue.m_jobQueues[0]) {
+    job.second = start;
+  }
+
+  // the first interval saw an empty queue, so nothing is shed yet
+  bool expired;
+  EXPECT_EQ(1, queue.dequeueMaybeExpiredImpl(0, true, after(start, 50),
+                                             &expired));
+  EXPECT_FALSE(expired);
+  EXPECT_EQ(2, queue.dequeueMaybeExpiredImpl(0, true, after(start, 150),
+                                             &expired));
+  EXPECT_FALSE(expired);
+  EXPECT_FALSE(queue.isOverloaded());
+
+  // the wait stayed above 10ms for a whole interval
+  EXPECT_EQ(3, queue.dequeueMaybeExpiredImpl(0, true, after(start, 260),
+                                             &expired));
+  EXPECT_TRUE(expired);
+  EXPECT_TRUE(queue.isOverloaded());
+
+  // high priority jobs are never shed
+  queue.enqueue(7, 1);
+  queue.m_jobQueues[1][0].second = start;
+  EXPECT_EQ(7, queue.dequeueMaybeExpiredImpl(0, true, after(start, 270),
+                                             &expired));
+  EXPECT_FALSE(expired);
+
+  // stale jobs are shed and fresh ones served newest first
+  queue.enqueue(8);
+  queue.enqueue(9);
+  queue.m_jobQueues[0][3].second = after(start, 265);
+  queue.m_jobQueues[0][4].second = after(start, 265);
+  for (int i = 4; i <= 6; ++i) {
+    EXPECT_EQ(i, queue.dequeueMaybeExpiredImpl(0, true, after(start, 270),
+                                               &expired));
+    EXPECT_TRUE(expired);
+  }
+  EXPECT_EQ(9, queue.dequeueMaybeExpiredImpl(0, true, after(start, 270),
+                                             &expired));
+  EXPECT_FALSE(expired);
+  EXPECT_TRUE(queue.isOverloaded());
+  EXPECT_EQ(8, queue.dequeueMaybeExpiredImpl(0, true, after(start, 270),
+                                             &expired));
+  EXPECT_FALSE(expired);
+  EXPECT_EQ(4, queue.getShedJobs());
+
+  // the queue ran empty, so there's no standing queue to report
+  EXPECT_FALSE(queue.isOverloaded());
+
+  // the wait dropped under target, so the next interval is back to normal
+  queue.enqueue(10);
+  queue.m_jobQueues[0][0].second = after(start, 395);
+  EXPECT_EQ(10, queue.dequeueMaybeExpiredImpl(0, true, after(start, 400),
+                                              &expired));
+  EXPECT_FALSE(expired);
+  EXPECT_FALSE(queue.isOverloaded());
+}
+
 }
@@ -0,0 +1,71 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/log-histogram.h"
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+namespace HPHP {
+
+TEST(LogHistogram, Buckets) {
+  // every value lands in a bucket whose range contains it
+  for (int64_t v = 0; v < 100000; v += 7) {
+    int b = LogHistogram::bucketOf(v);
+    EXPECT_LE(v, LogHistogram::bucketMax(b));
+    if (b > 0) {
+      EXPECT_GT(v, LogHistogram::bucketMax(b - 1));
+    }
+  }
+  EXPECT_EQ(LogHistogram::kBuckets - 1,
+            LogHistogram::bucketOf(uint64_t(1) << 50));
+  EXPECT_EQ(int64_t(1) << LogHistogram::kMaxBits,
+            LogHistogram::bucketMax(LogHistogram::kBuckets - 1) + 1);
+}
+
+TEST(LogHistogram, Percentiles) {
+  std::unique_ptr<LogHistogram> h(new LogHistogram);
+  LogHistogram::Snapshot empty;
+  empty.add(*h);
+  EXPECT_EQ(0, empty.percentile(0.5));
+
+  for (int64_t v = 1; v <= 10000; ++v) h->add(v);
+  LogHistogram::Snapshot s;
+  s.add(*h);
+  EXPECT_EQ(10000u, s.total);
+  EXPECT_EQ(5000, s.mean());
+  auto near = [](int64_t expected, int64_t actual) {
+    return actual >= expected && actual <= expected + expected / 16;
+  };
+  EXPECT_TRUE(near(5000, s.percentile(0.5)));
+  EXPECT_TRUE(near(9900, s.percentile(0.99)));
+  EXPECT_TRUE(near(9990, s.percentile(0.999)));
+  EXPECT_TRUE(near(10000, s.percentile(1.0)));
+
+  // snapshots of several histograms add up
+  std::unique_ptr<LogHistogram> h2(new LogHistogram);
+  for (int i = 0; i < 10000; ++i) h2->add(1000000);
+  s.add(*h2);
+  EXPECT_TRUE(near(5000, s.percentile(0.25)));
+  EXPECT_TRUE(near(1000000, s.percentile(0.75)));
+
+  h->clear();
+  LogHistogram::Snapshot cleared;
+  cleared.add(*h);
+  EXPECT_EQ(0u, cleared.total);
+}
+
+}
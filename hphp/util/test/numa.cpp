@@ -0,0 +1,39 @@
+/*
+   +----------------------------------------------------------------------+
+   | HipHop for PHP                                                       |
+   +----------------------------------------------------------------------+
+   | Copyright (c) 2010-2013 Facebook, Inc. (http://www.facebook.com)     |
+   +----------------------------------------------------------------------+
+   | This source file is subject to version 3.01 of the PHP license,      |
+   | that is bundled with this package in the file LICENSE, and is        |
+   | available through the world-wide-web at the following url:           |
+   | http://www.php.net/license/3_01.txt                                  |
+   | If you did not receive a copy of the PHP license and are unable to   |
+   | obtain it through the world-wide-web, please send a note to          |
+   | license@php.net so we can mail you a copy immediately.               |
+   +----------------------------------------------------------------------+
+*/
+#include "hphp/util/numa.h"
+
+#include <gtest/gtest.h>
+
+namespace HPHP {
+
+TEST(Numa, ParseCpuList) {
+  EXPECT_EQ(std::vector<int>({0}), parse_cpu_list("0"));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}),
+            parse_cpu_list("0-3,8,10-11\n"));
+  EXPECT_TRUE(parse_cpu_list("").empty());
+  EXPECT_TRUE(parse_cpu_list("x-3").empty());
+}
+
+TEST(Numa, Topology) {
+  ASSERT_GE(num_numa_nodes(), 1);
+  for (int node = 0; node < num_numa_nodes(); ++node) {
+    for (auto cpu : numa_node_cpus(node)) {
+      EXPECT_EQ(node, cpu_numa_node(cpu));
+    }
+  }
+}
+
+}
@@ -17,6 +17,7 @@
 
 #include "hphp/zend/zend-html.h"
 #include "hphp/util/lock.h"
+#include "hphp/util/string-scan.h"
 #include <unicode/uchar.h>
 #include <unicode/utf8.h>
 
@@ -453,6 +454,27 @@ static void init_entity_table() {
 
 ///////////////////////////////////////////////////////////////////////////////
 
+static int html_encode_set(char *set, bool encode_double_quote,
+                           bool encode_single_quote, bool utf8, bool nbsp) {
+  int n = 0;
+  set[n++] = '<';
+  set[n++] = '>';
+  set[n++] = '&';
+  if (encode_double_quote) set[n++] = '"';
+  if (encode_single_quote) set[n++] = '\'';
+  if (nbsp) set[n++] = utf8 ? '\xc2' : '\xa0';
+  return n;
+}
+
+int string_html_encode_scan(const char *input, int len,
+                            bool encode_double_quote, bool encode_single_quote,
+                            bool utf8, bool nbsp) {
+  char set[8];
+  int n = html_encode_set(set, encode_double_quote, encode_single_quote,
+                          utf8, nbsp);
+  return string_scan_any(input, len, set, n);
+}
+
 char *string_html_encode(const char *input, int &len, bool encode_double_quote,
                          bool encode_single_quote, bool utf8, bool nbsp) {
   assert(input);
@@ -474,8 +496,17 @@ char *string_html_encode(const char *input, int &len, bool encode_double_quote,
   if (!ret) {
     return nullptr;
   }
+  char set[8];
+  int nset = html_encode_set(set, encode_double_quote, encode_single_quote,
+                             utf8, nbsp);
   char *q = ret;
   for (const char *p = input, *end = input + len; p < end; p++) {
+    // copy everything up to the next byte that may need encoding
+    size_t run = string_scan_any(p, end - p, set, nset);
+    memcpy(q, p, run);
+    q += run;
+    p += run;
+    if (p == end) break;
     char c = *p;
     switch (c) {
     case '"':
@@ -92,6 +92,13 @@ const html_entity_map* html_get_entity_map();
  */
 entity_charset determine_charset(const char*);
 
+/*
+ * Index of the first byte of input that string_html_encode() might have to
+ * encode, or len if it would return input unchanged.
+ */
+int string_html_encode_scan(const char *input, int len,
+                            bool encode_double_quote, bool encode_single_quote,
+                            bool utf8, bool nbsp);
 char *string_html_encode(const char *input, int &len, bool encode_double_quote,
                          bool encode_single_quote, bool utf8, bool nbsp);
 char *string_html_encode_extra(const char *input, int &len,